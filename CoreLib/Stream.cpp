@@ -69,11 +69,13 @@ namespace CoreLib
 				else if (access == FileAccess::ReadWrite)
 				{
 					mode = L"w+b";
+					modeMBCS = "w+b";
 					this->fileAccess = FileAccess::ReadWrite;
 				}
 				else
 				{
 					mode = L"wb";
+					modeMBCS = "wb";
 					this->fileAccess = FileAccess::Write;
 				}
 				break;
@@ -83,11 +85,13 @@ namespace CoreLib
 				else if (access == FileAccess::ReadWrite)
 				{
 					mode = L"a+b";
+					modeMBCS = "a+b";
 					this->fileAccess = FileAccess::ReadWrite;
 				}
 				else
 				{
 					mode = L"ab";
+					modeMBCS = "ab";
 					this->fileAccess = FileAccess::Write;
 				}
 				break;
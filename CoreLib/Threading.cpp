@@ -46,5 +46,262 @@ namespace CoreLib
 			return sysconf(_SC_NPROCESSORS_ONLN);
 		#endif
 		}
+
+		class TaskScheduler::TaskQueue
+		{
+		private:
+			SpinLock lock;
+			List<Task> buffer;
+			int head = 0, count = 0;
+			void Grow()
+			{
+				List<Task> newBuffer;
+				newBuffer.SetSize(Math::Max(64, buffer.Count() * 2));
+				for (int i = 0; i < count; i++)
+					newBuffer[i] = buffer[(head + i) % buffer.Count()];
+				buffer = _Move(newBuffer);
+				head = 0;
+			}
+		public:
+			void PushBack(const Task * tasks, int taskCount)
+			{
+				lock.Lock();
+				while (count + taskCount > buffer.Count())
+					Grow();
+				for (int i = 0; i < taskCount; i++)
+					buffer[(head + count + i) % buffer.Count()] = tasks[i];
+				count += taskCount;
+				lock.Unlock();
+			}
+			bool PopBack(Task & task)
+			{
+				lock.Lock();
+				bool succ = count > 0;
+				if (succ)
+				{
+					count--;
+					task = buffer[(head + count) % buffer.Count()];
+				}
+				lock.Unlock();
+				return succ;
+			}
+			bool PopFront(Task & task)
+			{
+				if (!lock.TryLock())
+					return false;
+				bool succ = count > 0;
+				if (succ)
+				{
+					task = buffer[head];
+					head = (head + 1) % buffer.Count();
+					count--;
+				}
+				lock.Unlock();
+				return succ;
+			}
+		};
+
+		TaskScheduler * TaskScheduler::instance = nullptr;
+		static std::mutex schedulerInstanceMutex;
+
+		// index of the calling thread's queue in TaskScheduler::queues; -1 for threads that are not workers
+		static thread_local int currentWorkerId = -1;
+
+		void TaskCounter::Decrement()
+		{
+			// the lock is held until this thread no longer touches the counter, see TaskScheduler::Wait
+			List<Task> tasks;
+			dependentTasksLock.Lock();
+			if (value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				tasks = _Move(dependentTasks);
+			dependentTasksLock.Unlock();
+			if (tasks.Count())
+				TaskScheduler::GetInstance()->Submit(tasks.GetArrayView());
+		}
+
+		void TaskCounter::Wait()
+		{
+			TaskScheduler::GetInstance()->Wait(this);
+		}
+
+		TaskScheduler::TaskScheduler(int workerThreadCount)
+		{
+			queuedTaskCount = 0;
+			terminate = false;
+			// the last queue is shared by all threads that are not workers
+			for (int i = 0; i <= workerThreadCount; i++)
+				queues.Add(new TaskQueue());
+			for (int i = 0; i < workerThreadCount; i++)
+				workers.Add(std::thread([this, i]() { WorkerThreadProc(i); }));
+		}
+
+		TaskScheduler::~TaskScheduler()
+		{
+			{
+				std::lock_guard<std::mutex> sleepLock(sleepMutex);
+				terminate = true;
+			}
+			wakeCondition.notify_all();
+			for (auto & worker : workers)
+				worker.join();
+			for (auto queue : queues)
+				delete queue;
+		}
+
+		int TaskScheduler::GetQueueIndex()
+		{
+			if (currentWorkerId == -1)
+				return queues.Count() - 1;
+			return currentWorkerId;
+		}
+
+		void TaskScheduler::Enqueue(const Task * tasks, int count)
+		{
+			if (count == 0)
+				return;
+			queues[GetQueueIndex()]->PushBack(tasks, count);
+			queuedTaskCount.fetch_add(count, std::memory_order_acq_rel);
+			{
+				// acquiring the mutex orders this notification after any worker's predicate check
+				std::lock_guard<std::mutex> sleepLock(sleepMutex);
+			}
+			if (count == 1)
+				wakeCondition.notify_one();
+			else
+				wakeCondition.notify_all();
+		}
+
+		bool TaskScheduler::TryDequeue(int queueIndex, Task & task)
+		{
+			if (queuedTaskCount.load(std::memory_order_acquire) == 0)
+				return false;
+			bool succ = queues[queueIndex]->PopBack(task);
+			for (int i = 1; !succ && i < queues.Count(); i++)
+				succ = queues[(queueIndex + i) % queues.Count()]->PopFront(task);
+			if (succ)
+				queuedTaskCount.fetch_sub(1, std::memory_order_acq_rel);
+			return succ;
+		}
+
+		void TaskScheduler::RunTask(Task & task)
+		{
+			task.Entry(task.Data, task.Index);
+			if (task.Signal)
+				task.Signal->Decrement();
+		}
+
+		void TaskScheduler::WorkerThreadProc(int workerId)
+		{
+			currentWorkerId = workerId;
+			const int spinCount = 256;
+			int idleIterations = 0;
+			while (!terminate.load(std::memory_order_acquire))
+			{
+				Task task;
+				if (TryDequeue(workerId, task))
+				{
+					RunTask(task);
+					idleIterations = 0;
+				}
+				else if (idleIterations < spinCount)
+				{
+					idleIterations++;
+					_mm_pause();
+				}
+				else
+				{
+					std::unique_lock<std::mutex> sleepLock(sleepMutex);
+					wakeCondition.wait(sleepLock, [this]()
+					{
+						return terminate.load(std::memory_order_acquire) || queuedTaskCount.load(std::memory_order_acquire) > 0;
+					});
+					idleIterations = 0;
+				}
+			}
+		}
+
+		void TaskScheduler::Submit(const Task & task, TaskCounter * dependency)
+		{
+			Submit(ArrayView<Task>((Task*)&task, 1), dependency);
+		}
+
+		void TaskScheduler::Submit(ArrayView<Task> tasks, TaskCounter * dependency)
+		{
+			if (dependency)
+			{
+				dependency->dependentTasksLock.Lock();
+				if (!dependency->IsDone())
+				{
+					dependency->dependentTasks.AddRange(tasks);
+					dependency->dependentTasksLock.Unlock();
+					return;
+				}
+				dependency->dependentTasksLock.Unlock();
+			}
+			Enqueue(tasks.Buffer(), tasks.Count());
+		}
+
+		void TaskScheduler::Submit(TaskEntryPoint entry, void * data, int taskCount, TaskCounter * signal, TaskCounter * dependency)
+		{
+			const int batchSize = 64;
+			Task batch[batchSize];
+			if (signal)
+				signal->Increment(taskCount);
+			for (int i = 0; i < taskCount; i += batchSize)
+			{
+				int count = Math::Min(batchSize, taskCount - i);
+				// push in reverse order so that the owning thread pops tasks in index order
+				for (int j = 0; j < count; j++)
+					batch[j] = Task(entry, data, taskCount - 1 - (i + j), signal);
+				Submit(ArrayView<Task>(batch, count), dependency);
+			}
+		}
+
+		bool TaskScheduler::RunPendingTask()
+		{
+			Task task;
+			if (TryDequeue(GetQueueIndex(), task))
+			{
+				RunTask(task);
+				return true;
+			}
+			return false;
+		}
+
+		void TaskScheduler::Wait(TaskCounter * counter)
+		{
+			while (!counter->IsDone())
+			{
+				if (!RunPendingTask())
+					std::this_thread::yield();
+			}
+			// wait for the thread that signaled the counter to release it, the counter may be destroyed after return
+			counter->dependentTasksLock.Lock();
+			counter->dependentTasksLock.Unlock();
+		}
+
+		TaskScheduler * TaskScheduler::GetInstance()
+		{
+			if (!instance)
+				Init();
+			return instance;
+		}
+
+		void TaskScheduler::Init(int workerThreadCount)
+		{
+			std::lock_guard<std::mutex> instanceLock(schedulerInstanceMutex);
+			if (instance)
+				return;
+			if (workerThreadCount < 0)
+				workerThreadCount = Math::Max(0, ParallelSystemInfo::GetProcessorCount() - 1);
+			instance = new TaskScheduler(workerThreadCount);
+		}
+
+		void TaskScheduler::Destroy()
+		{
+			std::lock_guard<std::mutex> instanceLock(schedulerInstanceMutex);
+			delete instance;
+			instance = nullptr;
+		}
 	}
 }
\ No newline at end of file
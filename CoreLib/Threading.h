@@ -3,6 +3,9 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iterator>
 #include <xmmintrin.h>
 #include "Basic.h"
 #include "Events.h"
@@ -146,6 +149,230 @@ namespace CoreLib
 				return handle.unlock();
 			}
 		};
+
+		class TaskCounter;
+
+		typedef void(*TaskEntryPoint)(void * data, int index);
+
+		// A unit of work executed by TaskScheduler. `Data` is owned by the submitter and must stay
+		// alive until the task's signal counter reaches zero.
+		struct Task
+		{
+			TaskEntryPoint Entry = nullptr;
+			void * Data = nullptr;
+			int Index = 0;
+			TaskCounter * Signal = nullptr;
+			Task() = default;
+			Task(TaskEntryPoint entry, void * data, int index, TaskCounter * signal)
+				: Entry(entry), Data(data), Index(index), Signal(signal)
+			{}
+		};
+
+		// Tracks the number of unfinished tasks that signal it. Tasks submitted with a counter as their
+		// dependency are held back until that counter drops to zero.
+		class TaskCounter
+		{
+			friend class TaskScheduler;
+		private:
+			std::atomic<int> value;
+			SpinLock dependentTasksLock;
+			CoreLib::Basic::List<Task> dependentTasks;
+		public:
+			TaskCounter()
+			{
+				value = 0;
+			}
+			TaskCounter(const TaskCounter &) = delete;
+			TaskCounter & operator = (const TaskCounter &) = delete;
+			int GetValue() const
+			{
+				return value.load(std::memory_order_acquire);
+			}
+			bool IsDone() const
+			{
+				return GetValue() == 0;
+			}
+			void Increment(int count = 1)
+			{
+				value.fetch_add(count, std::memory_order_acq_rel);
+			}
+			void Decrement();
+			// Blocks until the counter reaches zero, executing pending tasks in the meantime.
+			void Wait();
+		};
+
+		// Persistent work-stealing thread pool. Each worker owns a deque: it pushes and pops work at the back,
+		// idle workers steal from the front of other deques. Threads that are not workers submit into a shared
+		// queue and help executing tasks while they wait on a counter, so parallel work can be nested freely.
+		class TaskScheduler
+		{
+		private:
+			class TaskQueue;
+			static TaskScheduler * instance;
+			CoreLib::Basic::List<TaskQueue*> queues;
+			CoreLib::Basic::List<std::thread> workers;
+			std::atomic<int> queuedTaskCount;
+			std::atomic<bool> terminate;
+			std::mutex sleepMutex;
+			std::condition_variable wakeCondition;
+			int GetQueueIndex();
+			void Enqueue(const Task * tasks, int count);
+			bool TryDequeue(int queueIndex, Task & task);
+			void RunTask(Task & task);
+			void WorkerThreadProc(int workerId);
+		public:
+			TaskScheduler(int workerThreadCount);
+			~TaskScheduler();
+			// Number of threads that can execute tasks concurrently, including the waiting caller.
+			int GetThreadCount()
+			{
+				return workers.Count() + 1;
+			}
+			void Submit(const Task & task, TaskCounter * dependency = nullptr);
+			void Submit(CoreLib::Basic::ArrayView<Task> tasks, TaskCounter * dependency = nullptr);
+			// Submits `taskCount` tasks invoking `entry(data, i)` for i in [0, taskCount).
+			void Submit(TaskEntryPoint entry, void * data, int taskCount, TaskCounter * signal, TaskCounter * dependency = nullptr);
+			// Executes a single pending task on the calling thread. Returns false if no task was available.
+			bool RunPendingTask();
+			void Wait(TaskCounter * counter);
+			static TaskScheduler * GetInstance();
+			static void Init(int workerThreadCount = -1);
+			static void Destroy();
+		};
+
+		template<typename BodyFunc>
+		void ParallelFor(int begin, int end, int grainSize, const BodyFunc & body)
+		{
+			int count = end - begin;
+			if (count <= 0)
+				return;
+			auto scheduler = TaskScheduler::GetInstance();
+			if (grainSize <= 0)
+				grainSize = CoreLib::Basic::Math::Max(1, count / (scheduler->GetThreadCount() * 4));
+			int chunkCount = (count + grainSize - 1) / grainSize;
+			if (chunkCount == 1 || scheduler->GetThreadCount() == 1)
+			{
+				for (int i = begin; i < end; i++)
+					body(i);
+				return;
+			}
+			struct ForContext
+			{
+				const BodyFunc * body;
+				int begin, end, grainSize;
+			};
+			ForContext context = { &body, begin, end, grainSize };
+			TaskCounter counter;
+			scheduler->Submit([](void * data, int chunkId)
+			{
+				auto ctx = (ForContext*)data;
+				int chunkBegin = ctx->begin + chunkId * ctx->grainSize;
+				int chunkEnd = CoreLib::Basic::Math::Min(chunkBegin + ctx->grainSize, ctx->end);
+				for (int i = chunkBegin; i < chunkEnd; i++)
+					(*ctx->body)(i);
+			}, &context, chunkCount, &counter);
+			counter.Wait();
+		}
+
+		template<typename BodyFunc>
+		void ParallelFor(int begin, int end, const BodyFunc & body)
+		{
+			ParallelFor(begin, end, 0, body);
+		}
+
+		// Computes reduce(...reduce(reduce(identity, map(begin)), map(begin + 1))..., map(end - 1)).
+		// Partial results are combined in index order, so the result is deterministic for associative `reduce`.
+		template<typename T, typename MapFunc, typename ReduceFunc>
+		T ParallelReduce(int begin, int end, int grainSize, const T & identity, const MapFunc & map, const ReduceFunc & reduce)
+		{
+			int count = end - begin;
+			if (count <= 0)
+				return identity;
+			auto scheduler = TaskScheduler::GetInstance();
+			if (grainSize <= 0)
+				grainSize = CoreLib::Basic::Math::Max(1, count / (scheduler->GetThreadCount() * 4));
+			int chunkCount = (count + grainSize - 1) / grainSize;
+			CoreLib::Basic::List<T> partialResults;
+			partialResults.SetSize(chunkCount);
+			ParallelFor(0, chunkCount, 1, [&](int chunkId)
+			{
+				int chunkBegin = begin + chunkId * grainSize;
+				int chunkEnd = CoreLib::Basic::Math::Min(chunkBegin + grainSize, end);
+				T partial = identity;
+				for (int i = chunkBegin; i < chunkEnd; i++)
+					partial = reduce(partial, map(i));
+				partialResults[chunkId] = _Move(partial);
+			});
+			T result = identity;
+			for (auto & partial : partialResults)
+				result = reduce(result, partial);
+			return result;
+		}
+
+		template<typename T, typename MapFunc, typename ReduceFunc>
+		T ParallelReduce(int begin, int end, const T & identity, const MapFunc & map, const ReduceFunc & reduce)
+		{
+			return ParallelReduce(begin, end, 0, identity, map, reduce);
+		}
+
+		// Not stable: like std::sort, equal elements may be reordered.
+		template<typename T, typename Comparer>
+		void ParallelSort(T * data, int count, const Comparer & compare)
+		{
+			const int minParallelSortSize = 4096;
+			auto scheduler = TaskScheduler::GetInstance();
+			int chunkCount = 1;
+			while (chunkCount < scheduler->GetThreadCount() * 2 && count / (chunkCount * 2) >= minParallelSortSize / 2)
+				chunkCount <<= 1;
+			if (chunkCount == 1)
+			{
+				std::sort(data, data + count, compare);
+				return;
+			}
+			int chunkSize = (count + chunkCount - 1) / chunkCount;
+			ParallelFor(0, chunkCount, 1, [&](int chunkId)
+			{
+				int chunkBegin = CoreLib::Basic::Math::Min(chunkId * chunkSize, count);
+				int chunkEnd = CoreLib::Basic::Math::Min(chunkBegin + chunkSize, count);
+				std::sort(data + chunkBegin, data + chunkEnd, compare);
+			});
+			CoreLib::Basic::List<T> tempBuffer;
+			tempBuffer.SetSize(count);
+			T * src = data;
+			T * dst = tempBuffer.Buffer();
+			for (int width = chunkSize; width < count; width *= 2)
+			{
+				int mergeCount = (count + width * 2 - 1) / (width * 2);
+				ParallelFor(0, mergeCount, 1, [&](int mergeId)
+				{
+					int mergeBegin = mergeId * width * 2;
+					int mid = CoreLib::Basic::Math::Min(mergeBegin + width, count);
+					int mergeEnd = CoreLib::Basic::Math::Min(mergeBegin + width * 2, count);
+					std::merge(std::make_move_iterator(src + mergeBegin), std::make_move_iterator(src + mid),
+						std::make_move_iterator(src + mid), std::make_move_iterator(src + mergeEnd), dst + mergeBegin, compare);
+				});
+				std::swap(src, dst);
+			}
+			if (src != data)
+			{
+				ParallelFor(0, count, [&](int i)
+				{
+					data[i] = _Move(src[i]);
+				});
+			}
+		}
+
+		template<typename T, typename Comparer>
+		void ParallelSort(CoreLib::Basic::List<T> & list, const Comparer & compare)
+		{
+			ParallelSort(list.Buffer(), list.Count(), compare);
+		}
+
+		template<typename T>
+		void ParallelSort(CoreLib::Basic::List<T> & list)
+		{
+			ParallelSort(list.Buffer(), list.Count(), [](const T & t1, const T & t2) {return t1 < t2; });
+		}
 	}
 }
 
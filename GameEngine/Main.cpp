@@ -100,6 +100,8 @@ int __stdcall wWinMain(
 				args.NoConsole = true;
 			if (parser.OptionExists("-headless"))
 				appParams.HeadlessMode = true;
+			if (parser.OptionExists("-no_pipelining"))
+				appParams.PipelinedRendering = false;
 			if (parser.OptionExists("-runforframes"))
 				appParams.RunForFrames = (int)StringToInt(parser.GetOptionValue("-runforframes"));
 			if (parser.OptionExists("-dumpstat"))
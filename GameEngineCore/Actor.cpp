@@ -38,6 +38,56 @@ namespace GameEngine
             AddDrawable(params, d.Ptr(), Bounds);
     }
 
+	static CoreLib::Graphics::BBox GetDrawableBounds(CoreLib::ArrayView<Drawable*> drawables)
+	{
+		CoreLib::Graphics::BBox bounds;
+		bounds.Init();
+		for (auto drawable : drawables)
+			bounds.Union(drawable->Bounds);
+		return bounds;
+	}
+
+	void Actor::InvalidateDrawables()
+	{
+		// the region of the old drawables changes now, the new drawables report theirs once they are collected
+		if (retainedDrawablesValid && level && retainedDrawables.Count())
+			level->StaticContentChanged(GetDrawableBounds(retainedDrawables.GetArrayView()));
+		retainedDrawablesValid = false;
+	}
+
+	bool Actor::CollectDrawables(const GetDrawablesParameter & params)
+	{
+		if (retainedDrawablesValid)
+		{
+			for (auto drawable : retainedDrawables)
+				params.sink->AddDrawable(drawable);
+			return false;
+		}
+		int opaqueStart = params.sink->GetDrawables(false).Count();
+		int transparentStart = params.sink->GetDrawables(true).Count();
+		GetDrawables(params);
+		if (RetainsDrawables())
+		{
+			auto opaqueDrawables = params.sink->GetDrawables(false);
+			auto transparentDrawables = params.sink->GetDrawables(true);
+			retainedDrawables.Clear();
+			retainedDrawables.AddRange(opaqueDrawables.Buffer() + opaqueStart, opaqueDrawables.Count() - opaqueStart);
+			retainedDrawables.AddRange(transparentDrawables.Buffer() + transparentStart, transparentDrawables.Count() - transparentStart);
+			for (auto drawable : retainedDrawables)
+				drawable->IsRetained = true;
+			retainedDrawablesValid = true;
+			if (level && retainedDrawables.Count())
+				level->StaticContentChanged(GetDrawableBounds(retainedDrawables.GetArrayView()));
+		}
+		return true;
+	}
+
+	void Actor::BoundsChanged()
+	{
+		if (level)
+			level->ActorBoundsChanged(this);
+	}
+
 	void Actor::Parse(Level * plevel, CoreLib::Text::TokenReader & parser, bool & isInvalid)
 	{
 		level = plevel;
@@ -17,6 +17,7 @@ namespace GameEngine
 	{
         Util, Drawable, Light, EnvMap, Atmosphere, BoundingVolume, Camera, UserController, ToneMapping, SSAO
 	};
+	const int EngineActorTypeCount = (int)EngineActorType::SSAO + 1;
 
 	class RendererService;
 	class DrawableSink;
@@ -35,8 +36,23 @@ namespace GameEngine
 
 	class Level;
 
+	// actors are ticked phase by phase. within a phase, actors that allow it are ticked
+	// concurrently, followed by the remaining actors in level order.
+	enum class TickPhase
+	{
+		PrePhysics, Animation, PostAnimation, Camera
+	};
+
 	class Actor : public PropertyContainer
 	{
+		friend class Level;
+	private:
+		// spatial index state maintained by Level
+		int spatialProxyId = -1, unboundedListIndex = -1, typeListIndex = -1;
+		bool isRegistered = false, boundsChangePending = false;
+		// drawables collected by the last GetDrawables() call of an actor that retains its drawables
+		CoreLib::List<Drawable*> retainedDrawables;
+		bool retainedDrawablesValid = false;
 	protected:
 		Level * level = nullptr;
     public:
@@ -52,11 +68,16 @@ namespace GameEngine
         void AddDrawable(const GetDrawablesParameter & params, Drawable * drawable, const CoreLib::Graphics::BBox & bounds);
         void AddDrawable(const GetDrawablesParameter & params, Drawable * drawable);
         void AddDrawable(const GetDrawablesParameter & params, ModelDrawableInstance * drawable);
+		// call after modifying Bounds so that the level's spatial index follows. safe to call from a parallel tick.
+		void BoundsChanged();
 
 	public:
 		CoreLib::Graphics::BBox Bounds;
 		CoreLib::List<CoreLib::RefPtr<Actor>> SubComponents;
 		virtual void Tick() { }
+		virtual TickPhase GetTickPhase() { return TickPhase::PostAnimation; }
+		// return true only if Tick() touches nothing but this actor's own state
+		virtual bool CanTickInParallel() { return false; }
 		virtual EngineActorType GetEngineType() = 0;
 		virtual void OnLoad() {};
 		virtual void OnUnload() {};
@@ -64,6 +85,12 @@ namespace GameEngine
 		virtual void Parse(Level * plevel, CoreLib::Text::TokenReader & parser, bool & isInvalid);
 		virtual void SerializeToText(CoreLib::StringBuilder & sb);
 		virtual void GetDrawables(const GetDrawablesParameter & /*params*/) {}
+		// return true if the drawables only change along with the properties of this actor. their drawables are
+		// collected once and reused until a property changes or InvalidateDrawables() is called.
+		virtual bool RetainsDrawables() { return false; }
+		void InvalidateDrawables();
+		// adds the drawables of this actor to params.sink, returns true if GetDrawables() was called to obtain them
+		bool CollectDrawables(const GetDrawablesParameter & params);
 		virtual CoreLib::String GetTypeName() { return "Actor"; }
 		void SetLevel(Level * plevel)
 		{
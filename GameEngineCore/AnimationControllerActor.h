@@ -25,6 +25,11 @@ namespace GameEngine
         }
         virtual void OnLoad();
         virtual void Tick();
+        // poses must be set before the target skeletal meshes tick
+        virtual TickPhase GetTickPhase() override
+        {
+            return TickPhase::PrePhysics;
+        }
     };
 }
 
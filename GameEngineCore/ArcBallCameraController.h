@@ -54,6 +54,10 @@ namespace GameEngine
 		virtual void OnLoad() override;
 		virtual void OnUnload() override;
 		virtual EngineActorType GetEngineType() override;
+		virtual TickPhase GetTickPhase() override
+		{
+			return TickPhase::Camera;
+		}
 		virtual CoreLib::String GetTypeName() override
 		{
 			return "ArcBallCameraController";
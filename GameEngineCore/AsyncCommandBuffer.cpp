@@ -6,14 +6,29 @@ namespace GameEngine
 	{
 		for (int i = 0; i < size; i++)
 			commandBuffers.Add(hwRender->CreateCommandBuffer());
+		contentHashes.SetSize(size);
+		for (auto & hash : contentHashes)
+			hash = 0;
 	}
 
 	CommandBuffer * AsyncCommandBuffer::BeginRecording(FrameBuffer * frameBuffer)
+	{
+		bool reused;
+		return BeginRecording(frameBuffer, 0, reused);
+	}
+
+	CommandBuffer * AsyncCommandBuffer::BeginRecording(FrameBuffer * frameBuffer, uint64_t contentHash, bool & reused)
 	{
 		framePtr++;
 		framePtr %= commandBuffers.Count();
 		auto rs = commandBuffers[framePtr].Ptr();
-		rs->BeginRecording(frameBuffer);
+		// the buffer was last submitted a full ring ago, so it has completed just like a buffer that is recorded again
+		reused = contentHash != 0 && contentHashes[framePtr] == contentHash;
+		if (!reused)
+		{
+			contentHashes[framePtr] = contentHash;
+			rs->BeginRecording(frameBuffer);
+		}
 		return rs;
 	}
 
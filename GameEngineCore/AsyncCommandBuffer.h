@@ -11,9 +11,13 @@ namespace GameEngine
 	private:
 		int framePtr = 0;
 		CoreLib::List<CoreLib::RefPtr<CommandBuffer>> commandBuffers;
+		CoreLib::List<uint64_t> contentHashes;
 	public:
 		AsyncCommandBuffer(HardwareRenderer * hwRender, int size = 3);
 		CommandBuffer * BeginRecording(FrameBuffer * frameBuffer);
+		// advances to the next buffer like BeginRecording. if that buffer was recorded with the same content hash it is
+		// returned unchanged and reused is set, otherwise recording is started. a content hash of 0 is never reused.
+		CommandBuffer * BeginRecording(FrameBuffer * frameBuffer, uint64_t contentHash, bool & reused);
 		CommandBuffer * GetBuffer();
 	};
 }
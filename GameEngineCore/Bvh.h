@@ -3,6 +3,7 @@
 
 #include "CoreLib/Basic.h"
 #include "CoreLib/Graphics/BBox.h"
+#include "CoreLib/Threading.h"
 #include "Ray.h"
 
 namespace GameEngine
@@ -365,8 +366,7 @@ namespace GameEngine
                 const int processorCount = 16;
                 BucketInfo buckets_proc[processorCount][nBuckets];
                 int blockSize = (int)(elementCount / processorCount);
-                #pragma omp parallel for
-                for (int procId = 0; procId < processorCount; procId++)
+                CoreLib::Threading::ParallelFor(0, processorCount, 1, [&](int procId)
                 {
                     int end;
                     if (procId == processorCount - 1)
@@ -381,7 +381,7 @@ namespace GameEngine
                         buckets_proc[procId][b].count++;
                         buckets_proc[procId][b].bounds.Union(elements[i].Bounds);
                     }
-                }
+                });
                 for (int i = 0; i < nBuckets; i++)
                 {
                     for (int j = 0; j < processorCount; j++)
@@ -451,14 +451,13 @@ namespace GameEngine
                 }
                 else
                 {
-                    #pragma omp parallel sections
+                    CoreLib::Threading::ParallelFor(0, 2, 1, [&](int childId)
                     {
-                        #pragma omp section
-                        node->Children[0] = ConstructBvhNode<T, CostEvaluator>(tree, elements, (int)(pmid - elements), listSize1, nodeCount1, eval, depth + 1);
-
-                        #pragma omp section
-                        node->Children[1] = ConstructBvhNode<T, CostEvaluator>(tree, pmid, (int)(elements + elementCount - pmid), listSize2, nodeCount2, eval, depth + 1);
-                    }
+                        if (childId == 0)
+                            node->Children[0] = ConstructBvhNode<T, CostEvaluator>(tree, elements, (int)(pmid - elements), listSize1, nodeCount1, eval, depth + 1);
+                        else
+                            node->Children[1] = ConstructBvhNode<T, CostEvaluator>(tree, pmid, (int)(elements + elementCount - pmid), listSize2, nodeCount2, eval, depth + 1);
+                    });
                 }
                 node->ElementCount = (int)(elementListSize = listSize1 + listSize2);
                 nodeCount += nodeCount1 + nodeCount2;
@@ -483,6 +482,53 @@ namespace GameEngine
         tree.Root = ConstructBvhNode<T, CostEvaluator>(tree, elements, elementCount, tree.ElementListSize, tree.NodeCount, eval, 0);
     }
 
+    // reciprocal of a ray direction for the slab tests. tiny components are replaced by a signed epsilon so that no
+    // slab test computes 0 * inf = NaN, the ray is parallel to the axes whose reciprocal reaches BvhParallelRcp
+    const float BvhParallelRcp = 1e20f;
+    inline VectorMath::Vec3 BvhRcpDir(VectorMath::Vec3 dir)
+    {
+        VectorMath::Vec3 rs;
+        for (int i = 0; i < 3; i++)
+        {
+            float d = dir[i];
+            if (d < 1e-20f && d > -1e-20f)
+                d = d < 0.0f ? -1e-20f : 1e-20f;
+            rs[i] = 1.0f / d;
+        }
+        return rs;
+    }
+
+    // slab test of a ray against a box. on axes the ray is parallel to, only the origin is tested against the slab,
+    // so that a ray starting on a plane of the box is not rejected
+    inline bool BvhRayBoxTest(const CoreLib::Graphics::BBox & box, const VectorMath::Vec3 & origin, const VectorMath::Vec3 & rcpDir,
+        float & tmin, float & tmax)
+    {
+        tmin = -FLT_MAX;
+        tmax = FLT_MAX;
+        for (int i = 0; i < 3; i++)
+        {
+            if (rcpDir[i] >= BvhParallelRcp || rcpDir[i] <= -BvhParallelRcp)
+            {
+                if (origin[i] < box.Min[i] || origin[i] > box.Max[i])
+                    return false;
+                continue;
+            }
+            float t0 = (box.Min[i] - origin[i]) * rcpDir[i];
+            float t1 = (box.Max[i] - origin[i]) * rcpDir[i];
+            if (rcpDir[i] < 0.0f)
+            {
+                float t = t0;
+                t0 = t1;
+                t1 = t;
+            }
+            if (t0 > tmin)
+                tmin = t0;
+            if (t1 < tmax)
+                tmax = t1;
+        }
+        return tmin <= tmax;
+    }
+
     template<typename T, typename Tracer, typename THit, bool pred>
     bool TraverseBvh(const Tracer & tracer, THit& rs, Bvh<T> & tree, const Ray & ray, VectorMath::Vec3 rcpDir)
     {
@@ -496,7 +542,7 @@ namespace GameEngine
         while (true)
         {
             float t1, t2;
-            if (RayBBoxIntersection_RcpDir(node->Bounds, ray.Origin, rcpDir, t1, t2) && t1 < traceRay.tMax)
+            if (BvhRayBoxTest(node->Bounds, ray.Origin, rcpDir, t1, t2) && t1 < traceRay.tMax)
             {
                 if (node->ElementCount > 0)
                 {
@@ -40,6 +40,10 @@ namespace GameEngine
 		View GetView();
 		CoreLib::Graphics::ViewFrustum GetFrustum(float aspect);
 		virtual void Tick() override { }
+		virtual TickPhase GetTickPhase() override
+		{
+			return TickPhase::Camera;
+		}
 		virtual EngineActorType GetEngineType() override
 		{
 			return EngineActorType::Camera;
@@ -3102,6 +3102,14 @@ public:
         CORELIB_ASSERT(threadId < MaxRenderThreads);
         renderThreadId = threadId;
     }
+    virtual int GetThreadId() override
+    {
+        return renderThreadId;
+    }
+    virtual int GetMaxThreadCount() override
+    {
+        return MaxRenderThreads;
+    }
 
     virtual void BeginJobSubmission() override
     {
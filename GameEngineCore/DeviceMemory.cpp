@@ -4,6 +4,27 @@
 
 namespace GameEngine
 {
+	// unchanged bytes between two updates are copied along with them rather than starting another copy
+	const int MaxCoalescedUploadGap = 4096;
+
+	void CoalesceUploadRanges(CoreLib::List<UploadRange> & ranges, int maxGap)
+	{
+		if (ranges.Count() < 2)
+			return;
+		ranges.Sort([](const UploadRange & r1, const UploadRange & r2) { return r1.Offset < r2.Offset; });
+		int count = 1;
+		for (int i = 1; i < ranges.Count(); i++)
+		{
+			auto & last = ranges[count - 1];
+			auto & range = ranges[i];
+			if (range.Offset <= last.Offset + last.Length + maxGap)
+				last.Length = CoreLib::Math::Max(last.Length, range.Offset + range.Length - last.Offset);
+			else
+				ranges[count++] = range;
+		}
+		ranges.SetSize(count);
+	}
+
 void DeviceMemory::Init(HardwareRenderer *hwRenderer, BufferUsage usage, bool pIsMapped, int log2BufferSize,
     int alignment, BufferStructureInfo *structInfo)
 	{
@@ -38,17 +59,47 @@ void DeviceMemory::Init(HardwareRenderer *hwRenderer, BufferUsage usage, bool pI
 		memory.Free((unsigned char*)ptr, size);
 	}
 
+	void DeviceMemory::Upload(int offset, int length)
+	{
+		if (coalesceUploads)
+		{
+			std::lock_guard<std::mutex> lock(pendingUploadsMutex);
+			pendingUploads.Add(UploadRange{ offset, length });
+		}
+		else
+			buffer->SetDataAsync(offset, bufferPtr + offset, length);
+	}
+
 	void DeviceMemory::Sync(void * ptr, int size)
 	{
 		if (!isMapped)
-			buffer->SetDataAsync((int)((unsigned char*)ptr - bufferPtr), ptr, size);
+			Upload((int)((unsigned char*)ptr - bufferPtr), size);
 	}
 
 	void DeviceMemory::SetDataAsync(int offset, void * data, int length)
 	{
 		memcpy(bufferPtr + offset, data, length);
 		if (!isMapped)
-			buffer->SetDataAsync(offset, bufferPtr + offset, length);
+			Upload(offset, length);
+	}
+
+	int DeviceMemory::FlushUploads(int64_t & uploadedBytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(pendingUploadsMutex);
+			if (pendingUploads.Count() == 0)
+				return 0;
+			CoreLib::Swap(pendingUploads, flushingUploads);
+		}
+		CoalesceUploadRanges(flushingUploads, MaxCoalescedUploadGap);
+		for (auto & range : flushingUploads)
+		{
+			buffer->SetDataAsync(range.Offset, bufferPtr + range.Offset, range.Length);
+			uploadedBytes += range.Length;
+		}
+		int copyCount = flushingUploads.Count();
+		flushingUploads.Clear();
+		return copyCount;
 	}
 
 }
@@ -3,9 +3,19 @@
 
 #include "CoreLib/MemoryPool.h"
 #include "HardwareRenderer.h"
+#include <mutex>
 
 namespace GameEngine
 {
+	struct UploadRange
+	{
+		int Offset;
+		int Length;
+	};
+
+	// sorts ranges by offset and merges ranges that overlap or are at most maxGap bytes apart
+	void CoalesceUploadRanges(CoreLib::List<UploadRange> & ranges, int maxGap);
+
 	class DeviceMemory
 	{
 	private:
@@ -13,6 +23,10 @@ namespace GameEngine
 		CoreLib::RefPtr<Buffer> buffer;
 		unsigned char * bufferPtr = nullptr;
 		bool isMapped;
+		bool coalesceUploads = false;
+		std::mutex pendingUploadsMutex;
+		CoreLib::List<UploadRange> pendingUploads, flushingUploads;
+		void Upload(int offset, int length);
 	public:
 		DeviceMemory() {}
 		~DeviceMemory();
@@ -30,6 +44,14 @@ namespace GameEngine
 			return bufferPtr;
 		}
 		void SetDataAsync(int offset, void * data, int length);
+		// when enabled, updates of an unmapped buffer are only written to the cpu copy and remembered. FlushUploads
+		// then copies them to the device in a few large ranges. callers must flush before the device reads the data.
+		void SetCoalesceUploads(bool value)
+		{
+			coalesceUploads = value;
+		}
+		// returns the number of copies issued, and adds the copied size to uploadedBytes
+		int FlushUploads(int64_t & uploadedBytes);
 	};
 }
 
@@ -15,16 +15,18 @@ namespace GameEngine
 		lblNumMaterials = new Label(this);
 		lblCpuTime = new Label(this);
 		lblPipelineLookupTime = new Label(this);
+		lblPipelineWaitTime = new Label(this);
 
 		lblFps->Posit(emToPixel(0.5f), emToPixel(0.5f), emToPixel(20.0f), emToPixel(1.5f));
 		lblNumWorldPasses->Posit(emToPixel(0.5f), emToPixel(1.5f), emToPixel(20.0f), emToPixel(1.5f));
 		lblNumDrawCalls->Posit(emToPixel(0.5f), emToPixel(2.5f), emToPixel(20.0f), emToPixel(1.5f));
 		lblCpuTime->Posit(emToPixel(0.5f), emToPixel(3.5f), emToPixel(20.0f), emToPixel(1.5f));
 		lblPipelineLookupTime->Posit(emToPixel(0.5f), emToPixel(4.5f), emToPixel(20.0f), emToPixel(1.5f));
-		lblNumShaders->Posit(emToPixel(0.5f), emToPixel(5.5f), emToPixel(20.0f), emToPixel(1.5f));
-		lblNumMaterials->Posit(emToPixel(0.5f), emToPixel(6.5f), emToPixel(20.0f), emToPixel(1.5f));
+		lblPipelineWaitTime->Posit(emToPixel(0.5f), emToPixel(5.5f), emToPixel(20.0f), emToPixel(1.5f));
+		lblNumShaders->Posit(emToPixel(0.5f), emToPixel(6.5f), emToPixel(20.0f), emToPixel(1.5f));
+		lblNumMaterials->Posit(emToPixel(0.5f), emToPixel(7.5f), emToPixel(20.0f), emToPixel(1.5f));
 		SetWidth(emToPixel(14.0f));
-		SetHeight(emToPixel(10.2f));
+		SetHeight(emToPixel(11.2f));
 	}
 
 	void DrawCallStatForm::SetNumDrawCalls(int val)
@@ -47,7 +49,7 @@ namespace GameEngine
 		lblNumWorldPasses->SetText("Passes: " + CoreLib::String(val));
 	}
 
-	void DrawCallStatForm::SetCpuTime(float time, float pipelineLookupTime)
+	void DrawCallStatForm::SetCpuTime(float time, float pipelineLookupTime, float pipelineWaitTime)
 	{
 		CoreLib::StringBuilder sb(256);
 		sb << "Renderer CPU: " << CoreLib::String(time*1000.0f, "%.1f") << "ms";
@@ -55,6 +57,9 @@ namespace GameEngine
 		sb.Clear();
 		sb << "PipelineLookup: " << CoreLib::String(pipelineLookupTime * 1000.0f, "%.1f") << "ms";
 		lblPipelineLookupTime->SetText(sb.ToString());
+		sb.Clear();
+		sb << "PipelineWait: " << CoreLib::String(pipelineWaitTime * 1000.0f, "%.1f") << "ms";
+		lblPipelineWaitTime->SetText(sb.ToString());
 	}
 
 	void DrawCallStatForm::SetFrameRenderTime(float val)
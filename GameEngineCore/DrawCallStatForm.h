@@ -17,6 +17,7 @@ namespace GameEngine
 		GraphicsUI::Label * lblFps;
 		GraphicsUI::Label * lblCpuTime;
 		GraphicsUI::Label * lblPipelineLookupTime;
+		GraphicsUI::Label * lblPipelineWaitTime;
 
 	public:
 		DrawCallStatForm(GraphicsUI::UIEntry * parent);
@@ -24,7 +25,7 @@ namespace GameEngine
 		void SetNumShaders(int val);
 		void SetNumMaterials(int val);
 		void SetNumWorldPasses(int val);
-		void SetCpuTime(float time, float pipelineLookupTime);
+		void SetCpuTime(float time, float pipelineLookupTime, float pipelineWaitTime);
 		void SetFrameRenderTime(float val);
 
 	};
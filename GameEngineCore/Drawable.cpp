@@ -10,6 +10,7 @@ namespace GameEngine
         lightmapId = DeviceLightmapSet::InvalidDeviceLightmapId;
 		Bounds.Min = VectorMath::Vec3::Create(-1e9f);
 		Bounds.Max = VectorMath::Vec3::Create(1e9f);
+		VectorMath::Matrix4::CreateIdentityMatrix(localTransform);
 		pipelineCache.SetSize(pipelineCache.GetCapacity());
 		for (auto & p : pipelineCache)
 			p = nullptr;
@@ -15,6 +15,7 @@ namespace GameEngine
 	class PipelineContext;
 	class SceneResource;
 	class Pose;
+	class SkinningPalette;
 	class RetargetFile;
 
 	class DrawableMesh : public CoreLib::RefObject
@@ -80,6 +81,8 @@ namespace GameEngine
         PrimitiveType primType = PrimitiveType::Triangles;
 		CoreLib::RefPtr<DrawableMesh> mesh = nullptr;
 		MeshElementRange elementRange;
+		Mesh * sourceMesh = nullptr;
+		VectorMath::Matrix4 localTransform;
 		Material * material = nullptr;
 		ModuleInstance * transformModule = nullptr;
 		Skeleton * skeleton = nullptr;
@@ -90,7 +93,9 @@ namespace GameEngine
 		CoreLib::Graphics::BBox Bounds;
 		bool CastShadow = true;
         bool RenderCustomDepth = false;
-		unsigned int ReorderKey = 0;
+		// retained by its actor, so its changes are recorded by Level::StaticContentChanged()
+		bool IsRetained = false;
+		uint64_t ReorderKey = 0; // see DrawSortKey
 		Drawable(SceneResource * sceneRes);
 		~Drawable();
 		PipelineClass * GetPipeline(int passId, PipelineContext & pipelineManager);
@@ -103,6 +108,10 @@ namespace GameEngine
 		{
 			return mesh.Ptr();
 		}
+		inline DrawableType GetType()
+		{
+			return type;
+		}
 		inline Material* GetMaterial()
 		{
 			return material;
@@ -119,11 +128,26 @@ namespace GameEngine
 		{
 			return elementRange;
 		}
+		// cpu side geometry of a static drawable whose mesh outlives it, nullptr otherwise
+		inline Mesh * GetSourceMesh()
+		{
+			return sourceMesh;
+		}
+		inline const VectorMath::Matrix4 & GetLocalTransform()
+		{
+			return localTransform;
+		}
+		inline Skeleton * GetSkeleton()
+		{
+			return skeleton;
+		}
 		void UpdateMaterialUniform();
         void UpdateLightmapIndex(uint32_t lightmapIndex);
 		void UpdateTransformUniform(const VectorMath::Matrix4 & localTransform);
 		void UpdateTransformUniform(const VectorMath::Matrix4 & localTransform, const Pose & pose, RetargetFile * retarget = nullptr, 
 			BlendShapeWeightInfo *blendShapeInfo = nullptr);
+		void UpdateTransformUniform(const VectorMath::Matrix4 & localTransform, const SkinningPalette & palette,
+			BlendShapeWeightInfo *blendShapeInfo = nullptr);
 	};
 
 	class DrawableSink
@@ -0,0 +1,110 @@
+#include "DrawableSorter.h"
+#include "Drawable.h"
+#include <string.h>
+
+using namespace CoreLib;
+using namespace VectorMath;
+
+namespace GameEngine
+{
+	void RadixSort(List<SortKeyEntry> & entries, List<SortKeyEntry> & scratch)
+	{
+		const int radixBits = 8;
+		const int bucketCount = 1 << radixBits;
+		const int passCount = 64 / radixBits;
+		int count = entries.Count();
+		if (count < 2)
+			return;
+		// histograms of all passes are gathered in a single sweep
+		int histograms[passCount][bucketCount];
+		memset(histograms, 0, sizeof(histograms));
+		for (auto & entry : entries)
+		{
+			for (int pass = 0; pass < passCount; pass++)
+				histograms[pass][(entry.Key >> (pass * radixBits)) & (bucketCount - 1)]++;
+		}
+		scratch.SetSize(count);
+		auto src = entries.Buffer();
+		auto dst = scratch.Buffer();
+		for (int pass = 0; pass < passCount; pass++)
+		{
+			int shift = pass * radixBits;
+			auto & histogram = histograms[pass];
+			if (histogram[(src[0].Key >> shift) & (bucketCount - 1)] == count)
+				continue;
+			int offset = 0;
+			for (auto & bucket : histogram)
+			{
+				int bucketSize = bucket;
+				bucket = offset;
+				offset += bucketSize;
+			}
+			for (int i = 0; i < count; i++)
+				dst[histogram[(src[i].Key >> shift) & (bucketCount - 1)]++] = src[i];
+			auto tmp = src;
+			src = dst;
+			dst = tmp;
+		}
+		if (src != entries.Buffer())
+			Swap(entries, scratch);
+	}
+
+	// the upper bits of a non-negative float grow with its value, giving a quantization that is finer near the viewer
+	static uint32_t DistanceBits(float distance)
+	{
+		float d = Math::Max(distance, 0.0f);
+		uint32_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		return bits;
+	}
+
+	uint64_t DrawSortKey::Make(int layer, int pipelineId, int materialId, DrawableMesh * mesh, const MeshElementRange & range, float distance)
+	{
+		// drawables of the same mesh element get the same id, which keeps them adjacent for instancing
+		uint32_t meshHash = (uint32_t)(((size_t)mesh >> 4) * 2654435761u) ^ (uint32_t)(range.StartIndex * 40503u);
+		uint64_t key = (uint64_t)(layer & 0xF) << 60;
+		key |= (uint64_t)(pipelineId & 0x3FFF) << 46;
+		key |= (uint64_t)(materialId & 0x3FFF) << 32;
+		key |= (uint64_t)(meshHash >> 16) << 16;
+		key |= DistanceBits(distance) >> 16;
+		return key;
+	}
+
+	uint64_t DrawSortKey::MakeBackToFront(int layer, float distance)
+	{
+		return ((uint64_t)(layer & 0xF) << 60) | (uint64_t)(~DistanceBits(distance));
+	}
+
+	void DrawableSorter::Reorder(List<Drawable*> & drawables)
+	{
+		RadixSort(entries, scratch);
+		sorted.SetSize(drawables.Count());
+		for (int i = 0; i < entries.Count(); i++)
+			sorted[i] = drawables[entries[i].Index];
+		Swap(drawables, sorted);
+	}
+
+	void DrawableSorter::SortByKey(List<Drawable*> & drawables)
+	{
+		entries.SetSize(drawables.Count());
+		for (int i = 0; i < drawables.Count(); i++)
+		{
+			entries[i].Key = drawables[i]->ReorderKey;
+			entries[i].Index = i;
+		}
+		Reorder(drawables);
+	}
+
+	void DrawableSorter::SortBackToFront(List<Drawable*> & drawables, Vec3 viewPos)
+	{
+		entries.SetSize(drawables.Count());
+		for (int i = 0; i < drawables.Count(); i++)
+		{
+			auto drawable = drawables[i];
+			int layer = drawable->IsTransparent() ? DrawSortKey::TransparentLayer : DrawSortKey::OpaqueLayer;
+			entries[i].Key = DrawSortKey::MakeBackToFront(layer, drawable->Bounds.Distance(viewPos));
+			entries[i].Index = i;
+		}
+		Reorder(drawables);
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef GAME_ENGINE_DRAWABLE_SORTER_H
+#define GAME_ENGINE_DRAWABLE_SORTER_H
+
+#include "CoreLib/Basic.h"
+#include "CoreLib/VectorMath.h"
+
+namespace GameEngine
+{
+	class Drawable;
+	class DrawableMesh;
+	struct MeshElementRange;
+
+	struct SortKeyEntry
+	{
+		uint64_t Key;
+		int Index;
+	};
+
+	// stable LSD radix sort by key, one byte per pass. passes over a byte that is equal in all keys are skipped.
+	// scratch serves as the second buffer of each pass, its content is overwritten.
+	void RadixSort(CoreLib::List<SortKeyEntry> & entries, CoreLib::List<SortKeyEntry> & scratch);
+
+	// 64-bit draw order keys, compared as unsigned integers. from the most significant bit:
+	// layer (4 bits), pipeline (14 bits), material (14 bits), mesh element (16 bits), depth (16 bits).
+	// ids that do not fit are wrapped, which only affects how well draws are grouped.
+	class DrawSortKey
+	{
+	public:
+		static const int OpaqueLayer = 0;
+		static const int TransparentLayer = 1;
+		static uint64_t Make(int layer, int pipelineId, int materialId, DrawableMesh * mesh, const MeshElementRange & range, float distance);
+		// far to near within a layer, render states are not part of the key
+		static uint64_t MakeBackToFront(int layer, float distance);
+	};
+
+	class DrawableSorter
+	{
+	private:
+		CoreLib::List<SortKeyEntry> entries, scratch;
+		CoreLib::List<Drawable*> sorted;
+		void Reorder(CoreLib::List<Drawable*> & drawables);
+	public:
+		// sorts by Drawable::ReorderKey
+		void SortByKey(CoreLib::List<Drawable*> & drawables);
+		// sorts by the distance from viewPos to the bounding box of each drawable, farthest first
+		void SortBackToFront(CoreLib::List<Drawable*> & drawables, VectorMath::Vec3 viewPos);
+	};
+}
+
+#endif
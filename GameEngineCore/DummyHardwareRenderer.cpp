@@ -1,21 +1,41 @@
 #include "HardwareRenderer.h"
 #include "CoreLib/Stream.h"
 #include "CoreLib/TextIO.h"
+#include <mutex>
 
 namespace GameEngine
 {
 namespace DummyRenderer
 {
+    // the command log is written by the game thread, the render thread and the objects the renderer creates
+    class CommandLog : public CoreLib::RefObject
+    {
+        CoreLib::IO::StreamWriter writer;
+        std::mutex writerMutex;
+    public:
+        CommandLog(const CoreLib::String & fileName)
+            : writer(fileName)
+        {}
+        void Write(const CoreLib::String & line)
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            writer.Write(line);
+        }
+    };
+
     class Buffer : public GameEngine::Buffer
 	{
         CoreLib::List<unsigned char> bufferContent;
+        CoreLib::RefPtr<CommandLog> log;
 	public:
-        Buffer(int sizeInBytes)
+        Buffer(int sizeInBytes, CommandLog * commandLog)
+            : log(commandLog)
         {
             bufferContent.SetSize(sizeInBytes);
         }
 		virtual void SetDataAsync(int offset, void * data, int size) override
         {
+            log->Write(CoreLib::String("Upload Buffer (") + CoreLib::String(size) + " bytes)\n");
             SetData(offset, data, size);
         }
 		virtual void SetData(int offset, void* data, int size) override
@@ -181,12 +201,12 @@ namespace DummyRenderer
 
     class PipelineBuilder : public virtual GameEngine::PipelineBuilder
 	{
-        CoreLib::IO::StreamWriter *writer;
+        CoreLib::RefPtr<CommandLog> log;
         CoreLib::String pipelineName;
 
     public:
-        PipelineBuilder(CoreLib::IO::StreamWriter *streamWriter)
-            : writer(streamWriter) {}
+        PipelineBuilder(CommandLog * commandLog)
+            : log(commandLog) {}
 	public:
 		virtual void SetShaders(CoreLib::ArrayView<GameEngine::Shader*> /*shaders*/) override {}
 		virtual void SetVertexLayout(VertexFormat /*vertexFormat*/) override {}
@@ -197,16 +217,12 @@ namespace DummyRenderer
         }
         virtual GameEngine::Pipeline* ToPipeline(GameEngine::RenderTargetLayout* /*renderTargetLayout*/) override
         {
-            writer->Write("Create GraphicsPipeline ");
-            writer->Write(pipelineName);
-            writer->Write("\n");
+            log->Write(CoreLib::String("Create GraphicsPipeline ") + pipelineName + "\n");
             return new Pipeline();
         }
 		virtual GameEngine::Pipeline* CreateComputePipeline(CoreLib::ArrayView<GameEngine::DescriptorSetLayout*> /*descriptorSets*/, GameEngine::Shader* /*shader*/) override
         {
-            writer->Write("Create ComputePipeline ");
-            writer->Write(pipelineName);
-            writer->Write("\n");
+            log->Write(CoreLib::String("Create ComputePipeline ") + pipelineName + "\n");
             return new Pipeline();
         }
 	};
@@ -244,28 +260,30 @@ namespace DummyRenderer
     class HardwareRenderer : public GameEngine::HardwareRenderer
 	{
 	public:
-        CoreLib::RefPtr<CoreLib::IO::StreamWriter> writer;
+        CoreLib::RefPtr<CommandLog> log;
         HardwareRenderer()
         {
-            writer = new CoreLib::IO::StreamWriter("rendercommands.txt");
+            log = new CommandLog("rendercommands.txt");
         }
         virtual void ThreadInit(int /*threadId*/) override {}
+        virtual int GetThreadId() override { return 0; }
+        virtual int GetMaxThreadCount() override { return 1; }
         virtual void BeginJobSubmission() override {}
         virtual void QueueRenderPass(GameEngine::FrameBuffer * /*frameBuffer*/, bool /*clearFrameBuffer*/,
             CoreLib::ArrayView<GameEngine::CommandBuffer *> /*commands*/,
             PipelineBarriers /*barriers*/) override
         {
-            writer->Write("Execute RenderPass\n");
+            log->Write("Execute RenderPass\n");
         }
         virtual void QueueComputeTask(GameEngine::Pipeline* /*computePipeline*/, GameEngine::DescriptorSet* /*descriptorSet*/, 
             int /*x*/, int /*y*/, int /*z*/, PipelineBarriers /*barriers*/) override
         {
-            writer->Write("Execute ComputeTask\n");
+            log->Write("Execute ComputeTask\n");
         }
         virtual void EndJobSubmission(GameEngine::Fence* /*fence*/) override {}
 		virtual void Present(GameEngine::WindowSurface * /*surface*/, GameEngine::Texture2D* /*srcImage*/) override
         {
-            writer->Write("Present\n");
+            log->Write("Present\n");
         }
         virtual void Blit(GameEngine::Texture2D* /*dstImage*/, GameEngine::Texture2D* /*srcImage*/, VectorMath::Vec2i /*destOffset*/, SourceFlipMode /*flipSrc*/) override {}
 		virtual void Wait() override {}
@@ -277,115 +295,81 @@ namespace DummyRenderer
         }
 		virtual GameEngine::Buffer* CreateBuffer(BufferUsage /*usage*/, int sizeInBytes, const BufferStructureInfo* /*structInfo*/) override
         {
-            writer->Write("Create Buffer (");
-            writer->Write(CoreLib::String(sizeInBytes));
-            writer->Write(" bytes)\n");
-            return new Buffer(sizeInBytes);
+            log->Write(CoreLib::String("Create Buffer (") + CoreLib::String(sizeInBytes) + " bytes)\n");
+            return new Buffer(sizeInBytes, log.Ptr());
         }
 		virtual GameEngine::Buffer* CreateMappedBuffer(BufferUsage /*usage*/, int sizeInBytes, const BufferStructureInfo* /*structInfo*/) override
         {
-            writer->Write("Create Buffer (");
-            writer->Write(CoreLib::String(sizeInBytes));
-            writer->Write(" bytes)\n");
-            return new Buffer(sizeInBytes);
+            log->Write(CoreLib::String("Create Buffer (") + CoreLib::String(sizeInBytes) + " bytes)\n");
+            return new Buffer(sizeInBytes, log.Ptr());
         }
 		virtual GameEngine::Texture2D* CreateTexture2D(CoreLib::String /*name*/, int width, int height, StorageFormat /*format*/, DataType /*type*/, void* /*data*/) override
         {
-            writer->Write("Create Texture2D (");
-            writer->Write(CoreLib::String(width));
-            writer->Write("x");
-            writer->Write(CoreLib::String(height));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create Texture2D (") + CoreLib::String(width) + "x" + CoreLib::String(height) + ")\n");
             return new Texture2D();
         }
 		virtual GameEngine::Texture2D* CreateTexture2D(CoreLib::String /*name*/, TextureUsage /*usage*/, int width, int height, int /*mipLevelCount*/, StorageFormat /*format*/) override
         {
-            writer->Write("Create Texture2D (");
-            writer->Write(CoreLib::String(width));
-            writer->Write("x");
-            writer->Write(CoreLib::String(height));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create Texture2D (") + CoreLib::String(width) + "x" + CoreLib::String(height) + ")\n");
             return new Texture2D();
         }
 		virtual GameEngine::Texture2D* CreateTexture2D(CoreLib::String /*name*/, TextureUsage /*usage*/, int width, int height, int /*mipLevelCount*/, StorageFormat /*format*/, DataType /*type*/, CoreLib::ArrayView<void*> /*mipLevelData*/) override
         {
-            writer->Write("Create Texture2D (");
-            writer->Write(CoreLib::String(width));
-            writer->Write("x");
-            writer->Write(CoreLib::String(height));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create Texture2D (") + CoreLib::String(width) + "x" + CoreLib::String(height) + ")\n");
             return new Texture2D();
         }
 		virtual GameEngine::Texture2DArray* CreateTexture2DArray(CoreLib::String /*name*/, TextureUsage /*usage*/, int width, int height, int layers, int /*mipLevelCount*/, StorageFormat /*format*/) override
         {
-            writer->Write("Create Texture2DArray (");
-            writer->Write(CoreLib::String(width));
-            writer->Write("x");
-            writer->Write(CoreLib::String(height));
-            writer->Write("x");
-            writer->Write(CoreLib::String(layers));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create Texture2DArray (") + CoreLib::String(width) + "x" + CoreLib::String(height) + "x" + CoreLib::String(layers) + ")\n");
             return new Texture2DArray();
         }
 		virtual GameEngine::TextureCube* CreateTextureCube(CoreLib::String /*name*/, TextureUsage /*usage*/, int size, int /*mipLevelCount*/, StorageFormat /*format*/) override
         {
-            writer->Write("Create TextureCube (");
-            writer->Write(CoreLib::String(size));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create TextureCube (") + CoreLib::String(size) + ")\n");
             return new TextureCube();
         }
 		virtual GameEngine::TextureCubeArray* CreateTextureCubeArray(CoreLib::String /*name*/, TextureUsage /*usage*/, int size, int /*mipLevelCount*/, int cubemapCount, StorageFormat /*format*/) override
         {
-            writer->Write("Create TextureCubeArray (");
-            writer->Write(CoreLib::String(size));
-            writer->Write("x");
-            writer->Write(CoreLib::String(cubemapCount));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create TextureCubeArray (") + CoreLib::String(size) + "x" + CoreLib::String(cubemapCount) + ")\n");
             return new TextureCubeArray();
         }
 		virtual GameEngine::Texture3D* CreateTexture3D(CoreLib::String /*name*/, TextureUsage /*usage*/, int width, int height, int depth, int /*mipLevelCount*/, StorageFormat /*format*/) override
         {
-            writer->Write("Create Texture3D (");
-            writer->Write(CoreLib::String(width));
-            writer->Write("x");
-            writer->Write(CoreLib::String(height));
-            writer->Write("x");
-            writer->Write(CoreLib::String(depth));
-            writer->Write(")\n");
+            log->Write(CoreLib::String("Create Texture3D (") + CoreLib::String(width) + "x" + CoreLib::String(height) + "x" + CoreLib::String(depth) + ")\n");
             return new Texture3D();
         }
 		virtual GameEngine::TextureSampler* CreateTextureSampler() override
         {
-            writer->Write("Create TextureSampler\n");
+            log->Write("Create TextureSampler\n");
             return new TextureSampler();
         }
 		virtual GameEngine::Shader* CreateShader(ShaderType /*stage*/, const char* /*data*/, int /*size*/) override
         {
-            writer->Write("Create Shader\n");
+            log->Write("Create Shader\n");
             return new Shader();
         }
 		virtual GameEngine::RenderTargetLayout* CreateRenderTargetLayout(CoreLib::ArrayView<AttachmentLayout> /*bindings*/, bool /*ignoreInitialContent*/) override
         {
-            writer->Write("Create RenderTargetLayout\n");
+            log->Write("Create RenderTargetLayout\n");
             return new RenderTargetLayout();
         }
 		virtual GameEngine::PipelineBuilder* CreatePipelineBuilder() override
         {
-            return new PipelineBuilder(writer.Ptr());
+            return new PipelineBuilder(log.Ptr());
         }
 		virtual GameEngine::DescriptorSetLayout* CreateDescriptorSetLayout(CoreLib::ArrayView<DescriptorLayout> /*descriptors*/) override
         {
-            writer->Write("Create DescriptorSetLayout\n");
+            log->Write("Create DescriptorSetLayout\n");
             return new DescriptorSetLayout();
         }
 		virtual GameEngine::DescriptorSet* CreateDescriptorSet(GameEngine::DescriptorSetLayout* /*layout*/) override
         {
-            writer->Write("Create DescriptorSet\n");
+            log->Write("Create DescriptorSet\n");
             return new DescriptorSet();
         }
 		virtual GameEngine::CommandBuffer* CreateCommandBuffer() override
         {
-            writer->Write("Create CommandBuffer\n");
+            log->Write("Create CommandBuffer\n");
             return new CommandBuffer();
         }
 		virtual TargetShadingLanguage GetShadingLanguage() override { return TargetShadingLanguage::SPIRV; }
@@ -393,7 +377,7 @@ namespace DummyRenderer
 		virtual int StorageBufferAlignment() override { return 16; }
         virtual GameEngine::WindowSurface * CreateSurface(WindowHandle /*windowHandle*/, int /*width*/, int /*height*/) override
         {
-            writer->Write("Create Surface\n");
+            log->Write("Create Surface\n");
             return new WindowSurface();
         }
 		virtual CoreLib::String GetRendererName() override
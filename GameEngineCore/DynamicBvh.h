@@ -0,0 +1,293 @@
+#ifndef GAME_ENGINE_DYNAMIC_BVH_H
+#define GAME_ENGINE_DYNAMIC_BVH_H
+
+#include "CoreLib/Basic.h"
+#include "CoreLib/Graphics/BBox.h"
+
+namespace GameEngine
+{
+    // a bounding volume hierarchy that supports inserting, removing and moving elements without a rebuild.
+    // leaf boxes are enlarged by a margin so that small movements do not touch the tree, and the tree is
+    // kept balanced with rotations as leaves come and go.
+    template<typename T>
+    class DynamicBvh
+    {
+    public:
+        static const int NullNode = -1;
+        static const int MaxQueryDepth = 128;
+        struct Node
+        {
+            CoreLib::Graphics::BBox Bounds;
+            T Element = T();
+            int Parent = NullNode; // next free node while the node is on the free list
+            int Children[2] = { NullNode, NullNode };
+            int Height = -1; // 0 for leaves, -1 for free nodes
+            inline bool IsLeaf() const
+            {
+                return Children[0] == NullNode;
+            }
+        };
+    private:
+        CoreLib::List<Node> nodes;
+        int root = NullNode;
+        int freeList = NullNode;
+        int elementCount = 0;
+        float marginRatio;
+
+        static float SurfaceArea(const CoreLib::Graphics::BBox & box)
+        {
+            auto size = box.Max - box.Min;
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+        static CoreLib::Graphics::BBox Combine(const CoreLib::Graphics::BBox & a, const CoreLib::Graphics::BBox & b)
+        {
+            CoreLib::Graphics::BBox rs = a;
+            rs.Union(b);
+            return rs;
+        }
+        static bool ContainsBox(const CoreLib::Graphics::BBox & outer, const CoreLib::Graphics::BBox & inner)
+        {
+            return outer.xMin <= inner.xMin && outer.yMin <= inner.yMin && outer.zMin <= inner.zMin &&
+                outer.xMax >= inner.xMax && outer.yMax >= inner.yMax && outer.zMax >= inner.zMax;
+        }
+        CoreLib::Graphics::BBox Enlarge(const CoreLib::Graphics::BBox & box)
+        {
+            auto size = box.Max - box.Min;
+            auto margin = VectorMath::Vec3::Create(CoreLib::Math::Max(size.x, CoreLib::Math::Max(size.y, size.z)) * marginRatio);
+            CoreLib::Graphics::BBox rs;
+            rs.Min = box.Min - margin;
+            rs.Max = box.Max + margin;
+            return rs;
+        }
+        int AllocNode()
+        {
+            if (freeList == NullNode)
+            {
+                nodes.Add(Node());
+                return nodes.Count() - 1;
+            }
+            int id = freeList;
+            freeList = nodes[id].Parent;
+            nodes[id] = Node();
+            return id;
+        }
+        void FreeNode(int id)
+        {
+            nodes[id].Element = T();
+            nodes[id].Height = -1;
+            nodes[id].Parent = freeList;
+            freeList = id;
+        }
+        void ReplaceChild(int parent, int oldChild, int newChild)
+        {
+            if (parent == NullNode)
+                root = newChild;
+            else if (nodes[parent].Children[0] == oldChild)
+                nodes[parent].Children[0] = newChild;
+            else
+                nodes[parent].Children[1] = newChild;
+        }
+        // moves child 'up' of node a into a's place, 'other' is the remaining child of a
+        int Rotate(int a, int up, int other)
+        {
+            int f = nodes[up].Children[0];
+            int g = nodes[up].Children[1];
+            int parent = nodes[a].Parent;
+            nodes[up].Children[0] = a;
+            nodes[up].Parent = parent;
+            nodes[a].Parent = up;
+            ReplaceChild(parent, a, up);
+            // the taller grandchild stays under 'up', the shorter one takes the place of 'up' under a
+            int keep = f, move = g;
+            if (nodes[f].Height < nodes[g].Height)
+            {
+                keep = g;
+                move = f;
+            }
+            nodes[up].Children[1] = keep;
+            if (nodes[a].Children[0] == up)
+                nodes[a].Children[0] = move;
+            else
+                nodes[a].Children[1] = move;
+            nodes[move].Parent = a;
+            nodes[a].Bounds = Combine(nodes[other].Bounds, nodes[move].Bounds);
+            nodes[a].Height = 1 + CoreLib::Math::Max(nodes[other].Height, nodes[move].Height);
+            nodes[up].Bounds = Combine(nodes[a].Bounds, nodes[keep].Bounds);
+            nodes[up].Height = 1 + CoreLib::Math::Max(nodes[a].Height, nodes[keep].Height);
+            return up;
+        }
+        int Balance(int a)
+        {
+            if (nodes[a].IsLeaf() || nodes[a].Height < 2)
+                return a;
+            int b = nodes[a].Children[0];
+            int c = nodes[a].Children[1];
+            int balance = nodes[c].Height - nodes[b].Height;
+            if (balance > 1)
+                return Rotate(a, c, b);
+            if (balance < -1)
+                return Rotate(a, b, c);
+            return a;
+        }
+        void RefitAncestors(int index)
+        {
+            while (index != NullNode)
+            {
+                index = Balance(index);
+                int child0 = nodes[index].Children[0];
+                int child1 = nodes[index].Children[1];
+                nodes[index].Height = 1 + CoreLib::Math::Max(nodes[child0].Height, nodes[child1].Height);
+                nodes[index].Bounds = Combine(nodes[child0].Bounds, nodes[child1].Bounds);
+                index = nodes[index].Parent;
+            }
+        }
+        void InsertLeaf(int leaf)
+        {
+            if (root == NullNode)
+            {
+                root = leaf;
+                nodes[leaf].Parent = NullNode;
+                return;
+            }
+            // descend to the sibling that minimizes the surface area added to the tree
+            auto leafBounds = nodes[leaf].Bounds;
+            int index = root;
+            while (!nodes[index].IsLeaf())
+            {
+                float area = SurfaceArea(nodes[index].Bounds);
+                float combinedArea = SurfaceArea(Combine(nodes[index].Bounds, leafBounds));
+                float cost = 2.0f * combinedArea;
+                float inheritanceCost = 2.0f * (combinedArea - area);
+                float childCost[2];
+                for (int i = 0; i < 2; i++)
+                {
+                    auto & child = nodes[nodes[index].Children[i]];
+                    childCost[i] = SurfaceArea(Combine(child.Bounds, leafBounds)) + inheritanceCost;
+                    if (!child.IsLeaf())
+                        childCost[i] -= SurfaceArea(child.Bounds);
+                }
+                if (cost < childCost[0] && cost < childCost[1])
+                    break;
+                index = nodes[index].Children[childCost[0] < childCost[1] ? 0 : 1];
+            }
+            int sibling = index;
+            int oldParent = nodes[sibling].Parent;
+            int newParent = AllocNode();
+            nodes[newParent].Parent = oldParent;
+            nodes[newParent].Bounds = Combine(leafBounds, nodes[sibling].Bounds);
+            nodes[newParent].Height = nodes[sibling].Height + 1;
+            nodes[newParent].Children[0] = sibling;
+            nodes[newParent].Children[1] = leaf;
+            nodes[sibling].Parent = newParent;
+            nodes[leaf].Parent = newParent;
+            ReplaceChild(oldParent, sibling, newParent);
+            RefitAncestors(oldParent);
+        }
+        void RemoveLeaf(int leaf)
+        {
+            if (leaf == root)
+            {
+                root = NullNode;
+                return;
+            }
+            int parent = nodes[leaf].Parent;
+            int grandParent = nodes[parent].Parent;
+            int sibling = nodes[parent].Children[0] == leaf ? nodes[parent].Children[1] : nodes[parent].Children[0];
+            ReplaceChild(grandParent, parent, sibling);
+            nodes[sibling].Parent = grandParent;
+            FreeNode(parent);
+            RefitAncestors(grandParent);
+        }
+    public:
+        // marginRatio: leaf boxes are enlarged by this fraction of their largest dimension
+        DynamicBvh(float pMarginRatio = 0.1f)
+            : marginRatio(pMarginRatio)
+        {}
+        // returns a proxy id that stays valid until the element is removed
+        int Insert(const CoreLib::Graphics::BBox & bounds, const T & element)
+        {
+            int leaf = AllocNode();
+            nodes[leaf].Bounds = Enlarge(bounds);
+            nodes[leaf].Element = element;
+            nodes[leaf].Height = 0;
+            InsertLeaf(leaf);
+            elementCount++;
+            return leaf;
+        }
+        void Remove(int proxyId)
+        {
+            RemoveLeaf(proxyId);
+            FreeNode(proxyId);
+            elementCount--;
+        }
+        // returns true if the new bounds escaped the enlarged leaf box and the element was reinserted
+        bool Move(int proxyId, const CoreLib::Graphics::BBox & bounds)
+        {
+            if (ContainsBox(nodes[proxyId].Bounds, bounds))
+                return false;
+            RemoveLeaf(proxyId);
+            nodes[proxyId].Bounds = Enlarge(bounds);
+            InsertLeaf(proxyId);
+            return true;
+        }
+        void Clear()
+        {
+            nodes.Clear();
+            root = freeList = NullNode;
+            elementCount = 0;
+        }
+        T & GetElement(int proxyId)
+        {
+            return nodes[proxyId].Element;
+        }
+        // the enlarged box stored for the element
+        const CoreLib::Graphics::BBox & GetBounds(int proxyId)
+        {
+            return nodes[proxyId].Bounds;
+        }
+        CoreLib::Graphics::BBox GetRootBounds()
+        {
+            CoreLib::Graphics::BBox rs;
+            if (root == NullNode)
+                rs.Init();
+            else
+                rs = nodes[root].Bounds;
+            return rs;
+        }
+        int GetHeight()
+        {
+            return root == NullNode ? 0 : nodes[root].Height;
+        }
+        int Count()
+        {
+            return elementCount;
+        }
+        // calls f(proxyId, element) for every leaf whose enlarged box passes boxTest.
+        // boxTest is also applied to interior nodes, so it must accept any box that contains an accepted box.
+        template<typename BoxTest, typename Func>
+        void Query(const BoxTest & boxTest, const Func & f)
+        {
+            if (root == NullNode)
+                return;
+            CoreLib::Array<int, MaxQueryDepth> stack;
+            stack.Add(root);
+            while (stack.Count())
+            {
+                int index = stack[stack.Count() - 1];
+                stack.SetSize(stack.Count() - 1);
+                auto & node = nodes[index];
+                if (!boxTest(node.Bounds))
+                    continue;
+                if (node.IsLeaf())
+                    f(index, node.Element);
+                else
+                {
+                    stack.Add(node.Children[0]);
+                    stack.Add(node.Children[1]);
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "FreeRoamCameraController.h"
 #include "CoreLib/LibIO.h"
 #include "CoreLib/Tokenizer.h"
+#include "CoreLib/Threading.h"
 #include "EngineLimits.h"
 #include "CoreLib/Imaging/Bitmap.h"
 #include "UISystemBase.h"
@@ -73,6 +74,7 @@ namespace GameEngine
             frameId++;
             if (frameId == params.RunForFrames)
             {
+                FinishPendingFrame();
                 if (params.DumpRenderStats)
                 {
                     StringBuilder sb;
@@ -81,7 +83,14 @@ namespace GameEngine
                         if (rs.Divisor != 0)
                         {
                             sb << String(rs.CpuTime * 1000.0f / rs.Divisor, "%.1f") << "\t" << String(rs.TotalTime * 1000.0f / rs.Divisor, "%.1f")
-                                << "\t" << rs.NumDrawCalls / rs.Divisor << "\n";
+                                << "\t" << rs.NumDrawCalls / rs.Divisor << "\t" << rs.NumOccludedDrawables / rs.Divisor
+                                << "\t" << rs.NumInstancedDrawables / rs.Divisor
+                                << "\t" << String(rs.PipelineWaitTime * 1000.0f / rs.Divisor, "%.1f")
+                                << "\t" << String(rs.PipelineCompileTime * 1000.0f / rs.Divisor, "%.1f")
+                                << "\t" << rs.NumReusedCommandBuffers / rs.Divisor
+                                << "\t" << rs.NumUploadCopies / rs.Divisor << "\t" << (int)(rs.NumUploadBytes / rs.Divisor)
+                                << "\t" << (int)(rs.TransientMemory / rs.Divisor)
+                                << "\t" << rs.NumShadowDrawCalls / rs.Divisor << "\n";
                         }
                     }
                     CoreLib::IO::File::WriteAllText(params.RenderStatsDumpFileName, sb.ProduceString());
@@ -112,6 +121,7 @@ namespace GameEngine
 	{
 		if (!inDataTransfer)
 		{
+			renderer->WaitForFrame();
             for (auto sysWindow : uiSystemInterface->windowContexts)
             {
                 auto entry = sysWindow.Value->uiEntry.Ptr();
@@ -137,6 +147,7 @@ namespace GameEngine
 		try
 		{
             params = args.LaunchParams;
+            gameThreadId = std::this_thread::get_id();
 
 			if (params.HeadlessMode)
 				Print("Running in headless mode.\n");
@@ -325,14 +336,21 @@ namespace GameEngine
 				levelToLoad = "";
 			}
 		}
+		// game logic of this frame runs while the render thread is still submitting the previous frame
+		level->TickActors(TickPhase::PrePhysics);
 		level->GetPhysicsScene().Tick();
-		for (auto & actor : level->Actors)
-			actor.Value->Tick();
+		level->TickActors(TickPhase::Animation);
+		level->TickActors(TickPhase::PostAnimation);
+		level->TickActors(TickPhase::Camera);
 		if (levelEditor)
 		{
 			levelEditor->Tick();
 		}
+		level->UpdateSpatialIndex();
 		lastGameLogicTime = thisGameLogicTime;
+
+		FinishPendingFrame();
+
 		auto &stats = renderer->GetStats();
 		auto thisRenderingTime = PerformanceCounter::Start();
 		renderingTimeDelta = PerformanceCounter::EndSeconds(lastRenderingTime);
@@ -341,7 +359,8 @@ namespace GameEngine
 		if (stats.Divisor == 0)
 			stats.StartTime = thisRenderingTime;
         
-		for (auto & f : syncFences[frameCounter % DynamicBufferLengthMultiplier])
+		int version = frameCounter % DynamicBufferLengthMultiplier;
+		for (auto & f : syncFences[version])
 		{
 			f->Wait();
 			f->Reset();
@@ -349,11 +368,41 @@ namespace GameEngine
 		
 		inDataTransfer = true;
 
-		renderer->GetHardwareRenderer()->ResetTempBufferVersion(frameCounter % DynamicBufferLengthMultiplier);
+		renderer->GetHardwareRenderer()->ResetTempBufferVersion(version);
+
+		bool canOverlap = renderer->ExtractFrame() && params.PipelinedRendering &&
+			engineMode == EngineMode::Normal && !params.EnableVideoCapture;
+		if (canOverlap)
+		{
+			renderer->RenderFrameAsync();
+			hasPendingFrame = true;
+			pendingFrameVersion = version;
+		}
+		else
+		{
+			renderer->RenderFrame();
+			PresentFrame(version);
+		}
+
+		inDataTransfer = false;
+		frameCounter++;
+	}
 
+	void Engine::FinishPendingFrame()
+	{
+		if (!hasPendingFrame)
+			return;
+		hasPendingFrame = false;
+		renderer->WaitForFrame();
+		inDataTransfer = true;
+		PresentFrame(pendingFrameVersion);
+		inDataTransfer = false;
+	}
+
+	void Engine::PresentFrame(int version)
+	{
+		auto &stats = renderer->GetStats();
 		auto cpuTimePoint = CoreLib::Diagnostics::PerformanceCounter::Start();
-		
-		renderer->RenderFrame();
 
         for (auto && sysWindow : uiSystemInterface->windowContexts)
         {
@@ -367,7 +416,6 @@ namespace GameEngine
 		stats.CpuTime += CoreLib::Diagnostics::PerformanceCounter::EndSeconds(cpuTimePoint);
 
 		int fenceAlloc = 0;
-		int version = frameCounter % DynamicBufferLengthMultiplier;
 		syncFences[version].Clear();
 		for (auto && sysWindow : uiSystemInterface->windowContexts)
 		{
@@ -391,8 +439,6 @@ namespace GameEngine
             renderer->GetHardwareRenderer()->Present(sysWindow.Value->surface.Ptr(), sysWindow.Value->uiOverlayTexture.Ptr());
 		}
 
-		inDataTransfer = false;
-
 		if (aggregateTime > 1.0f)
 		{
 			drawCallStatForm->SetNumShaders(stats.NumShaders);
@@ -404,7 +450,8 @@ namespace GameEngine
 			drawCallStatForm->SetFrameRenderTime(aggregateTime / stats.Divisor);
 			drawCallStatForm->SetNumDrawCalls(stats.NumDrawCalls / stats.Divisor);
 			drawCallStatForm->SetNumWorldPasses(stats.NumPasses / stats.Divisor);
-			drawCallStatForm->SetCpuTime(stats.CpuTime / stats.Divisor, stats.PipelineLookupTime / stats.Divisor);
+			drawCallStatForm->SetCpuTime(stats.CpuTime / stats.Divisor, stats.PipelineLookupTime / stats.Divisor,
+				stats.PipelineWaitTime / stats.Divisor);
 			static int ptr = 0;
 			stats.TotalTime = CoreLib::Diagnostics::PerformanceCounter::EndSeconds(stats.StartTime);
 			renderStats[ptr%renderStats.Count()] = stats;
@@ -412,7 +459,6 @@ namespace GameEngine
 			stats.Clear();
 			aggregateTime = 0.0f;
 		}
-		frameCounter++;
 	}
 
 	void Engine::Resize()
@@ -546,6 +592,12 @@ namespace GameEngine
 	void Engine::SetEngineMode(EngineMode newMode)
 	{
 		engineMode = newMode;
+		// drawables render custom depth differently in editor mode
+		if (level)
+		{
+			for (auto & actor : level->Actors)
+				actor.Value->InvalidateDrawables();
+		}
 	}
 
 	SystemWindow * Engine::CreateSystemWindow(int log2BufferSize)
@@ -758,6 +810,7 @@ namespace GameEngine
 		delete instance;
 		instance = nullptr;
 		PropertyContainer::FreeRegistry();
+		CoreLib::Threading::TaskScheduler::Destroy();
 	}
 	void Engine::SaveImage(Texture2D * image, String fileName, bool reverseY)
 	{
@@ -3,6 +3,7 @@
 
 #include "CoreLib/Basic.h"
 #include "CoreLib/PerformanceCounter.h"
+#include "CoreLib/Threading.h"
 #include "Level.h"
 #include "CoreLib/Tokenizer.h"
 #include "InputDispatcher.h"
@@ -30,6 +31,7 @@ namespace GameEngine
         int FramesPerSecond = 30;
         int RunForFrames = 0; // run for this many frames and then terminate
 		bool HeadlessMode = false;
+        bool PipelinedRendering = true; // overlap game logic of frame N+1 with render submission of frame N
         int ForceDPI = 0;
     };
 	class EngineInitArguments
@@ -72,6 +74,9 @@ namespace GameEngine
 		float fixedFrameDuration = 1.0f / 30.0f;
 		unsigned int frameCounter = 0;
 		bool inDataTransfer = false;
+		bool hasPendingFrame = false;
+		int pendingFrameVersion = 0;
+		std::thread::id gameThreadId;
 		bool isRunning = false;
 		bool useSoftwareRenderer = false;
 		TargetShadingLanguage targetShadingLanguage = TargetShadingLanguage::SPIRV;
@@ -101,6 +106,8 @@ namespace GameEngine
 		DrawCallStatForm * drawCallStatForm = nullptr;
 		CoreLib::RefPtr<UISystemBase> uiSystemInterface;
         void MainLoop();
+		void FinishPendingFrame();
+		void PresentFrame(int version);
 		bool OnToggleConsoleAction(const CoreLib::String & actionName, ActionInput input);
 		void Resize();
 		Engine() {};
@@ -134,6 +141,10 @@ namespace GameEngine
 		{
 			return isRunning;
 		}
+		bool IsGameThread()
+		{
+			return std::this_thread::get_id() == gameThreadId;
+		}
 		bool UseSoftwareRenderer()
 		{
 			return useSoftwareRenderer;
@@ -245,7 +256,7 @@ namespace GameEngine
 		template<typename ...Args>
 		static void Print(const char * message, Args... args)
 		{
-			static char printBuffer[32768];
+			static thread_local char printBuffer[32768];
 			static CoreLib::Diagnostics::TimePoint lastUIUpdate;
 #if __GNUC__
 #pragma GCC diagnostic push
@@ -255,7 +266,7 @@ namespace GameEngine
 #if __GNUC__
 #pragma GCC diagnostic pop
 #endif
-            bool uiCommandFormAvailable = instance && instance->uiCommandForm;
+            bool uiCommandFormAvailable = instance && instance->uiCommandForm && instance->IsGameThread();
             if (uiCommandFormAvailable)
 			{
 				instance->uiCommandForm->Write(printBuffer);
@@ -11,8 +11,14 @@ namespace GameEngine
 	const int MaxEnvMapCount = 128;
 	const int EnvMapSize = 64;
 	const int DynamicBufferLengthMultiplier = 2; // double buffering for dynamic uniforms
+	const int RenderFrameSnapshotCount = 2; // double buffering for level state handed from game thread to render thread
 	const int MaxModuleInstances = 1<<20;
     const int MaxBlendShapes = 32;
+    const int MaxCommandRecordingThreads = 8; // threads recording the secondary command buffers of one world pass, including the caller
+    const int FirstCommandRecordingThreadId = 2; // hardware renderer thread ids 0 and 1 belong to the render thread and the lightmap baker
+    const int MaxInstancesPerDraw = 64; // must match MAX_INSTANCES_PER_DRAW in ShaderLib.slang
+    const int MinInstancesPerDraw = 2; // shortest run of identical drawables that is merged into an instanced draw
+    const int MaxInstancedDrawsPerFrame = 1024;
     }
 
 #endif
\ No newline at end of file
@@ -21,6 +21,10 @@ namespace GameEngine
 		virtual void OnLoad() override;
 		virtual void OnUnload() override;
 		virtual EngineActorType GetEngineType() override;
+		virtual TickPhase GetTickPhase() override
+		{
+			return TickPhase::Camera;
+		}
 		virtual CoreLib::String GetTypeName() override
 		{
 			return "FreeRoamCameraController";
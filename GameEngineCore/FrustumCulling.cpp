@@ -1,4 +1,9 @@
 #include "FrustumCulling.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#else
+#include <smmintrin.h>
+#endif
 
 using namespace VectorMath;
 using namespace CoreLib;
@@ -86,4 +91,119 @@ namespace GameEngine
 		FromVerts(verts.GetArrayView());
 	}
 
+
+	void CullBoundsList::Clear()
+	{
+		Count = 0;
+		MinX.Clear(); MinY.Clear(); MinZ.Clear();
+		MaxX.Clear(); MaxY.Clear(); MaxZ.Clear();
+	}
+
+	void CullBoundsList::Add(const CoreLib::Graphics::BBox & box)
+	{
+		if (Count == MinX.Count())
+		{
+			// grow by a whole batch, the padding is never reported as visible.
+			// capacity grows geometrically so that filling the list copies each box a constant number of times
+			int newSize = Count + CullBatchSize;
+			for (auto list : { &MinX, &MinY, &MinZ, &MaxX, &MaxY, &MaxZ })
+			{
+				list->GrowToSize(newSize);
+				for (int i = Count; i < newSize; i++)
+					(*list)[i] = 0.0f;
+			}
+		}
+		MinX[Count] = box.Min.x; MinY[Count] = box.Min.y; MinZ[Count] = box.Min.z;
+		MaxX[Count] = box.Max.x; MaxY[Count] = box.Max.y; MaxZ[Count] = box.Max.z;
+		Count++;
+	}
+
+#ifdef __AVX2__
+	typedef __m256 CullFloat;
+	inline CullFloat CullLoad(const float * ptr) { return _mm256_loadu_ps(ptr); }
+	inline CullFloat CullSet(float val) { return _mm256_set1_ps(val); }
+	inline CullFloat CullSelect(CullFloat a, CullFloat b, CullFloat mask) { return _mm256_blendv_ps(a, b, mask); }
+	inline CullFloat CullMul(CullFloat a, CullFloat b) { return _mm256_mul_ps(a, b); }
+	inline CullFloat CullAdd(CullFloat a, CullFloat b) { return _mm256_add_ps(a, b); }
+	inline CullFloat CullAnd(CullFloat a, CullFloat b) { return _mm256_and_ps(a, b); }
+	inline CullFloat CullNotLess(CullFloat a, CullFloat b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); }
+	inline unsigned int CullMoveMask(CullFloat a) { return (unsigned int)_mm256_movemask_ps(a); }
+#else
+	typedef __m128 CullFloat;
+	inline CullFloat CullLoad(const float * ptr) { return _mm_loadu_ps(ptr); }
+	inline CullFloat CullSet(float val) { return _mm_set1_ps(val); }
+	inline CullFloat CullSelect(CullFloat a, CullFloat b, CullFloat mask) { return _mm_blendv_ps(a, b, mask); }
+	inline CullFloat CullMul(CullFloat a, CullFloat b) { return _mm_mul_ps(a, b); }
+	inline CullFloat CullAdd(CullFloat a, CullFloat b) { return _mm_add_ps(a, b); }
+	inline CullFloat CullAnd(CullFloat a, CullFloat b) { return _mm_and_ps(a, b); }
+	inline CullFloat CullNotLess(CullFloat a, CullFloat b) { return _mm_cmpnlt_ps(a, b); }
+	inline unsigned int CullMoveMask(CullFloat a) { return (unsigned int)_mm_movemask_ps(a); }
+#endif
+
+	struct CullPlane
+	{
+		CullFloat x, y, z, w;
+		// select masks picking the positive vertex, blendv only reads the sign bit
+		CullFloat selectX, selectY, selectZ;
+	};
+
+	void CullBoxes(const CullBoundsList & bounds, CoreLib::ArrayView<CullFrustum> frustums, CoreLib::List<CullMask> & masks)
+	{
+		int wordCount = (bounds.Count + 31) >> 5;
+		masks.SetSize(frustums.Count());
+		for (auto & mask : masks)
+		{
+			mask.Bits.SetSize(wordCount);
+			for (auto & word : mask.Bits)
+				word = 0;
+		}
+		List<CullPlane> planes;
+		planes.SetSize(frustums.Count() * 6);
+		for (int f = 0; f < frustums.Count(); f++)
+		{
+			for (int i = 0; i < 6; i++)
+			{
+				auto & src = frustums[f].Planes[i];
+				auto & plane = planes[f * 6 + i];
+				plane.x = CullSet(src.x);
+				plane.y = CullSet(src.y);
+				plane.z = CullSet(src.z);
+				plane.w = CullSet(src.w);
+				plane.selectX = CullSet(src.x >= 0.0f ? -1.0f : 1.0f);
+				plane.selectY = CullSet(src.y >= 0.0f ? -1.0f : 1.0f);
+				plane.selectZ = CullSet(src.z >= 0.0f ? -1.0f : 1.0f);
+			}
+		}
+		auto zero = CullSet(0.0f);
+		auto allVisible = CullNotLess(zero, zero);
+		for (int i = 0; i < bounds.Count; i += CullBatchSize)
+		{
+			auto minX = CullLoad(bounds.MinX.Buffer() + i);
+			auto minY = CullLoad(bounds.MinY.Buffer() + i);
+			auto minZ = CullLoad(bounds.MinZ.Buffer() + i);
+			auto maxX = CullLoad(bounds.MaxX.Buffer() + i);
+			auto maxY = CullLoad(bounds.MaxY.Buffer() + i);
+			auto maxZ = CullLoad(bounds.MaxZ.Buffer() + i);
+			for (int f = 0; f < frustums.Count(); f++)
+			{
+				auto visible = allVisible;
+				for (int p = 0; p < 6; p++)
+				{
+					auto & plane = planes[f * 6 + p];
+					auto dist = CullAdd(CullAdd(CullAdd(CullMul(plane.x, CullSelect(minX, maxX, plane.selectX)),
+						CullMul(plane.y, CullSelect(minY, maxY, plane.selectY))),
+						CullMul(plane.z, CullSelect(minZ, maxZ, plane.selectZ))), plane.w);
+					visible = CullAnd(visible, CullNotLess(dist, zero));
+				}
+				masks[f].Bits[i >> 5] |= CullMoveMask(visible) << (i & 31);
+			}
+		}
+		// clear bits of the padding boxes
+		if (bounds.Count & 31)
+		{
+			unsigned int tailMask = (1u << (bounds.Count & 31)) - 1;
+			for (auto & mask : masks)
+				mask.Bits.Last() &= tailMask;
+		}
+	}
 }
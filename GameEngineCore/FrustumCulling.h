@@ -19,5 +19,34 @@ namespace GameEngine
 
 		CullFrustum() = default;
 	};
+
+	// number of boxes tested per iteration by CullBoxes
+#ifdef __AVX2__
+	const int CullBatchSize = 8;
+#else
+	const int CullBatchSize = 4;
+#endif
+
+	// bounding boxes stored as structure of arrays, padded to a multiple of CullBatchSize
+	struct CullBoundsList
+	{
+		CoreLib::List<float> MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+		int Count = 0;
+		void Clear();
+		void Add(const CoreLib::Graphics::BBox & box);
+	};
+
+	// one visibility bit per box
+	struct CullMask
+	{
+		CoreLib::List<unsigned int> Bits;
+		inline bool IsVisible(int boxId) const
+		{
+			return ((Bits[boxId >> 5] >> (boxId & 31)) & 1) != 0;
+		}
+	};
+
+	// tests every box in bounds against all frustums in a single sweep, producing one mask per frustum
+	void CullBoxes(const CullBoundsList & bounds, CoreLib::ArrayView<CullFrustum> frustums, CoreLib::List<CullMask> & masks);
 }
 #endif
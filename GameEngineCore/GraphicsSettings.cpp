@@ -20,6 +20,16 @@ namespace GameEngine
 				ShadowMapArraySize = StringToInt(settingsValue);
 			else if (settingsName == "ShadowMapResolution")
 				ShadowMapResolution = StringToInt(settingsValue);
+			else if (settingsName == "UseOcclusionCulling")
+				UseOcclusionCulling = StringToInt(settingsValue) != 0;
+			else if (settingsName == "UseInstancing")
+				UseInstancing = StringToInt(settingsValue) != 0;
+			else if (settingsName == "UseAsyncPipelineCompilation")
+				UseAsyncPipelineCompilation = StringToInt(settingsValue) != 0;
+			else if (settingsName == "ReuseCommandBuffers")
+				ReuseCommandBuffers = StringToInt(settingsValue) != 0;
+			else if (settingsName == "CacheStaticShadowMaps")
+				CacheStaticShadowMaps = StringToInt(settingsValue) != 0;
 		}
 	}
 	void GraphicsSettings::SaveToFile(CoreLib::String fileName)
@@ -27,6 +37,11 @@ namespace GameEngine
 		StringBuilder sb;
 		sb << "ShadowMapArraySize = \"" << ShadowMapArraySize << "\"\n";
 		sb << "ShadowMapResolution = \"" << ShadowMapResolution << "\"\n";
+		sb << "UseOcclusionCulling = \"" << (UseOcclusionCulling ? 1 : 0) << "\"\n";
+		sb << "UseInstancing = \"" << (UseInstancing ? 1 : 0) << "\"\n";
+		sb << "UseAsyncPipelineCompilation = \"" << (UseAsyncPipelineCompilation ? 1 : 0) << "\"\n";
+		sb << "ReuseCommandBuffers = \"" << (ReuseCommandBuffers ? 1 : 0) << "\"\n";
+		sb << "CacheStaticShadowMaps = \"" << (CacheStaticShadowMaps ? 1 : 0) << "\"\n";
 		File::WriteAllText(fileName, sb.ProduceString());
 	}
 }
@@ -8,9 +8,17 @@ namespace GameEngine
 	class GraphicsSettings
 	{
 	public:
-		int ShadowMapArraySize = 8;
+		int ShadowMapArraySize = 16;
 		int ShadowMapResolution = 1024;
 		bool UsePipelineCache = true;
+		bool UseOcclusionCulling = true;
+		bool UseInstancing = true;
+		// compile missing pipelines in the background and skip their drawables meanwhile
+		bool UseAsyncPipelineCompilation = true;
+		// submit secondary command buffers of world passes again when their draws have not changed
+		bool ReuseCommandBuffers = true;
+		// keep shadow casters of static actors in shadow map layers that are only rendered again when they change
+		bool CacheStaticShadowMaps = true;
 		void LoadFromFile(CoreLib::String fileName);
 		void SaveToFile(CoreLib::String fileName);
 	};
@@ -882,6 +882,10 @@ namespace GameEngine
 	{
 	public:
         virtual void ThreadInit(int threadId) = 0;
+        // id the calling thread was assigned by ThreadInit
+        virtual int GetThreadId() = 0;
+        // thread ids must be less than this value, each id owns separate command and descriptor pools
+        virtual int GetMaxThreadCount() = 0;
         virtual void BeginJobSubmission() = 0;
         virtual void QueueRenderPass(FrameBuffer *frameBuffer,
 			bool clearFrameBuffer,
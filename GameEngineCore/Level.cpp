@@ -2,8 +2,10 @@
 #include "Level.h"
 #include "CoreLib/LibIO.h"
 #include "CoreLib/Tokenizer.h"
+#include "CoreLib/Threading.h"
 #include "MeshBuilder.h"
 #include "CameraActor.h"
+#include <atomic>
 
 namespace GameEngine
 {
@@ -181,19 +183,162 @@ namespace GameEngine
         RetargetFiles = decltype(RetargetFiles)();
         Actors = decltype(Actors)();
     }
+    // actor lists that remember each actor's position, so that removal is constant time
+    static void AddToActorList(List<Actor*> & list, Actor * actor, int Actor::* indexField)
+    {
+        actor->*indexField = list.Count();
+        list.Add(actor);
+    }
+    static void RemoveFromActorList(List<Actor*> & list, Actor * actor, int Actor::* indexField)
+    {
+        int index = actor->*indexField;
+        list.FastRemoveAt(index);
+        if (index < list.Count())
+            list[index]->*indexField = index;
+        actor->*indexField = -1;
+    }
+    int Level::AllocStaticContentVersion()
+    {
+        static std::atomic<int> nextStaticContentVersion{ 1 };
+        return nextStaticContentVersion++;
+    }
+    void Level::StaticContentChanged(const CoreLib::Graphics::BBox & bounds)
+    {
+        // changes beyond this many are dropped, which invalidates all content cached before them
+        const int maxRecordedChanges = 256;
+        staticContentLock.Lock();
+        staticContentVersion = AllocStaticContentVersion();
+        if (staticContentChanges.Count() == maxRecordedChanges)
+        {
+            droppedStaticContentVersion = staticContentChanges.First().Version;
+            staticContentChanges.RemoveAt(0);
+        }
+        staticContentChanges.Add(StaticContentChange{ staticContentVersion, bounds });
+        staticContentLock.Unlock();
+    }
+    int Level::GetStaticContentChanges(CoreLib::List<StaticContentChange> & changes)
+    {
+        staticContentLock.Lock();
+        changes.Clear();
+        changes.AddRange(staticContentChanges);
+        int droppedVersion = droppedStaticContentVersion;
+        staticContentLock.Unlock();
+        return droppedVersion;
+    }
     void Level::RegisterActor(Actor * actor)
     {
+        // the render thread may still be drawing the previous frame's drawables
+        if (auto renderer = Engine::Instance()->GetRenderer())
+            renderer->WaitForFrame();
         Actors.Add(actor->Name.GetValue(), actor);
+        AddToActorList(actorsByType[(int)actor->GetEngineType()], actor, &Actor::typeListIndex);
+        AddToActorList(unboundedActors, actor, &Actor::unboundedListIndex);
+        actor->isRegistered = true;
+        if (actor->RetainsDrawables())
+        {
+            for (auto prop : actor->GetPropertyList())
+                prop->OnChanged.Bind(actor, &Actor::InvalidateDrawables);
+            actor->InvalidateDrawables();
+        }
         actor->OnLoad();
         actor->RegisterUI(Engine::Instance()->GetUiEntry());
+        UpdateActorSpatialProxy(actor);
     }
     void Level::UnregisterActor(Actor*actor)
     {
+        if (auto renderer = Engine::Instance()->GetRenderer())
+            renderer->WaitForFrame();
+        // the retained drawables are still alive before the actor unloads
+        if (actor->RetainsDrawables())
+        {
+            for (auto prop : actor->GetPropertyList())
+                prop->OnChanged.Unbind(actor, &Actor::InvalidateDrawables);
+            actor->InvalidateDrawables();
+        }
         actor->OnUnload();
+        RemoveFromActorList(actorsByType[(int)actor->GetEngineType()], actor, &Actor::typeListIndex);
+        actor->isRegistered = false;
+        if (actor->spatialProxyId != -1)
+        {
+            actorTree.Remove(actor->spatialProxyId);
+            actor->spatialProxyId = -1;
+        }
+        else
+            RemoveFromActorList(unboundedActors, actor, &Actor::unboundedListIndex);
+        if (actor->boundsChangePending)
+        {
+            boundsChangedActors.Remove(actor);
+            actor->boundsChangePending = false;
+        }
         auto actorName = actor->Name.GetValue();
         Actors[actorName] = nullptr;
         Actors.Remove(actorName);
     }
+    void Level::TickActors(TickPhase phase)
+    {
+        // actors of a parallel batch are small, keep enough of them per task to amortize scheduling
+        const int tickBatchSize = 16;
+        parallelTickActors.Clear();
+        for (auto & actor : Actors)
+        {
+            if (actor.Value->GetTickPhase() == phase && actor.Value->CanTickInParallel())
+                parallelTickActors.Add(actor.Value.Ptr());
+        }
+        CoreLib::Threading::ParallelFor(0, parallelTickActors.Count(), tickBatchSize, [this](int i)
+        {
+            parallelTickActors[i]->Tick();
+        });
+        for (auto & actor : Actors)
+        {
+            if (actor.Value->GetTickPhase() == phase && !actor.Value->CanTickInParallel())
+                actor.Value->Tick();
+        }
+    }
+    void Level::ActorBoundsChanged(Actor * actor)
+    {
+        if (!actor->isRegistered)
+            return;
+        boundsChangedLock.Lock();
+        if (!actor->boundsChangePending)
+        {
+            actor->boundsChangePending = true;
+            boundsChangedActors.Add(actor);
+        }
+        boundsChangedLock.Unlock();
+    }
+    void Level::UpdateActorSpatialProxy(Actor * actor)
+    {
+        auto & bounds = actor->Bounds;
+        bool isFinite = bounds.xMin <= bounds.xMax && bounds.yMin <= bounds.yMax && bounds.zMin <= bounds.zMax &&
+            bounds.xMin > -FLT_MAX && bounds.yMin > -FLT_MAX && bounds.zMin > -FLT_MAX &&
+            bounds.xMax < FLT_MAX && bounds.yMax < FLT_MAX && bounds.zMax < FLT_MAX;
+        if (isFinite)
+        {
+            if (actor->spatialProxyId == -1)
+            {
+                RemoveFromActorList(unboundedActors, actor, &Actor::unboundedListIndex);
+                actor->spatialProxyId = actorTree.Insert(bounds, actor);
+            }
+            else
+                actorTree.Move(actor->spatialProxyId, bounds);
+        }
+        else if (actor->spatialProxyId != -1)
+        {
+            actorTree.Remove(actor->spatialProxyId);
+            actor->spatialProxyId = -1;
+            AddToActorList(unboundedActors, actor, &Actor::unboundedListIndex);
+        }
+    }
+    void Level::UpdateSpatialIndex()
+    {
+        for (auto actor : boundsChangedActors)
+        {
+            actor->boundsChangePending = false;
+            UpdateActorSpatialProxy(actor);
+        }
+        boundsChangedActors.Clear();
+        physicsScene.UpdateBroadphase();
+    }
     Mesh * Level::LoadMesh(CoreLib::String fileName)
     {
         RefPtr<Mesh> result = nullptr;
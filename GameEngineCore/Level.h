@@ -2,22 +2,47 @@
 #define GAME_ENGINE_LEVEL_H
 
 #include "CoreLib/Basic.h"
+#include "CoreLib/Threading.h"
 #include "Model.h"
 #include "Actor.h"
 #include "Material.h"
 #include "Skeleton.h"
 #include "Physics.h"
+#include "DynamicBvh.h"
 
 namespace GameEngine
 {
     class Actor;
     class CameraActor;
 
+    // a region whose retained drawables changed, along with the static content version of the change
+    struct StaticContentChange
+    {
+        int Version;
+        CoreLib::Graphics::BBox Bounds;
+    };
+
     class Level : public CoreLib::Object
     {
     private:
         PhysicsScene physicsScene;
         CoreLib::RefPtr<Model> errorModel;
+        CoreLib::List<Actor*> parallelTickActors;
+        // actors with finite bounds are kept in actorTree, the rest are visited by every spatial query
+        DynamicBvh<Actor*> actorTree;
+        CoreLib::List<Actor*> unboundedActors;
+        CoreLib::List<Actor*> actorsByType[EngineActorTypeCount];
+        CoreLib::List<Actor*> boundsChangedActors;
+        CoreLib::Threading::SpinLock boundsChangedLock;
+        // unique among all levels, so that content cached for one level is never taken for another's
+        int staticContentId = AllocStaticContentVersion();
+        int staticContentVersion = 0;
+        // the latest static content changes, oldest first. changes up to droppedStaticContentVersion are no longer recorded
+        CoreLib::List<StaticContentChange> staticContentChanges;
+        int droppedStaticContentVersion = 0;
+        CoreLib::Threading::SpinLock staticContentLock;
+        static int AllocStaticContentVersion();
+        void UpdateActorSpatialProxy(Actor * actor);
     public:
         CoreLib::EnumerableDictionary<CoreLib::String, CoreLib::RefPtr<Material>> Materials;
         CoreLib::EnumerableDictionary<CoreLib::String, CoreLib::RefPtr<Model>> Models;
@@ -53,6 +78,41 @@ namespace GameEngine
         }
         void RegisterActor(Actor * actor);
         void UnregisterActor(Actor * actor);
+        void TickActors(TickPhase phase);
+        void ActorBoundsChanged(Actor * actor);
+        // applies pending bounds changes to the spatial index and the physics broadphase, called on the game thread after actors are ticked
+        void UpdateSpatialIndex();
+        int GetStaticContentId()
+        {
+            return staticContentId;
+        }
+        // changes whenever the drawables of an actor that retains its drawables may have changed
+        int GetStaticContentVersion()
+        {
+            return staticContentVersion;
+        }
+        // records that retained drawables within bounds were added or removed, may be called from any thread
+        void StaticContentChanged(const CoreLib::Graphics::BBox & bounds);
+        // copies the recorded changes, and returns the version up to which changes are no longer recorded
+        int GetStaticContentChanges(CoreLib::List<StaticContentChange> & changes);
+        CoreLib::ArrayView<Actor*> GetActorsOfType(EngineActorType type)
+        {
+            return actorsByType[(int)type].GetArrayView();
+        }
+        // union of the (enlarged) bounds of all actors with finite bounds
+        CoreLib::Graphics::BBox GetContentBounds()
+        {
+            return actorTree.GetRootBounds();
+        }
+        // calls f(actor) for every actor whose bounds may pass boxTest, and for every actor without finite bounds.
+        // boxTest must accept any box that contains a box it accepts.
+        template<typename BoxTest, typename Func>
+        void QueryActors(const BoxTest & boxTest, const Func & f)
+        {
+            for (auto actor : unboundedActors)
+                f(actor);
+            actorTree.Query(boxTest, [&](int, Actor * actor) { f(actor); });
+        }
     };
 }
 
@@ -134,11 +134,18 @@ namespace GameEngine
             if (selectedActor != actor)
             {
                 for (auto & actorKV : level->Actors)
-                    actorKV.Value->EditorSelected = false;
+                {
+                    if (actorKV.Value->EditorSelected)
+                    {
+                        actorKV.Value->EditorSelected = false;
+                        actorKV.Value->InvalidateDrawables();
+                    }
+                }
                 selectedActor = actor;
                 if (actor)
                 {
                     actor->EditorSelected = true;
+                    actor->InvalidateDrawables();
                     oldLocalTransform = actor->GetLocalTransform();
                     int index = -1;
                     for (int i = 0; i < lstActors->Items.Count(); i++)
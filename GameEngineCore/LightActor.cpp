@@ -1,12 +1,19 @@
 #include "LightActor.h"
 #include "Engine.h"
 #include "Material.h"
+#include <atomic>
 
 using namespace VectorMath;
 using namespace CoreLib;
 
 namespace GameEngine
 {
+	LightActor::LightActor()
+	{
+		static std::atomic<int> nextLightId{ 0 };
+		LightId = nextLightId++;
+	}
+
 	Vec3 LightActor::GetDirection()
 	{
 		auto localTransform = LocalTransform.GetValue();
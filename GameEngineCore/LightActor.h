@@ -15,6 +15,9 @@ namespace GameEngine
 		virtual Mesh CreateGizmoMesh() = 0;
 	public:
 		LightType lightType;
+		// identifies the light across frames on the render thread, never reused
+		int LightId;
+		LightActor();
         PROPERTY_DEF_ATTRIB(int, Mobility, 0, "enum(Static,Stationary,Dynamic)");
         PROPERTY_DEF_ATTRIB(int, EnableShadows, 1, "enum(Disabled,Static,Dynamic)");
         PROPERTY_DEF(float, Radius, 0.0f);
@@ -55,6 +55,7 @@ namespace GameEngine
         DrawableSink sink;
 
         List<Drawable*> reorderBuffer, drawableBuffer;
+        DrawableSorter transparentSorter;
         LightingEnvironment lighting;
         AtmosphereParameters lastAtmosphereParams;
         bool useAtmosphere = false;
@@ -175,6 +176,10 @@ namespace GameEngine
             return drawableBuffer.GetArrayView();
         }
 
+        virtual bool Extract(const RenderProcedureParameters & /*params*/) override
+        {
+            return false;
+        }
         virtual void Run(const RenderProcedureParameters & params) override
         {
             int w = 0, h = 0;
@@ -275,10 +280,10 @@ namespace GameEngine
             prezTextures.Add(textures[0]);
             customDepthRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
-            preZPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, cameraCullFrustum, false));
+            preZPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, cameraCullFrustum, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
-            preZPassTransparentInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Transparent, cameraCullFrustum, false));
+            preZPassTransparentInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Transparent, cameraCullFrustum, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             preZPassInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
             preZPassTransparentInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
@@ -310,7 +315,7 @@ namespace GameEngine
             forwardRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
             sharedRes->pipelineManager.PushModuleInstance(&lighting.moduleInstance);
-            forwardBaseInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, cameraCullFrustum, false));
+            forwardBaseInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, cameraCullFrustum, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             sharedRes->pipelineManager.PopModuleInstance();
             forwardBaseInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
@@ -327,7 +332,7 @@ namespace GameEngine
             }
             if (reorderBuffer.Count())
             {
-                reorderBuffer.Sort([=](Drawable* d1, Drawable* d2) { return d1->Bounds.Distance(params.view.Position) > d2->Bounds.Distance(params.view.Position); });
+                transparentSorter.SortBackToFront(reorderBuffer, params.view.Position);
                 if (useAtmosphere)
                 {
                     transparentPassInstance = forwardRenderPass->CreateInstance(transparentAtmosphereOutput, false);
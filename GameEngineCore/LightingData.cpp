@@ -5,6 +5,7 @@
 #include "WorldRenderPass.h"
 #include "Engine.h"
 #include "AmbientLightActor.h"
+#include "ShaderCacheArchive.h"
 
 using namespace CoreLib;
 using namespace VectorMath;
@@ -31,19 +32,81 @@ namespace GameEngine
 			(unsigned int)(Math::Clamp(((beta + Math::Pi * 0.5f) / Math::Pi), 0.0f, 1.0f)*65535.0f);
 	}
 
-	void GetDrawable(List<Drawable*> & drawableBuffer, DrawableSink * objSink, bool transparent, CullFrustum cf)
+	inline bool IsShadowCaster(Drawable * obj, ShadowCasterFilter filter)
 	{
+		if (!obj->CastShadow)
+			return false;
+		if (filter == ShadowCasterFilter::Static)
+			return obj->IsRetained;
+		if (filter == ShadowCasterFilter::Dynamic)
+			return !obj->IsRetained;
+		return true;
+	}
+
+	void GetDrawable(List<Drawable*> & drawableBuffer, DrawableSink * objSink, bool transparent, const CullMask & cullMask, ShadowCasterFilter filter)
+	{
+		int boxId = transparent ? objSink->GetDrawables(false).Count() : 0;
 		for (auto obj : objSink->GetDrawables(transparent))
 		{
-			if (!obj->CastShadow)
-				continue;
-			if (cf.IsBoxInFrustum(obj->Bounds))
+			if (IsShadowCaster(obj, filter) && cullMask.IsVisible(boxId))
 				drawableBuffer.Add(obj);
+			boxId++;
+		}
+	}
+
+	bool HasDynamicShadowCaster(DrawableSink * objSink, const CullMask & cullMask)
+	{
+		int boxId = 0;
+		for (auto obj : objSink->GetDrawables(false))
+		{
+			if (IsShadowCaster(obj, ShadowCasterFilter::Dynamic) && cullMask.IsVisible(boxId))
+				return true;
+			boxId++;
+		}
+		for (auto obj : objSink->GetDrawables(true))
+		{
+			if (IsShadowCaster(obj, ShadowCasterFilter::Dynamic) && cullMask.IsVisible(boxId))
+				return true;
+			boxId++;
+		}
+		return false;
+	}
+
+	// identifies the static layer drawn with a shadow map view, never 0
+	uint64_t GetStaticShadowMapContent(const StandardViewUniforms & shadowMapView)
+	{
+		auto hash = ComputeHash64(&shadowMapView.ViewProjectionTransform, sizeof(shadowMapView.ViewProjectionTransform));
+		return hash == 0 ? 1 : hash;
+	}
+
+	// resets the static layers that may hold casters changed since the changes last applied to contents
+	void ApplyStaticContentChanges(ShadowMapContents & contents, const LightingSnapshot & snapshot)
+	{
+		int latestVersion = snapshot.staticContentChanges.Count() ? snapshot.staticContentChanges.Last().Version : snapshot.droppedStaticContentVersion;
+		if (contents.StaticContentId != snapshot.staticContentId || contents.StaticContentVersion < snapshot.droppedStaticContentVersion)
+		{
+			for (auto & key : contents.Keys)
+				key = 0;
 		}
+		else
+		{
+			for (auto & change : snapshot.staticContentChanges)
+			{
+				if (change.Version <= contents.StaticContentVersion)
+					continue;
+				for (int i = 0; i < contents.Keys.Count(); i++)
+				{
+					if (contents.Keys[i] && contents.Frustums[i].IsBoxInFrustum(change.Bounds))
+						contents.Keys[i] = 0;
+				}
+			}
+		}
+		contents.StaticContentId = snapshot.staticContentId;
+		contents.StaticContentVersion = Math::Max(contents.StaticContentVersion, latestVersion);
 	}
 
-	void LightingEnvironment::AddShadowPass(HardwareRenderer* hw, WorldRenderPass * shadowRenderPass, DrawableSink * sink, ShadowMapResource & shadowMapRes, int shadowMapId,
-		StandardViewUniforms & shadowMapView, int & shadowMapViewInstancePtr)
+	bool LightingEnvironment::AddShadowPass(HardwareRenderer* hw, WorldRenderPass * shadowRenderPass, DrawableSink * sink, ShadowMapResource & shadowMapRes, int shadowMapId,
+		StandardViewUniforms & shadowMapView, const CullMask & cullMask, ShadowCasterFilter filter, int & shadowMapViewInstancePtr, RenderStat * stats)
 	{
 		auto pass = shadowRenderPass->CreateInstance(shadowMapRes.shadowMapRenderOutputs[shadowMapId].Ptr(), true);
 
@@ -69,129 +132,289 @@ namespace GameEngine
 		shadowMapPassModuleInstance->SetUniformData(&shadowMapView, sizeof(shadowMapView));
 		sharedRes->pipelineManager.PushModuleInstance(shadowMapPassModuleInstance);
 		drawableBuffer.Clear();
-		auto cullFrustum = CullFrustum(shadowMapView.InvViewProjTransform);
-		GetDrawable(drawableBuffer, sink, true, cullFrustum);
-		GetDrawable(drawableBuffer, sink, false, cullFrustum);
+		GetDrawable(drawableBuffer, sink, true, cullMask, filter);
+		GetDrawable(drawableBuffer, sink, false, cullMask, filter);
 		pass->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, drawableBuffer.GetArrayView());
 		sharedRes->pipelineManager.PopModuleInstance();
         RenderStat stat;
 		pass->Execute(hw, stat, PipelineBarriers::MemoryAndImage);
+		if (stats)
+			stats->NumShadowDrawCalls += stat.NumDrawCalls;
+		return pass->numSkippedDrawables == 0;
 	}
 
-	void LightingEnvironment::GatherInfo(HardwareRenderer* hw, DrawableSink * sink, const RenderProcedureParameters & params, int w, int h, StandardViewUniforms & viewUniform, WorldRenderPass * shadowRenderPass)
+	void LightingEnvironment::AssignShadowMaps(const LightingSnapshot & snapshot, Vec3 cameraPos)
 	{
-		auto renderer = params.renderer;
-		auto level = params.level;
-
-		lightProbes.Clear();
-		lights.Clear();
-		uniformData.sunLightEnabled = false;
-		auto shadowMapRes = renderer->GetSharedResource()->shadowMapResources;
-		shadowMapRes.Reset();
-		CoreLib::Graphics::BBox levelBounds;
-		levelBounds.Min = Vec3::Create(-10.0f);
-		levelBounds.Max = Vec3::Create(10.0f);
-		DirectionalLightActor * sunlight = nullptr;
-		for (auto & actor : level->Actors)
+		auto & sharedShadowMaps = sharedRes->shadowMapResources;
+		if (allocatedShadowMapArray != sharedShadowMaps.shadowMapArray.Ptr())
 		{
-			levelBounds.Union(actor.Value->Bounds);
-			auto actorType = actor.Value->GetEngineType();
-			if (actorType == EngineActorType::Light)
+			shadowMapAllocation = sharedShadowMaps;
+			shadowMapAllocation.Reset();
+			allocatedShadowMapArray = sharedShadowMaps.shadowMapArray.Ptr();
+			lightShadowMaps.Clear();
+			dynamicShadowMaps.Clear();
+			sunShadowMapId = -1;
+			sunShadowMapCount = 0;
+		}
+		for (auto & range : dynamicShadowMaps)
+			shadowMapAllocation.FreeShadowMaps(range.id, range.count);
+		dynamicShadowMaps.Clear();
+		// sun light cascades need a contiguous range and take precedence over spot light shadows
+		int numCascades = snapshot.sunLightEnabled ? snapshot.numShadowCascades : 0;
+		if (sunShadowMapCount != numCascades)
+		{
+			if (sunShadowMapCount)
+				shadowMapAllocation.FreeShadowMaps(sunShadowMapId, sunShadowMapCount);
+			sunShadowMapId = -1;
+			sunShadowMapCount = 0;
+			if (numCascades)
 			{
-				auto light = dynamic_cast<LightActor*>(actor.Value.Ptr());
-                // ignore static lights
-                if (light->Mobility.GetValue() == 0)
-                    continue; 
-				if (light->lightType == LightType::Directional)
+				sunShadowMapId = shadowMapAllocation.AllocShadowMaps(numCascades);
+				if (sunShadowMapId == -1)
 				{
-					auto dirLight = (DirectionalLightActor*)(light);
-					GpuLightData lightData;
-					lightData.lightType = GpuLightType_Directional;
-					lightData.color = dirLight->Color.GetValue();
-					lightData.direction = PackDirection(dirLight->GetDirection());
-					auto localTransform = dirLight->GetLocalTransform();
-					lightData.position = Vec3::Create(localTransform.values[12], localTransform.values[13], localTransform.values[14]);
-					lightData.radius = dirLight->Radius.GetValue();
-					lightData.startAngle = lightData.endAngle = 0.0f;
-					lightData.shaderMapId = 0xFFFF;
-					if (dirLight->EnableShadows.GetValue() == 2 && !uniformData.sunLightEnabled)
-					{
-						uniformData.sunLightEnabled = true;
-						sunlight = dirLight;
-						uniformData.lightColor = lightData.color;
-						uniformData.lightDir = dirLight->GetDirection();
-					}
-					else
-					{
-						lights.Add(lightData);
-					}
+					for (auto & shadowMap : lightShadowMaps)
+						shadowMapAllocation.FreeShadowMaps(shadowMap.Value, 1);
+					lightShadowMaps.Clear();
+					sunShadowMapId = shadowMapAllocation.AllocShadowMaps(numCascades);
 				}
-				else if (light->lightType == LightType::Point)
+				if (sunShadowMapId != -1)
+					sunShadowMapCount = numCascades;
+			}
+		}
+
+		// release the shadow maps of lights that are gone, culled or no longer cast shadows
+		shadowLights.Clear();
+		shadowLightIds.Clear();
+		for (int i = 0; i < lights.Count(); i++)
+		{
+			if (lights[i].shaderMapId == 0xFFFE)
+			{
+				shadowLights.Add(i);
+				shadowLightIds.Add(lightIds[i]);
+			}
+		}
+		releasedShadowMapLights.Clear();
+		for (auto & shadowMap : lightShadowMaps)
+		{
+			if (!shadowLightIds.Contains(shadowMap.Key))
+				releasedShadowMapLights.Add(shadowMap.Key);
+		}
+		for (auto lightId : releasedShadowMapLights)
+		{
+			shadowMapAllocation.FreeShadowMaps(lightShadowMaps[lightId], 1);
+			lightShadowMaps.Remove(lightId);
+		}
+
+		// lights keep their shadow map, a light without one takes a free shadow map or the one of the farthest light holding one
+		shadowLights.Sort([&](int l1, int l2) { return (lights[l1].position - cameraPos).Length2() < (lights[l2].position - cameraPos).Length2(); });
+		for (int i = 0; i < shadowLights.Count(); i++)
+		{
+			int lightId = lightIds[shadowLights[i]];
+			int shadowMapId = -1;
+			if (!lightShadowMaps.TryGetValue(lightId, shadowMapId))
+			{
+				shadowMapId = shadowMapAllocation.AllocShadowMaps(1);
+				for (int j = shadowLights.Count() - 1; shadowMapId == -1 && j > i; j--)
 				{
-					auto pointLight = (PointLightActor*)(light);
-					GpuLightData lightData;
-					lightData.lightType = pointLight->IsSpotLight ? GpuLightType_Spot: GpuLightType_Point;
-					lightData.color = pointLight->Color.GetValue();
-					lightData.direction = PackDirection(pointLight->GetDirection());
-					auto localTransform = pointLight->GetLocalTransform();
-					lightData.position = Vec3::Create(localTransform.values[12], localTransform.values[13], localTransform.values[14]);
-					lightData.radius = pointLight->Radius.GetValue();
-					lightData.startAngle = pointLight->SpotLightStartAngle.GetValue() * (Math::Pi / 180.0f * 0.5f);
-					lightData.endAngle = pointLight->SpotLightEndAngle.GetValue() * (Math::Pi / 180.0f * 0.5f);
-					lightData.shaderMapId = 0xFFFF;
-                    if (pointLight->EnableShadows.GetValue() == 2)
-                        lightData.shaderMapId = 0xFFFE;
-					lights.Add(lightData);
+					int farLightId = lightIds[shadowLights[j]];
+					if (lightShadowMaps.TryGetValue(farLightId, shadowMapId))
+						lightShadowMaps.Remove(farLightId);
 				}
-                else if (light->lightType == LightType::Ambient)
-                {
-                    auto ambientLight = (AmbientLightActor*)(light);
-                    uniformData.ambient = ambientLight->Ambient.GetValue();
-                }
+				if (shadowMapId != -1)
+					lightShadowMaps[lightId] = shadowMapId;
+			}
+			lights[shadowLights[i]].shaderMapId = shadowMapId == -1 ? 0xFFFF : (unsigned short)shadowMapId;
+		}
+	}
+
+	int LightingEnvironment::AllocDynamicShadowMaps(int count)
+	{
+		int id = shadowMapAllocation.AllocShadowMaps(count);
+		if (id != -1)
+			dynamicShadowMaps.Add(ShadowMapRange{ id, count });
+		return id;
+	}
+
+	void LightingEnvironment::UploadLights()
+	{
+		auto & uploaded = uploadedLights[moduleInstance.GetCurrentVersion()];
+		auto lightPtr = (GpuLightData*)((char*)lightBufferPtr + moduleInstance.GetCurrentVersion() * lightBufferSize);
+		int uploadedCount = uploaded.Count();
+		uploaded.SetSize(lights.Count());
+		for (int i = 0; i < lights.Count(); i++)
+		{
+			if (i >= uploadedCount || memcmp(&uploaded[i], &lights[i], sizeof(GpuLightData)) != 0)
+			{
+				lightPtr[i] = lights[i];
+				uploaded[i] = lights[i];
 			}
-			else if (actorType == EngineActorType::EnvMap)
+		}
+	}
+
+	void LightingEnvironment::GatherSnapshot(Level * level, LightingSnapshot & snapshot)
+	{
+		snapshot.lights.Clear();
+		snapshot.lightIds.Clear();
+		snapshot.lightProbes.Clear();
+		snapshot.hasAmbient = false;
+		snapshot.sunLightEnabled = false;
+		snapshot.levelBounds.Min = Vec3::Create(-10.0f);
+		snapshot.levelBounds.Max = Vec3::Create(10.0f);
+		snapshot.levelBounds.Union(level->GetContentBounds());
+		GatherStaticContentChanges(level, snapshot);
+		for (auto actor : level->GetActorsOfType(EngineActorType::Light))
+		{
+			auto light = dynamic_cast<LightActor*>(actor);
+            // ignore static lights
+            if (light->Mobility.GetValue() == 0)
+                continue; 
+			if (light->lightType == LightType::Directional)
 			{
-				auto envMap = (EnvMapActor*)(actor.Value.Ptr());
-				if (envMap->GetEnvMapId() != -1)
+				auto dirLight = (DirectionalLightActor*)(light);
+				GpuLightData lightData;
+				memset(&lightData, 0, sizeof(lightData));
+				lightData.lightType = GpuLightType_Directional;
+				lightData.color = dirLight->Color.GetValue();
+				lightData.direction = PackDirection(dirLight->GetDirection());
+				auto localTransform = dirLight->GetLocalTransform();
+				lightData.position = Vec3::Create(localTransform.values[12], localTransform.values[13], localTransform.values[14]);
+				lightData.radius = dirLight->Radius.GetValue();
+				lightData.startAngle = lightData.endAngle = 0.0f;
+				lightData.shaderMapId = 0xFFFF;
+				lightData.dynamicShadowMapId = 0xFFFF;
+				if (dirLight->EnableShadows.GetValue() == 2 && !snapshot.sunLightEnabled)
+				{
+					snapshot.sunLightEnabled = true;
+					snapshot.sunLightColor = lightData.color;
+					snapshot.sunLightDir = dirLight->GetDirection();
+					snapshot.numShadowCascades = dirLight->NumShadowCascades.GetValue();
+					snapshot.shadowDistance = dirLight->ShadowDistance.GetValue();
+					snapshot.transitionFactor = dirLight->TransitionFactor.GetValue();
+				}
+				else
 				{
-					GpuLightProbeData probe;
-					probe.position = envMap->GetPosition();
-					probe.radius = envMap->Radius.GetValue();
-					probe.tintColor = envMap->TintColor.GetValue();
-					probe.envMapId = envMap->GetEnvMapId();
-					lightProbes.Add(probe);
+					snapshot.lights.Add(lightData);
+					snapshot.lightIds.Add(light->LightId);
 				}
 			}
+			else if (light->lightType == LightType::Point)
+			{
+				auto pointLight = (PointLightActor*)(light);
+				GpuLightData lightData;
+				memset(&lightData, 0, sizeof(lightData));
+				lightData.lightType = pointLight->IsSpotLight ? GpuLightType_Spot: GpuLightType_Point;
+				lightData.color = pointLight->Color.GetValue();
+				lightData.direction = PackDirection(pointLight->GetDirection());
+				auto localTransform = pointLight->GetLocalTransform();
+				lightData.position = Vec3::Create(localTransform.values[12], localTransform.values[13], localTransform.values[14]);
+				lightData.radius = pointLight->Radius.GetValue();
+				lightData.startAngle = pointLight->SpotLightStartAngle.GetValue() * (Math::Pi / 180.0f * 0.5f);
+				lightData.endAngle = pointLight->SpotLightEndAngle.GetValue() * (Math::Pi / 180.0f * 0.5f);
+				lightData.shaderMapId = 0xFFFF;
+				lightData.dynamicShadowMapId = 0xFFFF;
+                if (pointLight->EnableShadows.GetValue() == 2)
+                    lightData.shaderMapId = 0xFFFE;
+				snapshot.lights.Add(lightData);
+				snapshot.lightIds.Add(light->LightId);
+			}
+            else if (light->lightType == LightType::Ambient)
+            {
+                auto ambientLight = (AmbientLightActor*)(light);
+                snapshot.hasAmbient = true;
+                snapshot.ambient = ambientLight->Ambient.GetValue();
+            }
+		}
+		for (auto actor : level->GetActorsOfType(EngineActorType::EnvMap))
+		{
+			auto envMap = (EnvMapActor*)(actor);
+			if (envMap->GetEnvMapId() != -1)
+			{
+				GpuLightProbeData probe;
+				probe.position = envMap->GetPosition();
+				probe.radius = envMap->Radius.GetValue();
+				probe.tintColor = envMap->TintColor.GetValue();
+				probe.envMapId = envMap->GetEnvMapId();
+				snapshot.lightProbes.Add(probe);
+			}
 		}
-		if (lightProbes.Count() == 0)
+		if (snapshot.lightProbes.Count() == 0)
 		{
 			GpuLightProbeData probe;
 			probe.position = Vec3::Create(0.0f, 1000.0f, 0.0f);
 			probe.radius = 1e9f;
 			probe.tintColor = Vec3::Create(1.0f, 1.0f, 1.0f);
 			probe.envMapId = 0;
-			lightProbes.Add(probe);
+			snapshot.lightProbes.Add(probe);
 		}
+	}
+
+	void LightingEnvironment::GatherStaticContentChanges(Level * level, LightingSnapshot & snapshot)
+	{
+		snapshot.staticContentId = level->GetStaticContentId();
+		snapshot.droppedStaticContentVersion = level->GetStaticContentChanges(snapshot.staticContentChanges);
+	}
+
+	void LightingEnvironment::GatherInfo(HardwareRenderer* hw, DrawableSink * sink, const RenderProcedureParameters & params, int w, int h, StandardViewUniforms & viewUniform, WorldRenderPass * shadowRenderPass)
+	{
+		LightingSnapshot snapshot;
+		GatherSnapshot(params.level, snapshot);
+		GatherInfo(hw, sink, snapshot, params, w, h, viewUniform, shadowRenderPass);
+	}
+
+	void LightingEnvironment::GatherInfo(HardwareRenderer* hw, DrawableSink * sink, const LightingSnapshot & snapshot, const RenderProcedureParameters & params, int w, int h, StandardViewUniforms & viewUniform, WorldRenderPass * shadowRenderPass,
+		const CullFrustum * mainViewFrustum)
+	{
+		float aspect = w / (float)h;
+		auto camFrustum = params.view.GetFrustum(aspect);
+
+		// lights whose bounds miss the view cannot light anything visible. directional lights and lights with
+		// radius 0, which the shaders treat as unlimited range, are always kept
+		CullFrustum lightCullFrustum(camFrustum);
+		lights.Clear();
+		lightIds.Clear();
+		for (int i = 0; i < snapshot.lights.Count() && lights.Count() < MaxLights; i++)
+		{
+			auto & light = snapshot.lights[i];
+			if (light.lightType != GpuLightType_Directional && light.radius > 0.0f)
+			{
+				CoreLib::Graphics::BBox lightBounds;
+				lightBounds.Min = light.position - Vec3::Create(light.radius);
+				lightBounds.Max = light.position + Vec3::Create(light.radius);
+				if (!lightCullFrustum.IsBoxInFrustum(lightBounds))
+					continue;
+			}
+			lights.Add(light);
+			lightIds.Add(snapshot.lightIds[i]);
+		}
+		lightProbes = snapshot.lightProbes;
+		uniformData.sunLightEnabled = snapshot.sunLightEnabled;
+		if (snapshot.sunLightEnabled)
+		{
+			uniformData.lightColor = snapshot.sunLightColor;
+			uniformData.lightDir = snapshot.sunLightDir;
+		}
+		if (snapshot.hasAmbient)
+			uniformData.ambient = snapshot.ambient;
+		AssignShadowMaps(snapshot, viewUniform.CameraPos);
+		auto & shadowMapRes = shadowMapAllocation;
+		auto & levelBounds = snapshot.levelBounds;
 		//QueuePipelineBarrier(MakeArrayView(dynamic_cast<Texture*>(shadowMapRes.shadowMapArray.Ptr())), ArrayView<Texture*>());
 		float zmin = params.view.ZNear;
 		int shadowMapViewInstancePtr = 0;
 		int shadowMapSize = Engine::Instance()->GetGraphicsSettings().ShadowMapResolution;
-		float aspect = w / (float)h;
-		auto camFrustum = params.view.GetFrustum(aspect);
+		shadowMapViews.Clear();
 
 		// generate cascaded shadow map passes for sunlight
 		shadowRenderPass->Bind();
 		if (uniformData.sunLightEnabled)
 		{
-			int shadowMapStartId = shadowMapRes.AllocShadowMaps(sunlight->NumShadowCascades.GetValue());
+			int shadowMapStartId = sunShadowMapId;
 			uniformData.shadowMapId = shadowMapStartId;
 			if (shadowMapStartId != -1)
 			{
-				auto dirLightLocalTrans = sunlight->GetLocalTransform();
-				Vec3 dirLightPos = Vec3::Create(dirLightLocalTrans.values[12], dirLightLocalTrans.values[13], dirLightLocalTrans.values[14]);
-				float zmax = sunlight->ShadowDistance.GetValue();
-				Vec3 lightDir = sunlight->GetDirection();
-				for (int i = 0; i < sunlight->NumShadowCascades.GetValue(); i++)
+				float zmax = snapshot.shadowDistance;
+				Vec3 lightDir = snapshot.sunLightDir;
+				for (int i = 0; i < snapshot.numShadowCascades; i++)
 				{
 					StandardViewUniforms shadowMapView;
 					Vec3 viewZ = lightDir;
@@ -204,10 +427,10 @@ namespace GameEngine
 					shadowMapView.ViewTransform.m[0][0] = viewX.x; shadowMapView.ViewTransform.m[1][0] = viewX.y; shadowMapView.ViewTransform.m[2][0] = viewX.z;
 					shadowMapView.ViewTransform.m[0][1] = viewY.x; shadowMapView.ViewTransform.m[1][1] = viewY.y; shadowMapView.ViewTransform.m[2][1] = viewY.z;
 					shadowMapView.ViewTransform.m[0][2] = viewZ.x; shadowMapView.ViewTransform.m[1][2] = viewZ.y; shadowMapView.ViewTransform.m[2][2] = viewZ.z;
-					float iOverN = (i + 1) / (float)sunlight->NumShadowCascades.GetValue();
-					float zi = sunlight->TransitionFactor.GetValue() * zmin * pow(zmax / zmin, iOverN) + (1.0f - sunlight->TransitionFactor.GetValue())*(zmin + (iOverN)*(zmax - zmin));
+					float iOverN = (i + 1) / (float)snapshot.numShadowCascades;
+					float zi = snapshot.transitionFactor * zmin * pow(zmax / zmin, iOverN) + (1.0f - snapshot.transitionFactor)*(zmin + (iOverN)*(zmax - zmin));
 					uniformData.zPlanes[i] = zi;
-					uniformData.numCascades = sunlight->NumShadowCascades.GetValue();
+					uniformData.numCascades = snapshot.numShadowCascades;
 					auto verts = camFrustum.GetVertices(zmin, zi);
 					float d1 = (verts[0] - verts[2]).Length2() * 0.25f;
 					float d2 = (verts[4] - verts[6]).Length2() * 0.25f;
@@ -215,14 +438,20 @@ namespace GameEngine
 					float ti = Math::Min((d1 + d2 + f*f) / (2.0f*f), f);
 					float t = zmin + ti;
 					auto center = params.view.Position + params.view.GetDirection() * t;
-					float radius = (verts[6] - center).Length();
+					float radius = Math::Max((verts[6] - center).Length(), 1e-4f);
+					// the cascade size is quantized and the cascade moves in steps of many texels, so that its projection,
+					// and with it the cached static layer, stays the same while the camera moves within a step.
+					// the cascade is enlarged by a step so that it still covers the slice anywhere within the step.
+					float sizeQuantum = pow(2.0f, floor(log2(radius))) / 16.0f;
+					radius = ceil(radius / sizeQuantum) * sizeQuantum;
+					float viewSize = radius * 2.25f;
+					float texelSize = viewSize / shadowMapSize;
+					float snapStep = texelSize * Math::Max(1, shadowMapSize / 18);
 					auto transformedCenter = shadowMapView.ViewTransform.TransformNormal(center);
-					auto transformedCorner = transformedCenter - Vec3::Create(radius);
-					float viewSize = radius * 2.0f;
-					float texelSize = radius * 2.0f / shadowMapSize;
+					auto transformedCorner = transformedCenter - Vec3::Create(viewSize * 0.5f);
 
-					transformedCorner.x = Math::FastFloor(transformedCorner.x / texelSize) * texelSize;
-					transformedCorner.y = Math::FastFloor(transformedCorner.y / texelSize) * texelSize;
+					transformedCorner.x = Math::FastFloor(transformedCorner.x / snapStep) * snapStep;
+					transformedCorner.y = Math::FastFloor(transformedCorner.y / snapStep) * snapStep;
 					transformedCorner.z = Math::FastFloor(transformedCorner.z / texelSize) * texelSize;
 
 					Vec3 levelBoundMax = levelBounds.Max;
@@ -258,17 +487,14 @@ namespace GameEngine
 					viewportMatrix.m[1][1] = 0.5f; viewportMatrix.m[3][1] = 0.5f;
 					viewportMatrix.m[2][2] = 1.0f; viewportMatrix.m[3][2] = 0.0f;
 					Matrix4::Multiply(uniformData.lightMatrix[i], viewportMatrix, shadowMapView.ViewProjectionTransform);
-					AddShadowPass(hw, shadowRenderPass, sink, shadowMapRes, i + shadowMapStartId, shadowMapView, shadowMapViewInstancePtr);
+					shadowMapViews.Add(ShadowMapView{ shadowMapView, i + shadowMapStartId, -1 });
 				}
 			}
 		}
-        // sort light based on distance
-        lights.Sort([&](const GpuLightData &l1, const GpuLightData & l2) { return (l1.position - viewUniform.CameraPos).Length2() < (l2.position - viewUniform.CameraPos).Length2(); });
 		// generate shadow map passes for spot lights
-		for (auto & light : lights)
+		for (int lightIndex = 0; lightIndex < lights.Count(); lightIndex++)
 		{
-            if (light.shaderMapId == 0xFFFE)
-                light.shaderMapId = (unsigned short)shadowMapRes.AllocShadowMaps(1);
+			auto & light = lights[lightIndex];
 			if (light.shaderMapId != 0xFFFF)
 			{
 				Vec3 lightPos = light.position;
@@ -299,7 +525,89 @@ namespace GameEngine
 				viewportMatrix.m[1][1] = 0.5f; viewportMatrix.m[3][1] = 0.5f;
 				viewportMatrix.m[2][2] = 1.0f; viewportMatrix.m[3][2] = 0.0f;
 				Matrix4::Multiply(light.lightMatrix, viewportMatrix, shadowMapView.ViewProjectionTransform);
-				AddShadowPass(hw, shadowRenderPass, sink, shadowMapRes, light.shaderMapId, shadowMapView, shadowMapViewInstancePtr);
+				shadowMapViews.Add(ShadowMapView{ shadowMapView, (int)light.shaderMapId, lightIndex });
+			}
+		}
+		// cull the main view and all shadow map views in one sweep over the drawable bounds
+		cullBounds.Clear();
+		for (auto obj : sink->GetDrawables(false))
+			cullBounds.Add(obj->Bounds);
+		for (auto obj : sink->GetDrawables(true))
+			cullBounds.Add(obj->Bounds);
+		cullFrustums.Clear();
+		if (mainViewFrustum)
+			cullFrustums.Add(*mainViewFrustum);
+		for (auto & shadowView : shadowMapViews)
+			cullFrustums.Add(CullFrustum(shadowView.view.InvViewProjTransform));
+		CullBoxes(cullBounds, cullFrustums.GetArrayView(), cullMasks);
+		int shadowMaskStart = mainViewFrustum ? 1 : 0;
+
+		// casters retained by their actors are drawn into a static layer that is only drawn again when its projection changes
+		// or a retained caster within its frustum changes. the other casters are drawn into a dynamic layer every frame, which the
+		// shaders sample along with the static layer. all sun cascades share one dynamic range.
+		bool cacheStaticShadowMaps = Engine::Instance()->GetGraphicsSettings().CacheStaticShadowMaps;
+		auto & shadowMapCache = *sharedRes->shadowMapResources.shadowMapContents;
+		ApplyStaticContentChanges(shadowMapCache, snapshot);
+		auto & shadowMapContents = shadowMapCache.Keys;
+		uniformData.dynamicShadowMapId = -1;
+		for (auto & light : lights)
+			light.dynamicShadowMapId = 0xFFFF;
+		int numCascadeViews = 0;
+		bool cascadesHaveDynamicCasters = false;
+		viewHasDynamicCasters.SetSize(shadowMapViews.Count());
+		for (int i = 0; i < shadowMapViews.Count(); i++)
+		{
+			viewHasDynamicCasters[i] = HasDynamicShadowCaster(sink, cullMasks[i + shadowMaskStart]);
+			if (shadowMapViews[i].lightIndex == -1)
+			{
+				numCascadeViews++;
+				cascadesHaveDynamicCasters = cascadesHaveDynamicCasters || viewHasDynamicCasters[i];
+			}
+		}
+		int cascadeDynamicShadowMapId = -1;
+		if (cacheStaticShadowMaps && cascadesHaveDynamicCasters)
+			cascadeDynamicShadowMapId = AllocDynamicShadowMaps(numCascadeViews);
+		uniformData.dynamicShadowMapId = cascadeDynamicShadowMapId;
+		for (int i = 0; i < shadowMapViews.Count(); i++)
+		{
+			auto & shadowView = shadowMapViews[i];
+			auto & cullMask = cullMasks[i + shadowMaskStart];
+			int dynamicShadowMapId = -1;
+			if (shadowView.lightIndex == -1)
+			{
+				// cascade views come first, in cascade order
+				if (cascadeDynamicShadowMapId != -1)
+					dynamicShadowMapId = cascadeDynamicShadowMapId + i;
+			}
+			else if (cacheStaticShadowMaps && viewHasDynamicCasters[i])
+			{
+				dynamicShadowMapId = AllocDynamicShadowMaps(1);
+				if (dynamicShadowMapId != -1)
+					lights[shadowView.lightIndex].dynamicShadowMapId = (unsigned int)dynamicShadowMapId;
+			}
+			auto & content = shadowMapContents[shadowView.shadowMapId];
+			if (!cacheStaticShadowMaps || (viewHasDynamicCasters[i] && dynamicShadowMapId == -1))
+			{
+				// no layer is left for the dynamic casters, draw all casters into the shadow map
+				AddShadowPass(hw, shadowRenderPass, sink, shadowMapRes, shadowView.shadowMapId, shadowView.view, cullMask, ShadowCasterFilter::All,
+					shadowMapViewInstancePtr, params.renderStats);
+				content = 0;
+				continue;
+			}
+			auto staticContent = GetStaticShadowMapContent(shadowView.view);
+			if (content != staticContent)
+			{
+				// a layer missing casters whose pipelines are still compiling is drawn again next frame
+				bool complete = AddShadowPass(hw, shadowRenderPass, sink, shadowMapRes, shadowView.shadowMapId, shadowView.view, cullMask, ShadowCasterFilter::Static,
+					shadowMapViewInstancePtr, params.renderStats);
+				content = complete ? staticContent : 0;
+				shadowMapCache.Frustums[shadowView.shadowMapId] = cullFrustums[i + shadowMaskStart];
+			}
+			if (dynamicShadowMapId != -1)
+			{
+				AddShadowPass(hw, shadowRenderPass, sink, shadowMapRes, dynamicShadowMapId, shadowView.view, cullMask, ShadowCasterFilter::Dynamic,
+					shadowMapViewInstancePtr, params.renderStats);
+				shadowMapContents[dynamicShadowMapId] = 0;
 			}
 		}
 		uniformData.lightCount = lights.Count();
@@ -308,8 +616,7 @@ namespace GameEngine
         uniformData.lightListTilesX = (w + 15) / 16;
         uniformData.lightListTilesY = (h + 15) / 16;
 		moduleInstance.SetUniformData(&uniformData, sizeof(uniformData));
-		auto lightPtr = (GpuLightData*)((char*)lightBufferPtr + moduleInstance.GetCurrentVersion() * lightBufferSize);
-		memcpy(lightPtr, lights.Buffer(), lights.Count() * sizeof(GpuLightData));
+		UploadLights();
 		auto lightProbePtr = (GpuLightProbeData*)((char*)lightProbeBufferPtr + moduleInstance.GetCurrentVersion() * lightProbeBufferSize);
 		memcpy(lightProbePtr, lightProbes.Buffer(), Math::Min(MaxEnvMapCount, lightProbes.Count()) * sizeof(GpuLightProbeData));
 
@@ -327,6 +634,7 @@ namespace GameEngine
                 descSet->Update(8, tiledLightListBufffer.Ptr());
                 descSet->EndUpdate();
             }
+            AdvanceDescriptorSetEpoch();
         }
 	}
 
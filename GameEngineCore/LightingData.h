@@ -8,6 +8,7 @@
 #include "Level.h"
 #include "RenderProcedure.h"
 #include "StandardViewUniforms.h"
+#include "FrustumCulling.h"
 
 namespace GameEngine
 {
@@ -25,7 +26,8 @@ namespace GameEngine
 		VectorMath::Vec3 position;
 		unsigned int direction;
 		VectorMath::Vec3 color;
-        float padding;
+		// layer holding the casters that may move, drawn over shaderMapId, or 0xFFFF
+		unsigned int dynamicShadowMapId;
 		VectorMath::Matrix4 lightMatrix;
         float padding2[4];
 	};
@@ -48,28 +50,91 @@ namespace GameEngine
 		int numCascades = 0;
 		int lightCount = 0, lightProbeCount = 0;
 		VectorMath::Vec3 ambient = VectorMath::Vec3::Create(0.2f);
-        float padding1;
+		int dynamicShadowMapId = -1;
         int lightListTilesX, lightListTilesY, lightListSizePerTile;
 	};
 
+	// light state copied out of the level on the game thread, so that shadow passes and
+	// light uploads can be generated on the render thread while the level keeps changing
+	struct LightingSnapshot
+	{
+		CoreLib::List<GpuLightData> lights;
+		// LightActor::LightId of each light
+		CoreLib::List<int> lightIds;
+		CoreLib::List<GpuLightProbeData> lightProbes;
+		CoreLib::Graphics::BBox levelBounds;
+		bool hasAmbient = false;
+		VectorMath::Vec3 ambient;
+		bool sunLightEnabled = false;
+		VectorMath::Vec3 sunLightColor, sunLightDir;
+		int numShadowCascades = 0;
+		float shadowDistance = 0.0f, transitionFactor = 0.0f;
+		// Level::GetStaticContentId()
+		int staticContentId = 0;
+		// Level::GetStaticContentChanges()
+		CoreLib::List<StaticContentChange> staticContentChanges;
+		int droppedStaticContentVersion = 0;
+	};
+
+	struct ShadowMapView
+	{
+		StandardViewUniforms view;
+		int shadowMapId;
+		// index into LightingEnvironment::lights, -1 for sun light cascades
+		int lightIndex;
+	};
+
+	enum class ShadowCasterFilter
+	{
+		All, Static, Dynamic
+	};
+
 	class LightingEnvironment
 	{
 	private:
 		bool useEnvMap = true;
 		CoreLib::RefPtr<TextureCubeArray> emptyEnvMapArray;
         CoreLib::RefPtr<Texture2DArray> emptyLightmapArray;
-		void AddShadowPass(HardwareRenderer* hw, WorldRenderPass * shadowRenderPass, DrawableSink * sink, ShadowMapResource & shadowMapRes, int shadowMapId,
-			StandardViewUniforms & shadowMapView, int & shadowMapViewInstancePtr);
+		// shadow maps stay assigned to the same light across frames, allocations are tracked on a copy of the shared shadow map resource
+		ShadowMapResource shadowMapAllocation;
+		Texture2DArray * allocatedShadowMapArray = nullptr;
+		CoreLib::EnumerableDictionary<int, int> lightShadowMaps;
+		int sunShadowMapId = -1, sunShadowMapCount = 0;
+		CoreLib::List<int> shadowLights, releasedShadowMapLights;
+		CoreLib::HashSet<int> shadowLightIds;
+		struct ShadowMapRange
+		{
+			int id, count;
+		};
+		// layers for the casters that may move are allocated for one frame
+		CoreLib::List<ShadowMapRange> dynamicShadowMaps;
+		CoreLib::List<bool> viewHasDynamicCasters;
+		int AllocDynamicShadowMaps(int count);
+		// content of each version of the light buffer, only lights that differ from it are written
+		CoreLib::List<GpuLightData> uploadedLights[DynamicBufferLengthMultiplier];
+		// returns false if casters were left out because their pipelines are still being compiled
+		bool AddShadowPass(HardwareRenderer* hw, WorldRenderPass * shadowRenderPass, DrawableSink * sink, ShadowMapResource & shadowMapRes, int shadowMapId,
+			StandardViewUniforms & shadowMapView, const CullMask & cullMask, ShadowCasterFilter filter, int & shadowMapViewInstancePtr, RenderStat * stats);
+		void AssignShadowMaps(const LightingSnapshot & snapshot, VectorMath::Vec3 cameraPos);
+		void UploadLights();
 	public:
 		DeviceMemory * uniformMemory;
 		ModuleInstance moduleInstance;
+		// lights whose bounds intersect the view frustum, in the order of the snapshot
 		CoreLib::List<GpuLightData> lights;
+		CoreLib::List<int> lightIds;
 		CoreLib::List<GpuLightProbeData> lightProbes;
 		CoreLib::List<Texture*> lightProbeTextures;
 		CoreLib::List<CoreLib::RefPtr<Texture2D>> shadowMaps;
 		CoreLib::RefPtr<Buffer> lightBuffer, lightProbeBuffer;
 		CoreLib::List<ModuleInstance> shadowViewInstances;
 		CoreLib::List<Drawable*> drawableBuffer, reorderBuffer;
+		CoreLib::List<ShadowMapView> shadowMapViews;
+		// bounds of all opaque drawables followed by all transparent drawables of the sink
+		CullBoundsList cullBounds;
+		CoreLib::List<CullFrustum> cullFrustums;
+		// visibility of cullBounds in the main view (if given) followed by each shadow map view
+		CoreLib::List<CullMask> cullMasks;
         CoreLib::RefPtr<Buffer> tiledLightListBufffer;
         int tiledLightListBufferSize = 0;
         DeviceLightmapSet * deviceLightmapSet = nullptr;
@@ -77,6 +142,11 @@ namespace GameEngine
 		void* lightBufferPtr, *lightProbeBufferPtr;
 		int lightBufferSize, lightProbeBufferSize;
 		LightingUniform uniformData;
+		static void GatherSnapshot(Level * level, LightingSnapshot & snapshot);
+		// called again once drawables are collected, so that the changes they record apply in the same frame
+		static void GatherStaticContentChanges(Level * level, LightingSnapshot & snapshot);
+		void GatherInfo(HardwareRenderer* hw, DrawableSink * sink, const LightingSnapshot & snapshot, const RenderProcedureParameters & params, int w, int h, StandardViewUniforms & cameraView, WorldRenderPass * shadowPass,
+			const CullFrustum * mainViewFrustum = nullptr);
 		void GatherInfo(HardwareRenderer* hw, DrawableSink * sink, const RenderProcedureParameters & params, int w, int h, StandardViewUniforms & cameraView, WorldRenderPass * shadowPass);
 		void Init(RendererSharedResource & sharedRes, DeviceMemory * uniformMemory, bool pUseEnvMap);
 		void UpdateSharedResourceBinding();
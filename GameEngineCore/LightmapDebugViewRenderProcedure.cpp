@@ -184,6 +184,10 @@ namespace GameEngine
             return drawableBuffer.GetArrayView();
         }
 
+        virtual bool Extract(const RenderProcedureParameters & /*params*/) override
+        {
+            return false;
+        }
         virtual void Run(const RenderProcedureParameters & params) override
         {
             int w = 0, h = 0;
@@ -265,7 +269,7 @@ namespace GameEngine
             customDepthOutput->GetFrameBuffer()->GetRenderAttachments().GetTextures(textures);
             customDepthRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&standardViewParams);
-            customDepthPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, cameraCullFrustum, true));
+            customDepthPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, cameraCullFrustum, true), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             customDepthPassInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
 
@@ -273,7 +277,7 @@ namespace GameEngine
             forwardBaseOutput->GetFrameBuffer()->GetRenderAttachments().GetTextures(textures);
             forwardRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&lightmapViewParams);
-            forwardBaseInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, cameraCullFrustum, false));
+            forwardBaseInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, cameraCullFrustum, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             forwardBaseInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
 
@@ -172,7 +172,24 @@ namespace GameEngine
             Matrix4::CreateIdentityMatrix(identity);
             obj->SetModelTransform(identity);
             rs->objects[i] = obj;
-            physScene.AddObject(obj);
+        }
+        if (rs->objects.Count() > 1)
+        {
+            // the bones move every frame, only the bounds of the whole skeleton are tracked by the scene
+            List<int> boneParents;
+            boneParents.SetSize(rs->objects.Count());
+            for (int i = 0; i < boneParents.Count(); i++)
+                boneParents[i] = skeleton.Bones[i].ParentId;
+            rs->compound = new PhysicsObject(rs->objects.GetArrayView(), boneParents.GetArrayView());
+            rs->compound->ParentActor = actor;
+            rs->compound->Tag = tag;
+            rs->compound->Channels = channels;
+            physScene.AddObject(rs->compound.Ptr());
+        }
+        else
+        {
+            for (auto obj : rs->objects)
+                physScene.AddObject(obj);
         }
         return rs;
     }
@@ -185,10 +202,19 @@ namespace GameEngine
     void ModelDrawableInstance::UpdateTransformUniform(VectorMath::Matrix4 localTransform, Pose &pose,
         RetargetFile *retargetFile, ArrayView<BlendShapeWeightInfo> *blendShapeInfo)
 	{
+        if (Drawables.Count() == 0)
+            return;
+        SkinningPalette palette;
+        palette.Update(Drawables[0]->GetSkeleton(), pose, retargetFile);
+        UpdateTransformUniform(localTransform, palette, blendShapeInfo);
+	}
+    void ModelDrawableInstance::UpdateTransformUniform(VectorMath::Matrix4 localTransform, const SkinningPalette &palette,
+        ArrayView<BlendShapeWeightInfo> *blendShapeInfo)
+	{
         int elementId = 0;
         for (auto &drawable : Drawables)
         {
-            drawable->UpdateTransformUniform(localTransform, pose, retargetFile, blendShapeInfo ? &(*blendShapeInfo)[elementId] : nullptr);
+            drawable->UpdateTransformUniform(localTransform, palette, blendShapeInfo ? &(*blendShapeInfo)[elementId] : nullptr);
             elementId++;
         }
 	}
@@ -196,29 +222,46 @@ namespace GameEngine
 	{
 		for (int i = 0; i < objects.Count(); i++)
 			objects[i]->SetModelTransform(localTransform);
+		if (compound)
+			compound->RefitParts();
 	}
 	void ModelPhysicsInstance::SetTransform(VectorMath::Matrix4 localTransform, Pose & pose, RetargetFile * retarget)
 	{
-		List<Matrix4> matrices;
-		pose.GetMatrices(skeleton, matrices, true, retarget);
-		for (int i = 0; i < matrices.Count(); i++)
+		SkinningPalette palette;
+		palette.Update(skeleton, pose, retarget);
+		SetTransform(localTransform, palette);
+	}
+	void ModelPhysicsInstance::SetTransform(VectorMath::Matrix4 localTransform, const SkinningPalette & palette)
+	{
+		for (int i = 0; i < palette.Matrices.Count(); i++)
 		{
-			Matrix4::Multiply(matrices[i], localTransform, matrices[i]);
-			objects[i]->SetModelTransform(matrices[i]);
+			Matrix4 transform;
+			Matrix4::Multiply(transform, localTransform, palette.Matrices[i]);
+			objects[i]->SetModelTransform(transform);
 		}
+		if (compound)
+			compound->RefitParts();
 	}
     void ModelPhysicsInstance::SetChannels(PhysicsChannels channels)
     {
         for (auto & obj : objects)
             obj->Channels = channels;
+        if (compound)
+            compound->Channels = channels;
     }
 	void ModelPhysicsInstance::RemoveFromScene()
 	{
 		if (scene)
 		{
-			for (auto obj : objects)
-				scene->RemoveObject(obj);
+			if (compound)
+				scene->RemoveObject(compound.Ptr());
+			else
+			{
+				for (auto obj : objects)
+					scene->RemoveObject(obj);
+			}
 		}
 		objects.Clear();
+		compound = nullptr;
 	}
 }
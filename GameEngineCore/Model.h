@@ -24,6 +24,8 @@ namespace GameEngine
 		void UpdateTransformUniform(VectorMath::Matrix4 localTransform);
         void UpdateTransformUniform(VectorMath::Matrix4 localTransform, Pose &pose, RetargetFile *retargetFile,
             CoreLib::ArrayView<BlendShapeWeightInfo> * blendShapeInfo);
+        void UpdateTransformUniform(VectorMath::Matrix4 localTransform, const SkinningPalette &palette,
+            CoreLib::ArrayView<BlendShapeWeightInfo> * blendShapeInfo);
 	};
 
 	class ModelPhysicsInstance
@@ -33,9 +35,12 @@ namespace GameEngine
 	public:
 		bool isSkeletal = false;
 		Skeleton * skeleton = nullptr;
+		// one object per bone. the bones of a skeletal model are parts of a single compound object in the scene
 		CoreLib::List<PhysicsObject*> objects;
+		CoreLib::RefPtr<PhysicsObject> compound;
 		void SetTransform(VectorMath::Matrix4 localTransform);
 		void SetTransform(VectorMath::Matrix4 localTransform, Pose & pose, RetargetFile * retargetFile);
+		void SetTransform(VectorMath::Matrix4 localTransform, const SkinningPalette & palette);
         void SetChannels(PhysicsChannels channels);
 		void RemoveFromScene();
 		ModelPhysicsInstance(PhysicsScene * pScene)
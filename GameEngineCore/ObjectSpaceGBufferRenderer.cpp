@@ -112,6 +112,7 @@ namespace GameEngine
             param.UseSkeleton = false;
             actor->GetDrawables(param);
 
+            Engine::Instance()->GetRenderer()->GetSceneResource()->FlushUploads(renderStats);
             hwRenderer->BeginJobSubmission();
             cmdBuffer->BeginRecording(frameBuffer.Ptr());
             cmdBuffer->SetViewport(Viewport(0, 0, width, height));
@@ -0,0 +1,240 @@
+#include "OcclusionCulling.h"
+#include <float.h>
+
+using namespace VectorMath;
+using namespace CoreLib;
+
+namespace GameEngine
+{
+	// occluders covering less than this fraction of the view distance are not worth rasterizing
+	const float MinOccluderScreenSize = 0.05f;
+
+	typedef Array<Vec4, 16> ClipPolygon;
+
+	// clips a polygon in clip space against the plane dot(plane, v) >= 0
+	static void ClipAgainstPlane(ClipPolygon & output, const ClipPolygon & input, Vec4 plane)
+	{
+		output.Clear();
+		for (int i = 0; i < input.Count(); i++)
+		{
+			auto v0 = input[i];
+			auto v1 = input[(i + 1) % input.Count()];
+			float d0 = Vec4::Dot(plane, v0);
+			float d1 = Vec4::Dot(plane, v1);
+			if (d0 >= 0.0f)
+				output.Add(v0);
+			if ((d0 >= 0.0f) != (d1 >= 0.0f))
+			{
+				float t = d0 / (d0 - d1);
+				output.Add(v0 + (v1 - v0) * t);
+			}
+		}
+	}
+
+	void OcclusionBuffer::Clear(const Matrix4 & viewProjectionTransform, int width, int height)
+	{
+		viewProjection = viewProjectionTransform;
+		int levelCount = 1;
+		for (int size = Math::Max(width, height); size > 1; size = (size + 1) >> 1)
+			levelCount++;
+		levels.SetSize(levelCount);
+		for (auto & level : levels)
+		{
+			level.Init(width, height);
+			width = (width + 1) >> 1;
+			height = (height + 1) >> 1;
+		}
+		levels[0].Clear(1.0f);
+	}
+
+	int OcclusionBuffer::AddOccluder(Mesh * mesh, MeshElementRange range, const Matrix4 & localTransform)
+	{
+		// near plane and the four side planes, the far plane is left out since depth is clamped to the triangle anyway
+		static const Vec4 clipPlanes[] =
+		{
+			Vec4::Create(0.0f, 0.0f, 1.0f, 0.0f),
+			Vec4::Create(1.0f, 0.0f, 0.0f, 1.0f),
+			Vec4::Create(-1.0f, 0.0f, 0.0f, 1.0f),
+			Vec4::Create(0.0f, 1.0f, 0.0f, 1.0f),
+			Vec4::Create(0.0f, -1.0f, 0.0f, 1.0f)
+		};
+		auto & canvas = levels[0];
+		Matrix4 transform;
+		Matrix4::Multiply(transform, viewProjection, localTransform);
+		int triangleCount = range.Count / 3;
+		ClipPolygon polygon, clipped;
+		Array<Vec3, 16> screenPos;
+		for (int i = 0; i < triangleCount; i++)
+		{
+			polygon.Clear();
+			for (int j = 0; j < 3; j++)
+			{
+				auto pos = mesh->GetVertexPosition(mesh->Indices[range.StartIndex + i * 3 + j]);
+				polygon.Add(transform.Transform(Vec4::Create(pos, 1.0f)));
+			}
+			for (auto & plane : clipPlanes)
+			{
+				ClipAgainstPlane(clipped, polygon, plane);
+				polygon = clipped;
+				if (polygon.Count() < 3)
+					break;
+			}
+			if (polygon.Count() < 3)
+				continue;
+			screenPos.Clear();
+			for (auto & v : polygon)
+			{
+				float invW = 1.0f / v.w;
+				screenPos.Add(Vec3::Create(v.x * invW * 0.5f + 0.5f, v.y * invW * 0.5f + 0.5f, v.z * invW));
+			}
+			// the clipped polygon lies on a single plane, rasterize it as a fan
+			for (int j = 2; j < screenPos.Count(); j++)
+			{
+				auto s0 = screenPos[0], s1 = screenPos[j - 1], s2 = screenPos[j];
+				auto p0 = Vec3::Create(s0.x * canvas.width, s0.y * canvas.height, s0.z);
+				auto p1 = Vec3::Create(s1.x * canvas.width, s1.y * canvas.height, s1.z);
+				auto p2 = Vec3::Create(s2.x * canvas.width, s2.y * canvas.height, s2.z);
+				auto normal = Vec3::Cross(p1 - p0, p2 - p0);
+				if (fabs(normal.z) < 1e-6f)
+					continue;
+				Vec3 depthPlane;
+				depthPlane.x = -normal.x / normal.z;
+				depthPlane.y = -normal.y / normal.z;
+				depthPlane.z = p0.z - depthPlane.x * p0.x - depthPlane.y * p0.y;
+				ProjectedTriangle tri;
+				Rasterizer::SetupTriangle(tri, Vec2::Create(s0.x, s0.y), Vec2::Create(s1.x, s1.y), Vec2::Create(s2.x, s2.y), canvas.width, canvas.height, 0);
+				Rasterizer::RasterizeDepth(canvas, tri, depthPlane, Math::Min(s0.z, Math::Min(s1.z, s2.z)),
+					Math::Max(s0.z, Math::Max(s1.z, s2.z)));
+			}
+		}
+		return triangleCount;
+	}
+
+	void OcclusionBuffer::BuildHierarchy()
+	{
+		for (int i = 1; i < levels.Count(); i++)
+		{
+			auto & src = levels[i - 1];
+			auto & dest = levels[i];
+			for (int y = 0; y < dest.height; y++)
+			{
+				int y0 = y * 2;
+				int y1 = Math::Min(y0 + 1, src.height - 1);
+				for (int x = 0; x < dest.width; x++)
+				{
+					int x0 = x * 2;
+					int x1 = Math::Min(x0 + 1, src.width - 1);
+					float d = Math::Max(Math::Max(src.depth[y0 * src.width + x0], src.depth[y0 * src.width + x1]),
+						Math::Max(src.depth[y1 * src.width + x0], src.depth[y1 * src.width + x1]));
+					dest.depth[y * dest.width + x] = d;
+				}
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsBoxVisible(const CoreLib::Graphics::BBox & box)
+	{
+		auto & canvas = levels[0];
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+		float minDepth = FLT_MAX;
+		for (int i = 0; i < 8; i++)
+		{
+			auto corner = Vec4::Create((i & 1) ? box.xMax : box.xMin, (i & 2) ? box.yMax : box.yMin, (i & 4) ? box.zMax : box.zMin, 1.0f);
+			auto p = viewProjection.Transform(corner);
+			// boxes reaching the near plane cannot be tested
+			if (p.w <= 1e-5f || p.z < 0.0f)
+				return true;
+			float invW = 1.0f / p.w;
+			float x = (p.x * invW * 0.5f + 0.5f) * canvas.width;
+			float y = (p.y * invW * 0.5f + 0.5f) * canvas.height;
+			minX = Math::Min(minX, x);
+			maxX = Math::Max(maxX, x);
+			minY = Math::Min(minY, y);
+			maxY = Math::Max(maxY, y);
+			minDepth = Math::Min(minDepth, p.z * invW);
+		}
+		// boxes outside of the buffer are left to frustum culling
+		if (maxX < 0.0f || maxY < 0.0f || minX >= canvas.width || minY >= canvas.height)
+			return true;
+		// occluders cover pixels by their centers, grow the box by a pixel to stay conservative at occluder silhouettes
+		int x0 = Math::Max(0, (int)minX - 1);
+		int y0 = Math::Max(0, (int)minY - 1);
+		int x1 = Math::Min(canvas.width - 1, (int)maxX + 1);
+		int y1 = Math::Min(canvas.height - 1, (int)maxY + 1);
+		// pick the level where the box covers at most 3x3 texels
+		int level = 0;
+		for (int size = Math::Max(x1 - x0, y1 - y0); size > 1 && level + 1 < levels.Count(); size >>= 1)
+			level++;
+		auto & depthLevel = levels[level];
+		float maxDepth = 0.0f;
+		for (int y = (y0 >> level); y <= (y1 >> level); y++)
+			for (int x = (x0 >> level); x <= (x1 >> level); x++)
+				maxDepth = Math::Max(maxDepth, depthLevel.depth[y * depthLevel.width + x]);
+		return minDepth <= maxDepth;
+	}
+
+	int OcclusionCuller::Cull(DrawableSink & sink, const CullMask & frustumMask, const Matrix4 & viewProjectionTransform,
+		Vec3 cameraPos, float aspect, CullMask & result)
+	{
+		result.Bits.Clear();
+		result.Bits.AddRange(frustumMask.Bits);
+
+		// rank visible opaque static meshes by their approximate on-screen size
+		candidates.Clear();
+		int boxId = 0;
+		for (auto drawable : sink.GetDrawables(false))
+		{
+			int id = boxId++;
+			if (!frustumMask.IsVisible(id) || !drawable->GetSourceMesh() || drawable->GetPrimitiveType() != PrimitiveType::Triangles)
+				continue;
+			// drawables that do not cast shadows (editor gizmos, decals) are not treated as solid
+			if (!drawable->CastShadow)
+				continue;
+			auto radius = (drawable->Bounds.Max - drawable->Bounds.Min).Length() * 0.5f;
+			auto center = (drawable->Bounds.Max + drawable->Bounds.Min) * 0.5f;
+			auto distance = Math::Max((center - cameraPos).Length(), 1e-3f);
+			auto size = radius / distance;
+			if (size < MinOccluderScreenSize)
+				continue;
+			OccluderCandidate candidate;
+			candidate.drawable = drawable;
+			candidate.score = size;
+			candidates.Add(candidate);
+		}
+		if (candidates.Count() == 0)
+			return 0;
+		candidates.Sort([](const OccluderCandidate & c1, const OccluderCandidate & c2) { return c1.score > c2.score; });
+
+		int bufferHeight = Math::Max(8, (int)(OcclusionBufferWidth / aspect + 0.5f));
+		buffer.Clear(viewProjectionTransform, OcclusionBufferWidth, bufferHeight);
+		int triangleBudget = OccluderTriangleBudget;
+		for (auto & candidate : candidates)
+		{
+			auto range = candidate.drawable->GetElementRange();
+			if (range.Count / 3 > triangleBudget)
+				continue;
+			triangleBudget -= buffer.AddOccluder(candidate.drawable->GetSourceMesh(), range, candidate.drawable->GetLocalTransform());
+		}
+		buffer.BuildHierarchy();
+
+		int culledCount = 0;
+		auto testDrawables = [&](ArrayView<Drawable*> drawables, int startId)
+		{
+			for (int i = 0; i < drawables.Count(); i++)
+			{
+				int id = startId + i;
+				if (!result.IsVisible(id))
+					continue;
+				if (!buffer.IsBoxVisible(drawables[i]->Bounds))
+				{
+					result.Bits[id >> 5] &= ~(1u << (id & 31));
+					culledCount++;
+				}
+			}
+		};
+		auto opaqueDrawables = sink.GetDrawables(false);
+		testDrawables(opaqueDrawables, 0);
+		testDrawables(sink.GetDrawables(true), opaqueDrawables.Count());
+		return culledCount;
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef GAME_ENGINE_OCCLUSION_CULLING_H
+#define GAME_ENGINE_OCCLUSION_CULLING_H
+
+#include "Rasterizer.h"
+#include "FrustumCulling.h"
+#include "Drawable.h"
+
+namespace GameEngine
+{
+	// width of the software depth buffer, its height follows the aspect ratio of the view
+	const int OcclusionBufferWidth = 256;
+	// maximum number of occluder triangles rasterized per view
+	const int OccluderTriangleBudget = 16384;
+
+	// a low resolution depth buffer of conservatively rasterized occluders, with a max-depth mip chain for box tests.
+	// depth is post-projection z / w, so the view-projection transform must map to ClipSpaceType::ZeroToOne.
+	class OcclusionBuffer
+	{
+	private:
+		CoreLib::List<DepthCanvas> levels;
+		VectorMath::Matrix4 viewProjection;
+	public:
+		void Clear(const VectorMath::Matrix4 & viewProjectionTransform, int width, int height);
+		// rasterizes the triangles of a mesh element, returns the number of triangles processed
+		int AddOccluder(Mesh * mesh, MeshElementRange range, const VectorMath::Matrix4 & localTransform);
+		// must be called after all occluders are added and before testing boxes
+		void BuildHierarchy();
+		bool IsBoxVisible(const CoreLib::Graphics::BBox & box);
+	};
+
+	// picks the largest on-screen opaque static drawables as occluders and removes the drawables they hide
+	class OcclusionCuller
+	{
+	private:
+		struct OccluderCandidate
+		{
+			Drawable * drawable;
+			float score;
+		};
+		OcclusionBuffer buffer;
+		CoreLib::List<OccluderCandidate> candidates;
+	public:
+		// boxes are numbered as in the frustum culling of the sink: opaque drawables first, then transparent ones.
+		// writes frustumMask with occluded drawables removed to result, and returns the number of drawables removed.
+		int Cull(DrawableSink & sink, const CullMask & frustumMask, const VectorMath::Matrix4 & viewProjectionTransform,
+			VectorMath::Vec3 cameraPos, float aspect, CullMask & result);
+	};
+}
+#endif
@@ -51,81 +51,362 @@ namespace GameEngine
 		return true;
 	}
 
+	class PhysicsModelBvhEvaluator
+	{
+	public:
+		static const int ElementsPerNode = 4;
+		inline float EvalCost(int n1, float a1, int n2, float a2, float area)
+		{
+			return 0.125f + ((float)n1*a1 + (float)n2*a2) / area;
+		}
+	};
+
+	class PhysicsFaceTracer
+	{
+	public:
+		const PhysicsModel::MeshFace * faces;
+		float tmin;
+		inline bool Trace(HitPoint & inter, const PhysicsModel::MeshFace & face, const Ray & ray, float & t) const
+		{
+			if (!RayTriangleTest(inter, face, ray.Origin, ray.Dir, tmin, ray.tMax))
+				return false;
+			inter.FaceId = (int)(&face - faces);
+			t = inter.Distance;
+			return true;
+		}
+	};
+
 	HitPoint PhysicsModel::TraceRay(VectorMath::Vec3 origin, VectorMath::Vec3 dir, float tmin, float tmax)
 	{
 		HitPoint current;
 		current.Distance = tmax;
-		for (int i = 0; i < faces.Count(); i++)
+		if (faceBvh.Nodes.Count() == 0)
+			return current;
+		Ray ray;
+		ray.Origin = origin;
+		ray.Dir = dir;
+		ray.tMax = tmax;
+		PhysicsFaceTracer tracer;
+		tracer.faces = faceBvh.Elements.Buffer();
+		tracer.tmin = tmin;
+		TraverseBvh<MeshFace, PhysicsFaceTracer, HitPoint, false>(tracer, current, faceBvh, ray, BvhRcpDir(dir));
+		return current;
+	}
+
+	bool PhysicsModel::TraceRayAny(VectorMath::Vec3 origin, VectorMath::Vec3 dir, float tmin, float tmax)
+	{
+		if (faceBvh.Nodes.Count() == 0)
+			return false;
+		Ray ray;
+		ray.Origin = origin;
+		ray.Dir = dir;
+		ray.tMax = tmax;
+		PhysicsFaceTracer tracer;
+		tracer.faces = faceBvh.Elements.Buffer();
+		tracer.tmin = tmin;
+		HitPoint hit;
+		return TraverseBvh<MeshFace, PhysicsFaceTracer, HitPoint, true>(tracer, hit, faceBvh, ray, BvhRcpDir(dir));
+	}
+
+	void PhysicsObject::SetModelTransform(const VectorMath::Matrix4 & m)
+	{
+		modelTransform = m;
+		m.Inverse(inverseModelTransform);
+		CoreLib::Graphics::BBox nullBox;
+		nullBox.Init();
+		bounds.Init();
+		if (nullBox != model->GetBounds())
+			CoreLib::Graphics::TransformBBox(bounds, m, model->GetBounds());
+		MarkModelTransformChanged();
+	}
+
+	void PhysicsObject::MarkModelTransformChanged()
+	{
+		if (!modelTransformChanged)
 		{
-			HitPoint hit;
-			if (RayTriangleTest(hit, faces[i], origin, dir, tmin, current.Distance))
+			modelTransformChanged = true;
+			if (scene)
+				scene->ObjectMoved(this);
+		}
+	}
+
+	PhysicsObject::PhysicsObject(CoreLib::ArrayView<PhysicsObject*> pParts, CoreLib::ArrayView<int> pPartParents)
+	{
+		VectorMath::Matrix4::CreateIdentityMatrix(modelTransform);
+		VectorMath::Matrix4::CreateIdentityMatrix(inverseModelTransform);
+		int count = pParts.Count();
+		parts.SetSize(count);
+		CoreLib::List<int> firstChild, nextSibling, stack;
+		firstChild.SetSize(count);
+		nextSibling.SetSize(count);
+		for (int i = 0; i < count; i++)
+		{
+			parts[i] = pParts[i];
+			firstChild[i] = nextSibling[i] = -1;
+		}
+		for (int i = count - 1; i >= 0; i--)
+		{
+			if (pPartParents[i] == -1)
+				stack.Add(i);
+			else
 			{
-				current = hit;
-				current.FaceId = i;
+				nextSibling[i] = firstChild[pPartParents[i]];
+				firstChild[pPartParents[i]] = i;
 			}
 		}
-		return current;
+		// depth-first order, the end of a subtree is known once all of its descendants are placed
+		CoreLib::List<int> orderIndex;
+		orderIndex.SetSize(count);
+		partSubtreeEnd.SetSize(count);
+		while (stack.Count())
+		{
+			int part = stack.Last();
+			stack.RemoveAt(stack.Count() - 1);
+			orderIndex[part] = partOrder.Count();
+			partOrder.Add(part);
+			for (int child = firstChild[part]; child != -1; child = nextSibling[child])
+				stack.Add(child);
+		}
+		for (int i = partOrder.Count() - 1; i >= 0; i--)
+		{
+			int part = partOrder[i];
+			int end = i + 1;
+			for (int child = firstChild[part]; child != -1; child = nextSibling[child])
+				end = CoreLib::Math::Max(end, partSubtreeEnd[orderIndex[child]]);
+			partSubtreeEnd[i] = end;
+		}
+		partBounds.SetSize(partOrder.Count());
+		RefitParts();
+	}
+
+	void PhysicsObject::RefitParts()
+	{
+		// descendants follow their ancestors, so a reverse walk sees every part after all of its children
+		for (int i = partOrder.Count() - 1; i >= 0; i--)
+		{
+			auto part = parts[partOrder[i]].Ptr();
+			partBounds[i] = part->bounds;
+			part->ClearModelTransformDirtyBit();
+			for (int child = i + 1; child < partSubtreeEnd[i]; child = partSubtreeEnd[child])
+				partBounds[i].Union(partBounds[child]);
+		}
+		bounds.Init();
+		for (int i = 0; i < partOrder.Count(); i = partSubtreeEnd[i])
+			bounds.Union(partBounds[i]);
+		MarkModelTransformChanged();
+	}
+
+	PhysicsScene::~PhysicsScene()
+	{
+		for (auto & obj : objects)
+			obj->scene = nullptr;
+	}
+
+	void PhysicsScene::ObjectMoved(PhysicsObject * obj)
+	{
+		movedObjectsLock.Lock();
+		movedObjects.Add(obj);
+		movedObjectsLock.Unlock();
+	}
+
+	void PhysicsScene::UpdateObjectProxy(PhysicsObject * obj)
+	{
+		auto & bounds = obj->bounds;
+		// objects without faces can never be hit and stay out of the tree
+		bool isEmpty = bounds.xMin > bounds.xMax || bounds.yMin > bounds.yMax || bounds.zMin > bounds.zMax;
+		if (isEmpty)
+		{
+			if (obj->proxyId != -1)
+			{
+				objectTree.Remove(obj->proxyId);
+				obj->proxyId = -1;
+			}
+		}
+		else if (obj->proxyId == -1)
+			obj->proxyId = objectTree.Insert(bounds, obj);
+		else
+			objectTree.Move(obj->proxyId, bounds);
+		obj->ClearModelTransformDirtyBit();
 	}
 
 	void PhysicsScene::AddObject(PhysicsObject * obj)
 	{
 		objects.Add(obj);
+		obj->scene = this;
+		UpdateObjectProxy(obj);
 	}
 
 	void PhysicsScene::RemoveObject(PhysicsObject * obj)
 	{
+		if (obj->scene != this)
+			return;
+		if (obj->proxyId != -1)
+		{
+			objectTree.Remove(obj->proxyId);
+			obj->proxyId = -1;
+		}
+		if (obj->modelTransformChanged)
+		{
+			movedObjectsLock.Lock();
+			int index = movedObjects.IndexOf(obj);
+			if (index != -1)
+			{
+				movedObjects[index] = movedObjects.Last();
+				movedObjects.RemoveAt(movedObjects.Count() - 1);
+			}
+			movedObjectsLock.Unlock();
+		}
+		obj->scene = nullptr;
 		objects.Remove(obj);
 	}
 
+	void PhysicsScene::UpdateBroadphase()
+	{
+		for (auto obj : movedObjects)
+			UpdateObjectProxy(obj);
+		movedObjects.Clear();
+	}
+
 	void PhysicsScene::Tick()
 	{
+		UpdateBroadphase();
 	}
 
-	TraceResult PhysicsScene::RayTraceFirst(const Ray & ray, PhysicsChannels channels, float maxDist)
+	TraceResult PhysicsScene::TraceRay(const Ray & ray, PhysicsChannels channels, float maxDist, bool anyHit, bool includeMovedObjects)
 	{
 		TraceResult rs;
 		HitPoint curHitPoint;
 		curHitPoint.Distance = maxDist;
-		for (auto obj : objects)
+		float dirLength = ray.Dir.Length();
+		// subtrees starting behind the closest hit found so far are skipped
+		auto rayBoxTest = [&](const CoreLib::Graphics::BBox & box)
 		{
-            if ((obj->Channels.value & channels.value) == 0)
-                continue;
+			if (anyHit && rs.Object)
+				return false;
 			float tmin = 0.0f;
 			float tmax = 0.0f;
-			if (CoreLib::Graphics::RayBBoxIntersection(obj->GetBounds(), ray.Origin, ray.Dir, tmin, tmax))
+			return CoreLib::Graphics::RayBBoxIntersection(box, ray.Origin, ray.Dir, tmin, tmax) &&
+				tmax >= 0.0f && tmin * dirLength <= curHitPoint.Distance;
+		};
+		VisitObjects(channels, rayBoxTest, [&](PhysicsObject * obj)
+		{
+			if (!rayBoxTest(obj->GetBounds()))
+				return;
+			// inverse transform ray
+			VectorMath::Vec3 objOrigin, objDir;
+			objOrigin = obj->GetInverseModelTransform().TransformHomogeneous(ray.Origin);
+			objDir = obj->GetInverseModelTransform().TransformNormal(ray.Dir);
+			float distScale = objDir.Length();
+			objDir *= 1.0f / distScale;
+			// distances along the ray scale uniformly under the affine transform
+			float objMaxDist = curHitPoint.Distance / dirLength * distScale;
+			// perform object space ray casting
+			if (anyHit)
+			{
+				if (obj->GetModel()->TraceRayAny(objOrigin, objDir, 0.0f, objMaxDist))
+					rs.Object = obj;
+				return;
+			}
+			auto hit = obj->GetModel()->TraceRay(objOrigin, objDir, 0.0f, objMaxDist);
+			if (hit.IsHit)
 			{
-				if (tmax < maxDist)
+				hit.Position = obj->GetModelTransform().TransformHomogeneous(hit.Position);
+				hit.Distance = (ray.Origin - hit.Position).Length();
+
+				if (hit.Distance < curHitPoint.Distance && hit.FaceId != -1)
 				{
-					// inverse transform ray
-					VectorMath::Vec3 objOrigin, objDir;
-					objOrigin = obj->GetInverseModelTransform().TransformHomogeneous(ray.Origin);
-					objDir = obj->GetInverseModelTransform().TransformNormal(ray.Dir);
-					float distScale = objDir.Length();
-					objDir *= 1.0f / distScale;
-					// perform object space ray casting
-					auto hit = obj->GetModel()->TraceRay(objOrigin, objDir, 0.0f, 1e30f);
-                    if (hit.IsHit)
-                    {
-                        hit.Position = obj->GetModelTransform().TransformHomogeneous(hit.Position);
-                        hit.Distance = (ray.Origin - hit.Position).Length();
-
-                        if (hit.Distance < curHitPoint.Distance && hit.FaceId != -1)
-                        {
-                            curHitPoint = hit;
-                            rs.Object = obj.Ptr();
-                        }
-                    }
+					curHitPoint = hit;
+					rs.Object = obj;
 				}
 			}
-		}
-		if (rs.Object)
+		}, includeMovedObjects);
+		if (rs.Object && !anyHit)
 		{
 			rs.Object->GetInverseModelTransform().TransposeTransformNormal(rs.Normal, curHitPoint.GetNormal());
+			rs.Position = curHitPoint.Position;
 			rs.Distance = curHitPoint.Distance;
 		}
 		return rs;
 	}
 
+	TraceResult PhysicsScene::RayTraceFirst(const Ray & ray, PhysicsChannels channels, float maxDist)
+	{
+		return TraceRay(ray, channels, maxDist, false, true);
+	}
+
+	void PhysicsScene::RayTraceBatch(CoreLib::ArrayView<RayTraceQuery> queries, CoreLib::ArrayView<TraceResult> results)
+	{
+		UpdateBroadphase();
+		int count = queries.Count();
+		if (count == 0)
+			return;
+		// sort key: direction octant, then the morton code of the origin within the bounds of all origins
+		CoreLib::Graphics::BBox originBounds;
+		originBounds.Init();
+		for (int i = 0; i < count; i++)
+			originBounds.Union(queries[i].TraceRay.Origin);
+		auto extent = originBounds.Max - originBounds.Min;
+		// 9 bits per axis, so that the octant and the morton code fit in the upper 32 bits of the key
+		auto scale = Vec3::Create(extent.x > 0.0f ? 511.0f / extent.x : 0.0f, extent.y > 0.0f ? 511.0f / extent.y : 0.0f,
+			extent.z > 0.0f ? 511.0f / extent.z : 0.0f);
+		auto spreadBits = [](uint64_t x)
+		{
+			x = (x | (x << 16)) & 0x030000FF;
+			x = (x | (x << 8)) & 0x0300F00F;
+			x = (x | (x << 4)) & 0x030C30C3;
+			x = (x | (x << 2)) & 0x09249249;
+			return x;
+		};
+		CoreLib::List<uint64_t> sortedQueries;
+		sortedQueries.SetSize(count);
+		for (int i = 0; i < count; i++)
+		{
+			auto & ray = queries[i].TraceRay;
+			uint64_t octant = (ray.Dir.x < 0.0f ? 1 : 0) | (ray.Dir.y < 0.0f ? 2 : 0) | (ray.Dir.z < 0.0f ? 4 : 0);
+			auto p = (ray.Origin - originBounds.Min) * scale;
+			uint64_t morton = spreadBits((uint64_t)p.x) | (spreadBits((uint64_t)p.y) << 1) | (spreadBits((uint64_t)p.z) << 2);
+			sortedQueries[i] = (((octant << 27) | morton) << 32) | (uint64_t)i;
+		}
+		sortedQueries.Sort();
+		// the tree is up to date and does not change during the batch, so workers skip the moved object list
+		CoreLib::Threading::ParallelFor(0, count, 64, [&](int i)
+		{
+			int queryId = (int)(sortedQueries[i] & 0xFFFFFFFF);
+			auto & query = queries[queryId];
+			results[queryId] = TraceRay(query.TraceRay, query.Channels, query.MaxDistance, query.AnyHit, false);
+		});
+	}
+
+	void PhysicsScene::QueryBox(const CoreLib::Graphics::BBox & box, CoreLib::List<PhysicsObject*> & result, PhysicsChannels channels)
+	{
+		auto boxTest = [&](const CoreLib::Graphics::BBox & bounds)
+		{
+			return box.xMin <= bounds.xMax && box.yMin <= bounds.yMax && box.zMin <= bounds.zMax &&
+				box.xMax >= bounds.xMin && box.yMax >= bounds.yMin && box.zMax >= bounds.zMin;
+		};
+		QueryObjects(channels, boxTest, [&](PhysicsObject * obj)
+		{
+			if (boxTest(obj->GetBounds()))
+				result.Add(obj);
+		});
+	}
+
+	void PhysicsScene::QuerySphere(VectorMath::Vec3 center, float radius, CoreLib::List<PhysicsObject*> & result, PhysicsChannels channels)
+	{
+		auto sphereTest = [&](const CoreLib::Graphics::BBox & bounds)
+		{
+			Vec3 closest = Vec3::Create(Math::Clamp(center.x, bounds.xMin, bounds.xMax),
+				Math::Clamp(center.y, bounds.yMin, bounds.yMax),
+				Math::Clamp(center.z, bounds.zMin, bounds.zMax));
+			return (closest - center).Length2() <= radius * radius;
+		};
+		QueryObjects(channels, sphereTest, [&](PhysicsObject * obj)
+		{
+			if (sphereTest(obj->GetBounds()))
+				result.Add(obj);
+		});
+	}
+
 	PhysicsModelBuilder::PhysicsModelBuilder()
 	{
 		model = new PhysicsModel();
@@ -167,13 +448,34 @@ namespace GameEngine
 		f.K_gamma_v = -c[u] * divisor;
 		f.K_gamma_d = (c[u] * A[v] - c[v] * A[u]) * divisor;
 		f.PackedNormal = PackNormal(face.Normal);
-		model->faces.Add(f);
+		faces.Add(f);
+		CoreLib::Graphics::BBox box;
+		box.Init();
 		for (int i = 0; i < 3; i++)
-			model->bounds.Union(face.Vertices[i]);
+			box.Union(face.Vertices[i]);
+		faceBounds.Add(box);
+		model->bounds.Union(box);
 	}
 
 	CoreLib::RefPtr<PhysicsModel> PhysicsModelBuilder::GetModel()
 	{
+		if (faces.Count())
+		{
+			Bvh_Build<PhysicsModel::MeshFace> bvhBuild;
+			PhysicsModelBvhEvaluator costEvaluator;
+			CoreLib::List<BuildData<PhysicsModel::MeshFace>> elements;
+			elements.SetSize(faces.Count());
+			for (int i = 0; i < faces.Count(); i++)
+			{
+				elements[i].Bounds = faceBounds[i];
+				elements[i].Element = faces.Buffer() + i;
+				elements[i].Center = (faceBounds[i].Min + faceBounds[i].Max) * 0.5f;
+			}
+			ConstructBvh(bvhBuild, elements.Buffer(), elements.Count(), costEvaluator);
+			model->faceBvh.FromBuild(bvhBuild);
+		}
+		faces = CoreLib::List<PhysicsModel::MeshFace>();
+		faceBounds = CoreLib::List<CoreLib::Graphics::BBox>();
 		auto rs = model;
 		model = nullptr;
 		return rs;
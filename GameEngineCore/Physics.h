@@ -4,6 +4,9 @@
 #include "CoreLib/Basic.h"
 #include "CoreLib/VectorMath.h"
 #include "CoreLib/Graphics/BBox.h"
+#include "CoreLib/Threading.h"
+#include "DynamicBvh.h"
+#include "Bvh.h"
 #include "Ray.h"
 
 namespace GameEngine
@@ -38,24 +41,29 @@ namespace GameEngine
 		};
 	private:
 		CoreLib::Graphics::BBox bounds;
-		CoreLib::List<MeshFace> faces;
+		// faces are stored in the leaf order of the bvh, built once when the model is created
+		Bvh<MeshFace> faceBvh;
 		friend class PhysicsModelBuilder;
 	public:
 		int GetFaceCount()
 		{
-			return faces.Count();
+			return faceBvh.Elements.Count();
 		}
 		CoreLib::Graphics::BBox GetBounds()
 		{
 			return bounds;
 		}
 		HitPoint TraceRay(VectorMath::Vec3 origin, VectorMath::Vec3 dir, float tmin, float tmax);
+		// returns true as soon as any face is hit within [tmin, tmax]
+		bool TraceRayAny(VectorMath::Vec3 origin, VectorMath::Vec3 dir, float tmin, float tmax);
 	};
 
 	class PhysicsModelBuilder
 	{
 	private:
 		CoreLib::RefPtr<PhysicsModel> model;
+		CoreLib::List<PhysicsModel::MeshFace> faces;
+		CoreLib::List<CoreLib::Graphics::BBox> faceBounds;
 	public:
 		PhysicsModelBuilder();
 		void AddFace(const PhysicsModelFace & face);
@@ -79,6 +87,8 @@ namespace GameEngine
     };
    
 
+	class PhysicsScene;
+
 	class PhysicsObject : public CoreLib::RefObject
 	{
 	private:
@@ -86,6 +96,16 @@ namespace GameEngine
 		VectorMath::Matrix4 modelTransform, inverseModelTransform;
 		CoreLib::Graphics::BBox bounds;
 		bool modelTransformChanged = false;
+		PhysicsScene * scene = nullptr;
+		int proxyId = -1;
+		// a compound object has no model of its own and is made of parts that are not in the scene.
+		// the parts form a fixed hierarchy stored in depth-first order: partOrder[i] is a part, its descendants follow it
+		// up to partSubtreeEnd[i], and partBounds[i] holds the bounds of the part and all of its descendants.
+		CoreLib::List<CoreLib::RefPtr<PhysicsObject>> parts;
+		CoreLib::List<int> partOrder, partSubtreeEnd;
+		CoreLib::List<CoreLib::Graphics::BBox> partBounds;
+		void MarkModelTransformChanged();
+		friend class PhysicsScene;
 	public:
 		void * Tag = nullptr;
 		Actor * ParentActor = nullptr;
@@ -103,17 +123,7 @@ namespace GameEngine
 		{
 			return modelTransform;
 		}
-		void SetModelTransform(const VectorMath::Matrix4 & m)
-		{
-			modelTransform = m;
-			m.Inverse(inverseModelTransform);
-			modelTransformChanged = true;
-			CoreLib::Graphics::BBox nullBox;
-			nullBox.Init();
-			bounds.Init();
-			if (nullBox != model->GetBounds())
-				CoreLib::Graphics::TransformBBox(bounds, m, model->GetBounds());
-		}
+		void SetModelTransform(const VectorMath::Matrix4 & m);
 		PhysicsObject(PhysicsModel * physModel)
 		{
 			model = physModel;
@@ -121,6 +131,41 @@ namespace GameEngine
 			VectorMath::Matrix4::CreateIdentityMatrix(identity);
 			SetModelTransform(identity);
 		}
+		// creates a compound object, partParents[i] is the index of the parent of part i or -1
+		PhysicsObject(CoreLib::ArrayView<PhysicsObject*> pParts, CoreLib::ArrayView<int> pPartParents);
+		bool IsCompound()
+		{
+			return parts.Count() != 0;
+		}
+		int GetPartCount()
+		{
+			return parts.Count();
+		}
+		PhysicsObject * GetPart(int i)
+		{
+			return parts[i].Ptr();
+		}
+		// recomputes the bounds of the part hierarchy bottom-up after parts moved,
+		// only the bounds of the whole object reach the scene
+		void RefitParts();
+		// calls f(part) for every part whose bounds pass boxTest, skipping subtrees whose bounds fail it
+		template<typename BoxTest, typename Func>
+		void VisitParts(const BoxTest & boxTest, const Func & f)
+		{
+			int i = 0;
+			while (i < partOrder.Count())
+			{
+				if (!boxTest(partBounds[i]))
+				{
+					i = partSubtreeEnd[i];
+					continue;
+				}
+				auto part = parts[partOrder[i]].Ptr();
+				if (boxTest(part->bounds))
+					f(part);
+				i++;
+			}
+		}
 		CoreLib::Graphics::BBox GetBounds()
 		{
 			return bounds;
@@ -147,15 +192,77 @@ namespace GameEngine
 		PhysicsObject * Object = nullptr;
 	};
 
+	struct RayTraceQuery
+	{
+		Ray TraceRay;
+		float MaxDistance = 1e30f;
+		PhysicsChannels Channels = PhysicsChannels::All;
+		// stop at the first hit found instead of the closest one, only TraceResult::Object is set
+		bool AnyHit = false;
+	};
+
+	// objects are kept in a dynamic bvh that is updated for objects whose model transform changed.
+	// objects that moved since the last update are tested in addition to the tree, so queries always see current bounds.
 	class PhysicsScene : public CoreLib::RefObject
 	{
 	private:
 		CoreLib::EnumerableHashSet<CoreLib::RefPtr<PhysicsObject>> objects;
+		DynamicBvh<PhysicsObject*> objectTree;
+		// objects with the model transform dirty bit set, appended from parallel actor ticks
+		CoreLib::List<PhysicsObject*> movedObjects;
+		CoreLib::Threading::SpinLock movedObjectsLock;
+		void ObjectMoved(PhysicsObject * obj);
+		void UpdateObjectProxy(PhysicsObject * obj);
+		template<typename BoxTest, typename Func>
+		void VisitObjects(PhysicsChannels channels, const BoxTest & boxTest, const Func & f, bool includeMovedObjects)
+		{
+			// compound objects are visited by part
+			auto visit = [&](PhysicsObject * obj)
+			{
+				if (obj->IsCompound())
+					obj->VisitParts(boxTest, f);
+				else
+					f(obj);
+			};
+			objectTree.Query(boxTest, [&](int, PhysicsObject * obj)
+			{
+				if (!obj->modelTransformChanged && (obj->Channels.value & channels.value) != 0)
+					visit(obj);
+			});
+			if (!includeMovedObjects)
+				return;
+			movedObjectsLock.Lock();
+			for (auto obj : movedObjects)
+			{
+				if ((obj->Channels.value & channels.value) != 0 && boxTest(obj->bounds))
+					visit(obj);
+			}
+			movedObjectsLock.Unlock();
+		}
+		TraceResult TraceRay(const Ray & ray, PhysicsChannels channels, float maxDist, bool anyHit, bool includeMovedObjects);
+		friend class PhysicsObject;
 	public:
+		~PhysicsScene();
 		void AddObject(PhysicsObject * obj);
 		void RemoveObject(PhysicsObject * obj);
+		// applies pending transform changes to the tree
+		void UpdateBroadphase();
 		void Tick();
+		// calls f(obj) for every object in channels whose bounds may pass boxTest, compound objects report their parts.
+		// boxTest is also applied to tree nodes, so it must accept any box that contains an accepted box.
+		template<typename BoxTest, typename Func>
+		void QueryObjects(PhysicsChannels channels, const BoxTest & boxTest, const Func & f)
+		{
+			VisitObjects(channels, boxTest, f, true);
+		}
 		TraceResult RayTraceFirst(const Ray & ray, PhysicsChannels channels = PhysicsChannels::All, float maxDist = 1e30f);
+		// traces the rays in parallel on the worker threads, results[i] receives the result of queries[i].
+		// rays are sorted by direction and origin so that neighboring rays of a worker walk the same nodes.
+		// applies pending transform changes first, so objects must not move while the batch runs.
+		void RayTraceBatch(CoreLib::ArrayView<RayTraceQuery> queries, CoreLib::ArrayView<TraceResult> results);
+		// objects whose bounds overlap the box or the sphere
+		void QueryBox(const CoreLib::Graphics::BBox & box, CoreLib::List<PhysicsObject*> & result, PhysicsChannels channels = PhysicsChannels::All);
+		void QuerySphere(VectorMath::Vec3 center, float radius, CoreLib::List<PhysicsObject*> & result, PhysicsChannels channels = PhysicsChannels::All);
 	};
 }
 
@@ -5,9 +5,12 @@
 #include "ShaderCompiler.h"
 #include "EngineLimits.h"
 #include "Renderer.h"
+#include "RenderContext.h"
+#include "CoreLib/Tokenizer.h"
 
 using namespace CoreLib;
 using namespace CoreLib::IO;
+using namespace CoreLib::Diagnostics;
 
 namespace GameEngine
 {
@@ -54,6 +57,52 @@ namespace GameEngine
 		return rs;
 	}
 
+	PipelineContext::~PipelineContext()
+	{
+		if (compileThreadStarted)
+		{
+			{
+				std::lock_guard<std::mutex> lock(compileQueueMutex);
+				compileThreadExit = true;
+			}
+			compileQueueCondition.notify_all();
+			compileThread.Join();
+		}
+	}
+
+	void PipelineContext::CompileThreadMain()
+	{
+		std::unique_lock<std::mutex> lock(compileQueueMutex);
+		while (true)
+		{
+			compileQueueCondition.wait(lock, [this]() { return compileQueue.Count() != 0 || compileThreadExit; });
+			if (compileThreadExit)
+				break;
+			RefPtr<PendingPipeline> pending = compileQueue.First();
+			compileQueue.RemoveAt(0);
+			lock.unlock();
+			CompilePendingPipeline(pending.Ptr());
+			lock.lock();
+			pending->done = true;
+			compileDoneCondition.notify_all();
+		}
+	}
+
+	void PipelineContext::CompilePendingPipeline(PendingPipeline * pending)
+	{
+		auto startTime = PerformanceCounter::Start();
+		try
+		{
+			pending->succeeded = Engine::GetShaderCompiler()->CompileShader(pending->compileResult, pending->entryPoints.GetArrayView(), &pending->env);
+		}
+		catch (const Exception & e)
+		{
+			Print("Error compiling pipeline.\n%S\n", e.Message.ToWString());
+			pending->succeeded = false;
+		}
+		pending->compileTime = PerformanceCounter::EndSeconds(startTime);
+	}
+
 	PipelineClass * PipelineContext::GetPipelineInternal(MeshVertexFormat * vertFormat, int vtxId, PrimitiveType primType)
 	{
 		shaderKeyChanged = false;
@@ -77,43 +126,124 @@ namespace GameEngine
 			return pipeline->Ptr();
 		}
 		//lastKey = shaderKeyBuilder.Key;
+		RefPtr<PendingPipeline> pending;
+		if (pendingPipelines.TryGetValue(shaderKeyBuilder.Key, pending))
+		{
+			if (!pending->done)
+			{
+				if (asyncCompilation)
+				{
+					lastPipeline = nullptr;
+					return nullptr;
+				}
+				WaitForPipeline(pending.Ptr());
+			}
+			pendingPipelines.Remove(shaderKeyBuilder.Key);
+			lastPipeline = FinishPipeline(shaderKeyBuilder.Key, pending.Ptr());
+			return lastPipeline;
+		}
+		if (asyncCompilation)
+		{
+			// a type symbol that is not loaded yet waits for the compilation holding the shader compiler
+			auto startTime = PerformanceCounter::Start();
+			pending = NewPendingPipeline(vertFormat, primType);
+			if (renderStats)
+				renderStats->PipelineWaitTime += PerformanceCounter::EndSeconds(startTime);
+			pendingPipelines[shaderKeyBuilder.Key] = pending;
+			QueuePipeline(pending.Ptr());
+			lastPipeline = nullptr;
+			return nullptr;
+		}
 		lastPipeline = CreatePipeline(vertFormat, primType);
 		return lastPipeline;
 	}
 
+	ShaderTypeSymbol * PipelineContext::GetVertexTypeSymbol(MeshVertexFormat & vertFormat)
+	{
+		ShaderTypeSymbol * rs = nullptr;
+		if (vertexTypeSymbols.TryGetValue(vertFormat.GetTypeId(), rs))
+			return rs;
+		rs = vertFormat.GetTypeSymbol();
+		vertexTypeSymbols[vertFormat.GetTypeId()] = rs;
+		return rs;
+	}
+
+	RefPtr<PendingPipeline> PipelineContext::NewPendingPipeline(MeshVertexFormat * vertFormat, PrimitiveType primType)
+	{
+		RefPtr<PendingPipeline> pending = new PendingPipeline();
+		pending->fixedFunctionStates = fixedFunctionStates;
+		pending->fixedFunctionStates.PrimitiveTopology = primType;
+		pending->renderTargetLayout = renderTargetLayout;
+		pending->vertFormat = *vertFormat;
+		for (int i = 0; i < modulePtr; i++)
+			pending->env.SpecializationTypes.Add(modules[i]->typeSymbol);
+		pending->env.SpecializationTypes.Add(GetVertexTypeSymbol(*vertFormat));
+		pending->entryPoints.SetSize(2);
+		pending->entryPoints[0] = vertexShaderEntryPoint;
+		pending->entryPoints[1] = fragmentShaderEntryPoint;
+		return pending;
+	}
+
+	void PipelineContext::QueuePipeline(PendingPipeline * pending)
+	{
+		{
+			std::lock_guard<std::mutex> lock(compileQueueMutex);
+			compileQueue.Add(pending);
+			if (!compileThreadStarted)
+			{
+				compileThreadStarted = true;
+				compileThread.Start(new CoreLib::Threading::ThreadProc([this]() { CompileThreadMain(); }));
+			}
+		}
+		compileQueueCondition.notify_all();
+	}
+
+	void PipelineContext::WaitForPipeline(PendingPipeline * pending)
+	{
+		auto startTime = PerformanceCounter::Start();
+		std::unique_lock<std::mutex> lock(compileQueueMutex);
+		compileDoneCondition.wait(lock, [pending]() { return pending->done.load(); });
+		if (renderStats)
+			renderStats->PipelineWaitTime += PerformanceCounter::EndSeconds(startTime);
+	}
+
 	PipelineClass * PipelineContext::CreatePipeline(MeshVertexFormat * vertFormat, PrimitiveType primType)
+	{
+		auto pending = NewPendingPipeline(vertFormat, primType);
+		auto startTime = PerformanceCounter::Start();
+		pending->succeeded = Engine::GetShaderCompiler()->CompileShader(pending->compileResult, pending->entryPoints.GetArrayView(), &pending->env);
+		pending->compileTime = PerformanceCounter::EndSeconds(startTime);
+		if (renderStats)
+			renderStats->PipelineWaitTime += pending->compileTime;
+		return FinishPipeline(shaderKeyBuilder.Key, pending.Ptr());
+	}
+
+	PipelineClass * PipelineContext::FinishPipeline(ShaderKey key, PendingPipeline * pending)
+	{
+		if (renderStats)
+			renderStats->PipelineCompileTime += pending->compileTime;
+		// failed pipelines are kept as nullptr so they are not compiled again, their drawables are skipped
+		RefPtr<PipelineClass> pipelineClass;
+		if (pending->succeeded)
+			pipelineClass = CreatePipelineObjects(pending);
+		pipelineObjects[key] = pipelineClass;
+		return pipelineClass.Ptr();
+	}
+
+	RefPtr<PipelineClass> PipelineContext::CreatePipelineObjects(PendingPipeline * pending)
 	{
 		RefPtr<PipelineBuilder> pipelineBuilder = hwRenderer->CreatePipelineBuilder();
 
-		pipelineBuilder->FixedFunctionStates = fixedFunctionStates;
-        pipelineBuilder->FixedFunctionStates.PrimitiveTopology = primType;
+		pipelineBuilder->FixedFunctionStates = pending->fixedFunctionStates;
 
 		// Set vertex layout
-		pipelineBuilder->SetVertexLayout(LoadVertexFormat(*vertFormat));
+		pipelineBuilder->SetVertexLayout(LoadVertexFormat(pending->vertFormat));
 
-		// Compile shaders
-        ShaderCompilationEnvironment env;
-        for (int i = 0; i < modulePtr; i++)
-        {
-            env.SpecializationTypes.Add(modules[i]->typeSymbol);
-        }
-        env.SpecializationTypes.Add(vertFormat->GetTypeSymbol());
-        struct CompilationTask
-        {
-            ShaderEntryPoint * entryPoint;
-            ShaderType shaderType;
-        };
         RefPtr<PipelineClass> pipelineClass = new PipelineClass();
-        static int pipelineClassId = 0;
-        pipelineClassId++;
-        pipelineClass->Id = pipelineClassId;
-        Array<ShaderEntryPoint*, 2> entryPoints;
-        entryPoints.SetSize(2);
-        entryPoints[0] = vertexShaderEntryPoint;
-        entryPoints[1] = fragmentShaderEntryPoint;
+        static std::atomic<int> pipelineClassId{ 0 };
+        pipelineClass->Id = ++pipelineClassId;
 		List<RefPtr<DescriptorSetLayout>> descSetLayouts;
-        ShaderCompilationResult compileRs;
-        Engine::GetShaderCompiler()->CompileShader(compileRs, entryPoints.GetArrayView(), &env);
+        auto & compileRs = pending->compileResult;
         auto vsObj = hwRenderer->CreateShader(ShaderType::VertexShader, compileRs.ShaderCode[0].Buffer(), compileRs.ShaderCode[0].Count());
         auto fsObj = hwRenderer->CreateShader(ShaderType::FragmentShader, compileRs.ShaderCode[1].Buffer(), compileRs.ShaderCode[1].Count());
         pipelineClass->shaders.Add(vsObj);
@@ -133,9 +263,165 @@ namespace GameEngine
         }
 		pipelineBuilder->SetShaders(From(pipelineClass->shaders).Select([](const RefPtr<Shader>& s) {return s.Ptr(); }).ToList().GetArrayView());
 		pipelineBuilder->SetBindingLayout(From(descSetLayouts).Select([](auto x) {return x.Ptr(); }).ToList().GetArrayView());
-		pipelineClass->pipeline = pipelineBuilder->ToPipeline(renderTargetLayout);
-		pipelineObjects[shaderKeyBuilder.Key] = pipelineClass;
-		return pipelineClass.Ptr();
+		pipelineClass->pipeline = pipelineBuilder->ToPipeline(pending->renderTargetLayout);
+		return pipelineClass;
+	}
+
+	void PipelineContext::RegisterRenderPass(ShaderEntryPoint * pVS, ShaderEntryPoint * pFS, RenderTargetLayout * pRenderTargetLayout, const FixedFunctionPipelineStates & states)
+	{
+		if (renderPasses.ContainsKey(pFS->Id))
+			return;
+		RenderPassBinding binding;
+		binding.VertexShader = pVS;
+		binding.Layout = pRenderTargetLayout;
+		binding.FixedFunctionStates = states;
+		renderPasses[pFS->Id] = binding;
+	}
+
+	void PipelineContext::RecordPipelineUse(PipelineClass * pipeline)
+	{
+		pipeline->Used = true;
+		PipelineManifestEntry entry;
+		entry.ShaderFileName = fragmentShaderEntryPoint->FileName;
+		entry.FunctionName = fragmentShaderEntryPoint->FunctionName;
+		for (int i = 0; i < modulePtr; i++)
+		{
+			entry.ModuleFileNames.Add(modules[i]->typeSymbol->FileName);
+			entry.ModuleTypeNames.Add(modules[i]->typeSymbol->TypeName);
+		}
+		entry.VertexTypeId = (int)lastVtxId;
+		entry.PrimType = lastPrimType;
+		entry.Cull = fixedFunctionStates.cullMode;
+		usedPipelines.Add(_Move(entry));
+	}
+
+	void PipelineContext::ClearPipelineUsage()
+	{
+		usedPipelines.Clear();
+		for (auto & pipeline : pipelineObjects)
+		{
+			if (pipeline.Value)
+				pipeline.Value->Used = false;
+		}
+	}
+
+	void PipelineContext::SavePipelineManifest(const String & fileName)
+	{
+		if (fileName.Length() == 0 || usedPipelines.Count() == 0)
+			return;
+		StringBuilder sb;
+		for (auto & entry : usedPipelines)
+		{
+			sb << "pipeline " << Text::EscapeStringLiteral(entry.ShaderFileName) << " " << Text::EscapeStringLiteral(entry.FunctionName)
+				<< " " << entry.VertexTypeId << " " << (int)entry.PrimType << " " << (int)entry.Cull << "\n{\n";
+			for (int i = 0; i < entry.ModuleFileNames.Count(); i++)
+				sb << "\t" << Text::EscapeStringLiteral(entry.ModuleFileNames[i]) << " " << Text::EscapeStringLiteral(entry.ModuleTypeNames[i]) << "\n";
+			sb << "}\n";
+		}
+		try
+		{
+			File::WriteAllText(fileName, sb.ProduceString());
+		}
+		catch (const IOException &)
+		{
+			Print("cannot write pipeline manifest '%S'.\n", fileName.ToWString());
+		}
+	}
+
+	int PipelineContext::WarmUpPipelines(const String & fileName)
+	{
+		List<PipelineManifestEntry> entries;
+		try
+		{
+			Text::TokenReader parser(File::ReadAllText(fileName));
+			while (!parser.IsEnd())
+			{
+				PipelineManifestEntry entry;
+				parser.Read("pipeline");
+				entry.ShaderFileName = parser.ReadStringLiteral();
+				entry.FunctionName = parser.ReadStringLiteral();
+				entry.VertexTypeId = parser.ReadInt();
+				entry.PrimType = (PrimitiveType)parser.ReadInt();
+				entry.Cull = (CullMode)parser.ReadInt();
+				parser.Read("{");
+				while (!parser.LookAhead("}"))
+				{
+					entry.ModuleFileNames.Add(parser.ReadStringLiteral());
+					entry.ModuleTypeNames.Add(parser.ReadStringLiteral());
+				}
+				parser.Read("}");
+				entries.Add(_Move(entry));
+			}
+		}
+		catch (const Exception &)
+		{
+			Print("ignoring invalid pipeline manifest '%S'.\n", fileName.ToWString());
+			return 0;
+		}
+
+		// resolve names and keys on this thread, the shader compiler assigns type ids as symbols are loaded
+		auto compiler = Engine::GetShaderCompiler();
+		List<ShaderKey> keys;
+		List<RefPtr<PendingPipeline>> pendings;
+		for (auto & entry : entries)
+		{
+			auto fs = compiler->LoadShaderEntryPoint(entry.ShaderFileName, entry.FunctionName);
+			RenderPassBinding pass;
+			if (!fs || !renderPasses.TryGetValue(fs->Id, pass))
+				continue;
+			RefPtr<PendingPipeline> pending = new PendingPipeline();
+			ShaderKeyBuilder keyBuilder;
+			keyBuilder.Clear();
+			keyBuilder.Append(fs->Id);
+			keyBuilder.FlipLeadingByte((unsigned int)entry.VertexTypeId);
+			bool resolved = true;
+			for (int i = 0; i < entry.ModuleFileNames.Count(); i++)
+			{
+				auto typeSymbol = compiler->LoadTypeSymbol(entry.ModuleFileNames[i], entry.ModuleTypeNames[i]);
+				if (!typeSymbol)
+				{
+					resolved = false;
+					break;
+				}
+				keyBuilder.Append(typeSymbol->TypeId);
+				pending->env.SpecializationTypes.Add(typeSymbol);
+			}
+			keyBuilder.Append((unsigned int)entry.PrimType);
+			if (!resolved || pipelineObjects.ContainsKey(keyBuilder.Key) || pendingPipelines.ContainsKey(keyBuilder.Key)
+				|| keys.Contains(keyBuilder.Key))
+				continue;
+			pending->vertFormat = MeshVertexFormat(entry.VertexTypeId);
+			pending->env.SpecializationTypes.Add(GetVertexTypeSymbol(pending->vertFormat));
+			pending->fixedFunctionStates = pass.FixedFunctionStates;
+			pending->fixedFunctionStates.cullMode = entry.Cull;
+			pending->fixedFunctionStates.PrimitiveTopology = entry.PrimType;
+			pending->renderTargetLayout = pass.Layout.Ptr();
+			pending->entryPoints.SetSize(2);
+			pending->entryPoints[0] = pass.VertexShader;
+			pending->entryPoints[1] = fs;
+			// vertex formats are cached here, so that workers only read the cache
+			LoadVertexFormat(pending->vertFormat);
+			keys.Add(keyBuilder.Key);
+			pendings.Add(pending);
+		}
+
+		// shader compilation is serialized by the shader compiler, creating the shaders and pipeline objects is not
+		List<RefPtr<PipelineClass>> pipelines;
+		pipelines.SetSize(pendings.Count());
+		CoreLib::Threading::ParallelFor(0, pendings.Count(), 1, [&](int i)
+		{
+			CompilePendingPipeline(pendings[i].Ptr());
+			if (pendings[i]->succeeded)
+				pipelines[i] = CreatePipelineObjects(pendings[i].Ptr());
+		});
+		int createdCount = 0;
+		for (int i = 0; i < keys.Count(); i++)
+		{
+			pipelineObjects[keys[i]] = pipelines[i];
+			if (pipelines[i])
+				createdCount++;
+		}
+		return createdCount;
 	}
 
 	void ModuleInstance::SetUniformData(void * data, int length, int dstOffset)
@@ -155,14 +441,30 @@ namespace GameEngine
 
 	//IMPL_POOL_ALLOCATOR(ModuleInstance, MaxModuleInstances)
 
+	static std::atomic<int> descriptorSetEpoch{ 0 };
+
+	int GetDescriptorSetEpoch()
+	{
+		return descriptorSetEpoch.load();
+	}
+
+	void AdvanceDescriptorSetEpoch()
+	{
+		descriptorSetEpoch++;
+	}
+
 	ModuleInstance::~ModuleInstance()
 	{
+		if (descriptors.Count())
+			AdvanceDescriptorSetEpoch();
 		if (UniformMemory)
 			UniformMemory->Free((char*)UniformMemory->BufferPtr() + BufferOffset, BufferLength * DynamicBufferLengthMultiplier);
 	}
 
 	void ModuleInstance::SetDescriptorSetLayout(HardwareRenderer * hw, DescriptorSetLayout * layout)
 	{
+		if (descriptors.Count())
+			AdvanceDescriptorSetEpoch();
 		descriptors.Clear();
         descLayout = layout;
         if (layout)
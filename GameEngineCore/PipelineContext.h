@@ -6,6 +6,9 @@
 #include "DeviceMemory.h"
 #include "EngineLimits.h"
 #include "Mesh.h"
+#include "CoreLib/Threading.h"
+#include <atomic>
+#include <condition_variable>
 
 namespace GameEngine
 {
@@ -100,10 +103,17 @@ namespace GameEngine
 
 	using DescriptorSetBindingArray = CoreLib::Array<DescriptorSet*, 32>;
 
+	// advanced whenever descriptor sets of module instances are released or rewritten. recorded command buffers refer
+	// to descriptor sets by handle, so they are only reused within the epoch they were recorded in.
+	int GetDescriptorSetEpoch();
+	void AdvanceDescriptorSetEpoch();
+
 	class PipelineClass
 	{
 	public:
 		int Id = 0;
+		// set once the pipeline is recorded in the manifest of the current level
+		bool Used = false;
 		CoreLib::List<CoreLib::RefPtr<Shader>> shaders;
 		CoreLib::RefPtr<Pipeline> pipeline;
 		CoreLib::List<CoreLib::RefPtr<DescriptorSetLayout>> descriptorSetLayouts;
@@ -111,9 +121,44 @@ namespace GameEngine
 
 	class RenderStat;
 
+	// shader compilation state of a pipeline that is compiled on the compile thread of a PipelineContext.
+	// everything except compileResult, succeeded and compileTime is set before the task is queued.
+	class PendingPipeline : public CoreLib::RefObject
+	{
+	public:
+		ShaderCompilationEnvironment env;
+		CoreLib::Array<ShaderEntryPoint*, 2> entryPoints;
+		FixedFunctionPipelineStates fixedFunctionStates;
+		RenderTargetLayout * renderTargetLayout = nullptr;
+		MeshVertexFormat vertFormat;
+		ShaderCompilationResult compileResult;
+		bool succeeded = false;
+		float compileTime = 0.0f;
+		std::atomic<bool> done{ false };
+	};
+
+	// a pipeline used by a level, stored in the pipeline manifest next to the level file. type ids differ between
+	// sessions, so shaders and modules are referred to by name. the fragment shader identifies the world render pass,
+	// which provides the vertex shader, render target layout and the remaining fixed function states.
+	class PipelineManifestEntry
+	{
+	public:
+		CoreLib::String ShaderFileName, FunctionName;
+		CoreLib::List<CoreLib::String> ModuleFileNames, ModuleTypeNames;
+		int VertexTypeId = 0;
+		PrimitiveType PrimType = PrimitiveType::Triangles;
+		CullMode Cull = CullMode::CullBackFace;
+	};
+
 	class PipelineContext
 	{
 	private:
+		struct RenderPassBinding
+		{
+			ShaderEntryPoint * VertexShader = nullptr;
+			CoreLib::RefPtr<RenderTargetLayout> Layout;
+			FixedFunctionPipelineStates FixedFunctionStates;
+		};
 		int modulePtr = 0;
 		ShaderKey lastKey; 
 		unsigned int lastVtxId = 0;
@@ -129,10 +174,37 @@ namespace GameEngine
 		HardwareRenderer * hwRenderer;
 		RenderStat * renderStats = nullptr;
 		CoreLib::Dictionary<int, VertexFormat> vertexFormats;
+		// vertex format type symbols by vertex type id, so that queuing a pipeline does not go through the shader compiler
+		CoreLib::Dictionary<int, ShaderTypeSymbol*> vertexTypeSymbols;
+		ShaderTypeSymbol * GetVertexTypeSymbol(MeshVertexFormat & vertFormat);
+		// world render passes by fragment shader id, and the pipelines used since ClearPipelineUsage
+		CoreLib::Dictionary<int, RenderPassBinding> renderPasses;
+		CoreLib::List<PipelineManifestEntry> usedPipelines;
+		// pipelines being compiled in the background, only accessed by the thread that owns this context
+		bool asyncCompilation = false;
+		CoreLib::EnumerableDictionary<ShaderKey, CoreLib::RefPtr<PendingPipeline>> pendingPipelines;
+		// compile thread state, guarded by compileQueueMutex
+		CoreLib::Threading::Thread compileThread;
+		std::mutex compileQueueMutex;
+		std::condition_variable compileQueueCondition, compileDoneCondition;
+		CoreLib::List<CoreLib::RefPtr<PendingPipeline>> compileQueue;
+		bool compileThreadStarted = false;
+		bool compileThreadExit = false;
+		void CompileThreadMain();
+		static void CompilePendingPipeline(PendingPipeline * pending);
+		void RecordPipelineUse(PipelineClass * pipeline);
 		PipelineClass * GetPipelineInternal(MeshVertexFormat * vertFormat, int vtxId, PrimitiveType primType);
-		PipelineClass* CreatePipeline(MeshVertexFormat * vertFormat, PrimitiveType primType);
+		PipelineClass * CreatePipeline(MeshVertexFormat * vertFormat, PrimitiveType primType);
+		CoreLib::RefPtr<PendingPipeline> NewPendingPipeline(MeshVertexFormat * vertFormat, PrimitiveType primType);
+		void QueuePipeline(PendingPipeline * pending);
+		void WaitForPipeline(PendingPipeline * pending);
+		PipelineClass * FinishPipeline(ShaderKey key, PendingPipeline * pending);
+		// creates the shaders, layouts and the pipeline object of a compiled pipeline. may run on any thread
+		// once the vertex format of the pipeline has been loaded.
+		CoreLib::RefPtr<PipelineClass> CreatePipelineObjects(PendingPipeline * pending);
 	public:
 		PipelineContext() = default;
+		~PipelineContext();
 		void Init(HardwareRenderer * hw, RenderStat * pRenderStats)
 		{
 			hwRenderer = hw;
@@ -143,6 +215,20 @@ namespace GameEngine
 			return renderStats;
 		}
 		VertexFormat LoadVertexFormat(MeshVertexFormat vertFormat);
+		// when enabled, pipelines that are not created yet are compiled on a background thread and GetPipeline
+		// returns nullptr until they are ready. when disabled, GetPipeline waits for pending compilations.
+		void SetAsyncCompilation(bool enable)
+		{
+			asyncCompilation = enable;
+		}
+		// called by world render passes on creation, so that pipelines in a manifest can be created for them
+		void RegisterRenderPass(ShaderEntryPoint * pVS, ShaderEntryPoint * pFS, RenderTargetLayout * pRenderTargetLayout, const FixedFunctionPipelineStates & states);
+		// starts recording the pipelines used for a new level
+		void ClearPipelineUsage();
+		// writes the pipelines used since ClearPipelineUsage, nothing is written if no pipeline has been used or fileName is empty
+		void SavePipelineManifest(const CoreLib::String & fileName);
+		// creates the pipelines listed in a manifest in parallel, returns the number of pipelines created
+		int WarmUpPipelines(const CoreLib::String & fileName);
 		void BindEntryPoint(ShaderEntryPoint * pVS, ShaderEntryPoint * pFS, RenderTargetLayout * pRenderTargetLayout, FixedFunctionPipelineStates * states)
 		{
 			vertexShaderEntryPoint = pVS;
@@ -188,9 +274,12 @@ namespace GameEngine
 		inline PipelineClass* GetPipeline(MeshVertexFormat * vertFormat, PrimitiveType primType)
 		{
 			unsigned int vtxId = (unsigned int)vertFormat->GetTypeId();
-			if (!shaderKeyChanged && vtxId == lastVtxId && primType == lastPrimType)
+			if (!shaderKeyChanged && vtxId == lastVtxId && primType == lastPrimType && lastPipeline)
 				return lastPipeline;
-			return GetPipelineInternal(vertFormat, vtxId, primType);
+			auto pipeline = GetPipelineInternal(vertFormat, vtxId, primType);
+			if (pipeline && !pipeline->Used)
+				RecordPipelineUse(pipeline);
+			return pipeline;
 		}
 	};
 }
@@ -9,6 +9,25 @@ using namespace VectorMath;
 
 namespace GameEngine
 {
+    // explicit 32-bit lane arithmetic, gcc and clang treat __m128i operators as 64-bit lane operations
+    inline __m128i Add(__m128i a, __m128i b)
+    {
+        return _mm_add_epi32(a, b);
+    }
+    inline __m128i Sub(__m128i a, __m128i b)
+    {
+        return _mm_sub_epi32(a, b);
+    }
+    inline __m128i Mul(__m128i a, __m128i b)
+    {
+        return _mm_mullo_epi32(a, b);
+    }
+    // evaluates a * (x - x0) + b * (y - y0)
+    inline __m128i EdgeFunction(__m128i a, __m128i b, __m128i x, __m128i x0, __m128i y, __m128i y0)
+    {
+        return Add(Mul(a, Sub(x, x0)), Mul(b, Sub(y, y0)));
+    }
+
     inline int GetOutCode(__m128i e0, __m128i e1, __m128i e2)
     {
         int sign0 = _mm_movemask_epi8(e0);
@@ -44,9 +63,9 @@ namespace GameEngine
 
         inline bool TouchesBlock(__m128i x, __m128i y)
         {
-            auto e0 = a0 * (x - x0) + b0 * (y - y0);
-            auto e1 = a1 * (x - x1) + b1 * (y - y1);
-            auto e2 = a2 * (x - x2) + b2 * (y - y2);
+            auto e0 = EdgeFunction(a0, b0, x, x0, y, y0);
+            auto e1 = EdgeFunction(a1, b1, x, x1, y, y1);
+            auto e2 = EdgeFunction(a2, b2, x, x2, y, y2);
             int code = GetOutCode(e0, e1, e2);
             code = code & (code >> 8);
             code = code & (code >> 4);
@@ -159,32 +178,32 @@ void RasterizeTriangle( TShader& Shader, const FVector2D Points[3], int32 Scisso
             int sign0, sign1, sign2;
             if (isOwnerEdge[0])
             {
-                auto e0 = a0 * (x - x0) + b0 * (y - y0) + c0;
+                auto e0 = Add(EdgeFunction(a0, b0, x, x0, y, y0), c0);
                 sign0 = ~_mm_movemask_epi8(e0);
             }
             else
             {
-                auto e0 = a0 * (x0 - x) + b0 * (y0 - y) - c0;
+                auto e0 = Sub(EdgeFunction(a0, b0, x0, x, y0, y), c0);
                 sign0 = _mm_movemask_epi8(e0);
             }
             if (isOwnerEdge[1])
             {
-                auto e1 = a1 * (x - x1) + b1 * (y - y1) + c1;
+                auto e1 = Add(EdgeFunction(a1, b1, x, x1, y, y1), c1);
                 sign1 = ~_mm_movemask_epi8(e1);
             }
             else
             {
-                auto e1 = a1 * (x1 - x) + b1 * (y1 - y) - c1;
+                auto e1 = Sub(EdgeFunction(a1, b1, x1, x, y1, y), c1);
                 sign1 = _mm_movemask_epi8(e1);
             }
             if (isOwnerEdge[2])
             {
-                auto e2 = a2 * (x - x2) + b2 * (y - y2) + c2;
+                auto e2 = Add(EdgeFunction(a2, b2, x, x2, y, y2), c2);
                 sign2 = ~_mm_movemask_epi8(e2);
             }
             else
             {
-                auto e2 = a2 * (x2 - x) + b2 * (y2 - y) - c2;
+                auto e2 = Sub(EdgeFunction(a2, b2, x2, x, y2, y), c2);
                 sign2 = _mm_movemask_epi8(e2);
             }
             return sign0 & sign1 & sign2 & 0x8888;
@@ -239,15 +258,15 @@ void RasterizeTriangle( TShader& Shader, const FVector2D Points[3], int32 Scisso
         int tx = startTileX;
         int ty = startTileY;
         __m128i step = _mm_set_epi32(32, 64, 96, 128);
-        __m128i a0Step = triSIMD.a0*step;
-        __m128i a1Step = triSIMD.a1*step;
-        __m128i a2Step = triSIMD.a2*step;
-        __m128i b0Step = triSIMD.b0*step;
-        __m128i b1Step = triSIMD.b1*step;
-        __m128i b2Step = triSIMD.b2*step;
-        __m128i b0lineStep = triSIMD.b0*_mm_set1_epi32(32);
-        __m128i b1lineStep = triSIMD.b1*_mm_set1_epi32(32);
-        __m128i b2lineStep = triSIMD.b2*_mm_set1_epi32(32);
+        __m128i a0Step = Mul(triSIMD.a0, step);
+        __m128i a1Step = Mul(triSIMD.a1, step);
+        __m128i a2Step = Mul(triSIMD.a2, step);
+        __m128i b0Step = Mul(triSIMD.b0, step);
+        __m128i b1Step = Mul(triSIMD.b1, step);
+        __m128i b2Step = Mul(triSIMD.b2, step);
+        __m128i b0lineStep = Mul(triSIMD.b0, _mm_set1_epi32(32));
+        __m128i b1lineStep = Mul(triSIMD.b1, _mm_set1_epi32(32));
+        __m128i b2lineStep = Mul(triSIMD.b2, _mm_set1_epi32(32));
 
         int returnX = tx;
         int downX = tx;
@@ -261,9 +280,9 @@ void RasterizeTriangle( TShader& Shader, const FVector2D Points[3], int32 Scisso
             __m128i x = _mm_set_epi32(tx, tx, tx + 128, tx + 128);
             __m128i y = _mm_set_epi32(ty, ty + 128, ty + 128, ty);
 
-            auto e0 = triSIMD.a0*(x - triSIMD.x0) + triSIMD.b0*(y - triSIMD.y0);
-            auto e1 = triSIMD.a1*(x - triSIMD.x1) + triSIMD.b1*(y - triSIMD.y1);
-            auto e2 = triSIMD.a2*(x - triSIMD.x2) + triSIMD.b2*(y - triSIMD.y2);
+            auto e0 = EdgeFunction(triSIMD.a0, triSIMD.b0, x, triSIMD.x0, y, triSIMD.y0);
+            auto e1 = EdgeFunction(triSIMD.a1, triSIMD.b1, x, triSIMD.x1, y, triSIMD.y1);
+            auto e2 = EdgeFunction(triSIMD.a2, triSIMD.b2, x, triSIMD.x2, y, triSIMD.y2);
 
             int code = GetOutCode(e0, e1, e2);
 
@@ -303,26 +322,26 @@ void RasterizeTriangle( TShader& Shader, const FVector2D Points[3], int32 Scisso
                 auto e0_corner = _mm_set1_epi32(_mm_extract_epi32(e0, 3));
                 auto e1_corner = _mm_set1_epi32(_mm_extract_epi32(e1, 3));
                 auto e2_corner = _mm_set1_epi32(_mm_extract_epi32(e2, 3));
-                auto e0_line0 = e0_corner + a0Step;
-                auto e0_line1 = e0_line0 + b0lineStep;
-                auto e0_line2 = e0_line1 + b0lineStep;
-                auto e0_line3 = e0_line2 + b0lineStep;
-                auto e0_line4 = e0_line3 + b0lineStep;
-                auto e0_lastLine = e0_corner + b0Step;
-
-                auto e1_line0 = e1_corner + a1Step;
-                auto e1_line1 = e1_line0 + b1lineStep;
-                auto e1_line2 = e1_line1 + b1lineStep;
-                auto e1_line3 = e1_line2 + b1lineStep;
-                auto e1_line4 = e1_line3 + b1lineStep;
-                auto e1_lastLine = e1_corner + b1Step;
-
-                auto e2_line0 = e2_corner + a2Step;
-                auto e2_line1 = e2_line0 + b2lineStep;
-                auto e2_line2 = e2_line1 + b2lineStep;
-                auto e2_line3 = e2_line2 + b2lineStep;
-                auto e2_line4 = e2_line3 + b2lineStep;
-                auto e2_lastLine = e2_corner + b2Step;
+                auto e0_line0 = Add(e0_corner, a0Step);
+                auto e0_line1 = Add(e0_line0, b0lineStep);
+                auto e0_line2 = Add(e0_line1, b0lineStep);
+                auto e0_line3 = Add(e0_line2, b0lineStep);
+                auto e0_line4 = Add(e0_line3, b0lineStep);
+                auto e0_lastLine = Add(e0_corner, b0Step);
+
+                auto e1_line0 = Add(e1_corner, a1Step);
+                auto e1_line1 = Add(e1_line0, b1lineStep);
+                auto e1_line2 = Add(e1_line1, b1lineStep);
+                auto e1_line3 = Add(e1_line2, b1lineStep);
+                auto e1_line4 = Add(e1_line3, b1lineStep);
+                auto e1_lastLine = Add(e1_corner, b1Step);
+
+                auto e2_line0 = Add(e2_corner, a2Step);
+                auto e2_line1 = Add(e2_line0, b2lineStep);
+                auto e2_line2 = Add(e2_line1, b2lineStep);
+                auto e2_line3 = Add(e2_line2, b2lineStep);
+                auto e2_line4 = Add(e2_line3, b2lineStep);
+                auto e2_lastLine = Add(e2_corner, b2Step);
 
                 int code_line[6];
                 code_line[0] = GetOutCode(e0_line0, e1_line0, e2_line0);
@@ -508,6 +527,43 @@ void RasterizeTriangle( TShader& Shader, const FVector2D Points[3], int32 Scisso
         });
         return count;
     }
+    void Rasterizer::RasterizeDepth(DepthCanvas & canvas, ProjectedTriangle & ptri, Vec3 depthPlane, float minDepth, float maxDepth)
+    {
+        TriangleSIMD triSIMD;
+        triSIMD.Load(ptri);
+        // the plane reaches its farthest point within a pixel at one of the pixel corners
+        float cornerOffset = 0.5f * (fabs(depthPlane.x) + fabs(depthPlane.y));
+        auto writeDepth = [&](int x, int y)
+        {
+            if (x >= canvas.width || y >= canvas.height)
+                return;
+            float d = depthPlane.x * (x + 0.5f) + depthPlane.y * (y + 0.5f) + depthPlane.z + cornerOffset;
+            d = Clamp(d, minDepth, maxDepth);
+            auto & dest = canvas.depth[y * canvas.width + x];
+            if (d < dest)
+                dest = d;
+        };
+        BlockScanRasterize(0, 0, canvas.width << 4, canvas.height << 4, ptri, triSIMD, [&](int tx, int ty, bool trivialAccept)
+        {
+            int ix = (tx >> 4);
+            int iy = (ty >> 4);
+            int mask = 0xFFFF;
+            if (!trivialAccept)
+            {
+                auto coordX = _mm_set_epi32(tx + 24, tx + 8, tx + 24, tx + 8);
+                auto coordY = _mm_set_epi32(ty + 24, ty + 24, ty + 8, ty + 8);
+                mask = triSIMD.TestQuadFragment(coordX, coordY);
+            }
+            if (mask & 0x0008)
+                writeDepth(ix, iy);
+            if (mask & 0x0080)
+                writeDepth(ix + 1, iy);
+            if (mask & 0x0800)
+                writeDepth(ix, iy + 1);
+            if (mask & 0x8000)
+                writeDepth(ix + 1, iy + 1);
+        });
+    }
     void Rasterizer::Rasterize(Canvas & canvas, ProjectedTriangle & ptri)
     {
         RasterizeImpl(ptri, canvas.width, canvas.height, [&](int x, int y) 
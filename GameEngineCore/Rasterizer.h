@@ -36,12 +36,34 @@ namespace GameEngine
             return bitmap.Contains(y * width + x);
         }
     };
+    // a floating point depth buffer, smaller values are closer to the viewer
+    struct DepthCanvas
+    {
+        CoreLib::List<float> depth;
+        int width, height;
+        void Init(int w, int h)
+        {
+            width = w;
+            height = h;
+            depth.SetSize(w * h);
+        }
+        void Clear(float value)
+        {
+            for (auto & d : depth)
+                d = value;
+        }
+    };
     class Rasterizer
     {
     public:
         static bool SetupTriangle(ProjectedTriangle & tri, VectorMath::Vec2 s0, VectorMath::Vec2 s1, VectorMath::Vec2 s2, int width, int height, int dilate = 8);
         static int CountOverlap(Canvas& canvas, ProjectedTriangle & tri);
         static void Rasterize(Canvas& canvas, ProjectedTriangle & tri);
+        // keeps the minimum of the current depth and the farthest depth the triangle reaches within each pixel.
+        // depthPlane holds (a, b, c) so that depth = a * x + b * y + c in pixel units, and the written depth is
+        // clamped to [minDepth, maxDepth]. each pixel is tested at its center, a triangle set up with dilate = 0
+        // leaves no gaps along edges shared with its neighbors.
+        static void RasterizeDepth(DepthCanvas & canvas, ProjectedTriangle & tri, VectorMath::Vec3 depthPlane, float minDepth, float maxDepth);
     };
 }
 
@@ -4,10 +4,12 @@
 #include "Engine.h"
 #include "EngineLimits.h"
 #include "PostRenderPass.h"
+#include "ShaderCacheArchive.h"
 #include "TextureCompressor.h"
 #include "WorldRenderPass.h"
 #include "CoreLib/LibIO.h"
 #include "CoreLib/Graphics/TextureFile.h"
+#include "CoreLib/Threading.h"
 #include <assert.h>
 
 namespace GameEngine
@@ -88,6 +90,7 @@ namespace GameEngine
 			throw InvalidOperationException("cannot update non-static drawable with static transform data.");
 		if (!transformModule->UniformMemory)
 			throw InvalidOperationException("invalid buffer.");
+		this->localTransform = localTransform;
 		transformModule->SetUniformData((void*)&localTransform, sizeof(Matrix4), 16);
 	}
 
@@ -102,6 +105,17 @@ namespace GameEngine
 
 	void Drawable::UpdateTransformUniform(const VectorMath::Matrix4 &localTransform, const Pose &pose,
         RetargetFile *retarget, BlendShapeWeightInfo *blendShapeInfo)
+	{
+		// a static drawable has no skeleton to build the palette from
+		if (type != DrawableType::Skeletal)
+			throw InvalidOperationException("cannot update static drawable with skeletal transform data.");
+		SkinningPalette palette;
+		palette.Update(skeleton, pose, retarget);
+		UpdateTransformUniform(localTransform, palette, blendShapeInfo);
+	}
+
+	void Drawable::UpdateTransformUniform(const VectorMath::Matrix4 &localTransform, const SkinningPalette &palette,
+        BlendShapeWeightInfo *blendShapeInfo)
 	{
 		if (type != DrawableType::Skeletal)
 			throw InvalidOperationException("cannot update static drawable with skeletal transform data.");
@@ -111,17 +125,10 @@ namespace GameEngine
 		// ensure allocated transform buffer is sufficient 
 		assert(transformModule->BufferLength >= sizeof(SkeletalAnimationTransform));
 
-		List<Matrix4> matrices;
-		pose.GetMatrices(skeleton, matrices, true, retarget);
         SkeletalAnimationTransform transformData;
         transformData.worldMat = localTransform;
-        for (int i = 0; i < matrices.Count(); i++)
-        {
-            DualQuaternion dq;
-            dq.FromRotationTranslation(Quaternion::FromMatrix(matrices[i].GetMatrix3()),
-                VectorMath::Vec3::Create(matrices[i].values[12], matrices[i].values[13], matrices[i].values[14]));
-            transformData.boneTransforms[i] = dq;
-        }
+        for (int i = 0; i < palette.DualQuaternions.Count(); i++)
+            transformData.boneTransforms[i] = palette.DualQuaternions[i];
         if (blendShapeInfo)
         {
 			transformData.blendShapeCount = blendShapeInfo->Weights.Count();
@@ -399,12 +406,52 @@ namespace GameEngine
 		hardwareRenderer = hwRenderer;
 		instanceUniformMemory.Init(hwRenderer, BufferUsage::UniformBuffer, false, 24, hwRenderer->UniformBufferAlignment(), nullptr);
 		transformMemory.Init(hwRenderer, BufferUsage::UniformBuffer, false, 25, hwRenderer->UniformBufferAlignment(), nullptr);
+		int instanceTransformSize = Math::RoundUpToAlignment((int)sizeof(Matrix4) * MaxInstancesPerDraw, hwRenderer->UniformBufferAlignment());
+		instanceTransformMemory.Init(hwRenderer, BufferUsage::UniformBuffer, false,
+			Math::Log2Ceil(instanceTransformSize * DynamicBufferLengthMultiplier * MaxInstancedDrawsPerFrame), hwRenderer->UniformBufferAlignment(), nullptr);
+		// these are updated in many small pieces every frame, uniform modules alternate between DynamicBufferLengthMultiplier
+		// versions so that an update never touches the version read by the frame in flight
+		instanceUniformMemory.SetCoalesceUploads(true);
+		transformMemory.SetCoalesceUploads(true);
+		instanceTransformMemory.SetCoalesceUploads(true);
 		Clear();
 	}
+
+	void SceneResource::FlushUploads(RenderStat & stats)
+	{
+		stats.NumUploadCopies += instanceUniformMemory.FlushUploads(stats.NumUploadBytes);
+		stats.NumUploadCopies += transformMemory.FlushUploads(stats.NumUploadBytes);
+		stats.NumUploadCopies += instanceTransformMemory.FlushUploads(stats.NumUploadBytes);
+	}
+
+	SceneResource::~SceneResource()
+	{
+		for (auto module : instanceTransformModules)
+			delete module;
+	}
+
+	ModuleInstance * SceneResource::AllocInstanceTransformModule()
+	{
+		if (instanceTransformAllocPtr == instanceTransformModules.Count())
+		{
+			if (instanceTransformModules.Count() == MaxInstancedDrawsPerFrame)
+				return nullptr;
+			auto module = new ModuleInstance();
+			CreateModuleInstance(*module, Engine::GetShaderCompiler()->LoadSystemTypeSymbol("InstancedStaticMeshTransform"),
+				&instanceTransformMemory, (int)sizeof(Matrix4) * MaxInstancesPerDraw);
+			instanceTransformModules.Add(module);
+		}
+		return instanceTransformModules[instanceTransformAllocPtr++];
+	}
 	
 	void SceneResource::Clear()
 	{
 		Destroy();
+		// instance transform modules are recreated along with the descriptor set layout cache
+		for (auto module : instanceTransformModules)
+			delete module;
+		instanceTransformModules.Clear();
+		instanceTransformAllocPtr = 0;
 		meshes = CoreLib::EnumerableDictionary<CoreLib::String, RefPtr<DrawableMesh>>();
 		textures = EnumerableDictionary<String, RefPtr<Texture2D>>();
         deviceLightmapSet = nullptr;
@@ -452,6 +499,11 @@ namespace GameEngine
 
 		shadowMapRenderTargetLayout = hwRenderer->CreateRenderTargetLayout(MakeArrayView(AttachmentLayout(TextureUsage::SampledDepthAttachment, StorageFormat::Depth32)), true);
 		shadowMapRenderOutputs.SetSize(shadowMapArraySize);
+		shadowMapContents = new ShadowMapContents();
+		shadowMapContents->Keys.SetSize(shadowMapArraySize);
+		for (auto & content : shadowMapContents->Keys)
+			content = 0;
+		shadowMapContents->Frustums.SetSize(shadowMapArraySize);
 
 		shadowView = new ViewResource(hwRenderer);
 
@@ -472,6 +524,7 @@ namespace GameEngine
 		shadowMapRenderOutputs.Clear();
 		shadowMapArray = nullptr;
 		shadowView = nullptr;
+		shadowMapContents = nullptr;
 	}
 
 	void ShadowMapResource::Reset()
@@ -729,63 +782,157 @@ namespace GameEngine
 		}
 	}
 
+	// serializes parallel recording, since all callers share the recording thread ids
+	static std::mutex commandRecordingThreadsMutex;
+
+	int WorldPassRenderTask::RecordChunk(CommandBuffer * cmdBuf, int drawStart, int drawEnd)
+	{
+		int chunkShaders = 0;
+		cmdBuf->SetViewport(viewport);
+		for (int i = 0; i < bindings.Count(); i++)
+			cmdBuf->BindDescriptorSet(i, bindings[i]);
+		if (drawStart == drawEnd)
+			return 0;
+		Array<DescriptorSet*, 32> boundSets;
+		boundSets.SetSize(boundSets.GetCapacity());
+		for (auto & descSet : boundSets)
+			descSet = (DescriptorSet*)-1;
+		cmdBuf->BindIndexBuffer(drawCalls[drawStart].mesh->GetIndexBuffer(), 0);
+		PipelineClass * lastPipeline = nullptr;
+		DrawableMesh * lastMesh = nullptr;
+		for (int i = drawStart; i < drawEnd; i++)
+		{
+			auto & draw = drawCalls[i];
+			if (draw.pipeline != lastPipeline)
+			{
+				cmdBuf->BindPipeline(draw.pipeline->pipeline.Ptr());
+				lastPipeline = draw.pipeline;
+				chunkShaders++;
+			}
+			BindDescSet(boundSets.Buffer(), cmdBuf, bindings.Count(), draw.materialDescSet);
+			int descOffset = draw.materialDescSet ? 1 : 0;
+			BindDescSet(boundSets.Buffer(), cmdBuf, bindings.Count() + descOffset, draw.transformDescSet);
+			if (draw.mesh != lastMesh)
+			{
+				cmdBuf->BindVertexBuffer(draw.mesh->GetVertexBuffer(), draw.mesh->vertexBufferOffset);
+				lastMesh = draw.mesh;
+			}
+			if (draw.instanceCount > 1)
+				cmdBuf->DrawIndexedInstanced(draw.instanceCount, draw.mesh->indexBufferOffset / sizeof(int) + draw.range.StartIndex, draw.range.Count);
+			else
+				cmdBuf->DrawIndexed(draw.mesh->indexBufferOffset / sizeof(int) + draw.range.StartIndex, draw.range.Count);
+		}
+		return chunkShaders;
+	}
+
+	uint64_t WorldPassRenderTask::HashChunk(FrameBuffer * frameBuffer, int drawStart, int drawEnd)
+	{
+		// hashed field by field, draw calls contain padding
+		auto hashValue = [](uint64_t seed, auto value)
+		{
+			return ComputeHash64(&value, sizeof(value), seed);
+		};
+		uint64_t hash = hashValue(0xcbf29ce484222325ULL, frameBuffer);
+		hash = hashValue(hash, GetDescriptorSetEpoch());
+		hash = hashValue(hash, viewport.x);
+		hash = hashValue(hash, viewport.y);
+		hash = hashValue(hash, viewport.w);
+		hash = hashValue(hash, viewport.h);
+		hash = hashValue(hash, viewport.minZ);
+		hash = hashValue(hash, viewport.maxZ);
+		for (auto binding : bindings)
+			hash = hashValue(hash, binding);
+		for (int i = drawStart; i < drawEnd; i++)
+		{
+			auto & draw = drawCalls[i];
+			hash = hashValue(hash, draw.pipeline->Id);
+			hash = hashValue(hash, draw.materialDescSet);
+			hash = hashValue(hash, draw.transformDescSet);
+			hash = hashValue(hash, draw.mesh->GetVertexBuffer());
+			hash = hashValue(hash, draw.mesh->GetIndexBuffer());
+			hash = hashValue(hash, draw.mesh->vertexBufferOffset);
+			hash = hashValue(hash, draw.mesh->indexBufferOffset);
+			hash = hashValue(hash, draw.range.StartIndex);
+			hash = hashValue(hash, draw.range.Count);
+			hash = hashValue(hash, draw.instanceCount);
+		}
+		// 0 marks a buffer that must not be reused
+		return hash ? hash : 1;
+	}
+
+	int WorldPassRenderTask::CountChunkShaders(int drawStart, int drawEnd)
+	{
+		int chunkShaders = 0;
+		PipelineClass * lastPipeline = nullptr;
+		for (int i = drawStart; i < drawEnd; i++)
+		{
+			if (drawCalls[i].pipeline != lastPipeline)
+			{
+				lastPipeline = drawCalls[i].pipeline;
+				chunkShaders++;
+			}
+		}
+		return chunkShaders;
+	}
+
+	// static drawables without a lightmap can be drawn with the per-instance transforms of InstancedStaticMeshTransform
+	static bool IsInstanceable(Drawable * drawable)
+	{
+		return drawable->GetType() == DrawableType::Static && drawable->lightmapId == 0xFFFFFFFF;
+	}
+
+	static bool CanShareInstancedDraw(Drawable * d1, Drawable * d2)
+	{
+		auto range1 = d1->GetElementRange();
+		auto range2 = d2->GetElementRange();
+		return IsInstanceable(d2) && d1->GetMesh() == d2->GetMesh() && d1->GetMaterial() == d2->GetMaterial() &&
+			d1->GetPrimitiveType() == d2->GetPrimitiveType() &&
+			range1.StartIndex == range2.StartIndex && range1.Count == range2.Count;
+	}
+
 	void WorldPassRenderTask::SetFixedOrderDrawContent(PipelineContext & pipelineManager, CoreLib::ArrayView<Drawable*> drawables)
+	{
+		SetDrawContentInternal(pipelineManager, drawables, nullptr);
+	}
+
+	void WorldPassRenderTask::SetDrawContentInternal(PipelineContext & pipelineManager, CoreLib::ArrayView<Drawable*> drawables, SceneResource * instancingScene)
 	{
 		// Note: Intel's vulkan driver seem to have a limit on the size of a secondary command buffer
 		// to play safe, we create multiple secondary command buffers, each holds 128 draw calls.
+		const int chunkSize = 128;
 		commandBuffers.Clear();
 		apiCommandBuffers.Clear();
         int outputWidth, outputHeight;
         renderOutput->GetSize(outputWidth, outputHeight);
 		viewport.w = (float)outputWidth;
         viewport.h = (float)outputHeight;
-		auto cmd0 = pass->AllocCommandBuffer();
-		commandBuffers.Add(cmd0);
-		auto cmdBuf = cmd0->BeginRecording(renderOutput->GetFrameBuffer());
-		apiCommandBuffers.Add(cmdBuf);
-        cmdBuf->SetViewport(viewport);
-		DescriptorSetBindingArray bindings;
 		pipelineManager.GetBindings(bindings);
-		for (int i = 0; i < bindings.Count(); i++)
-			cmdBuf->BindDescriptorSet(i, bindings[i]);
-		PipelineClass * lastPipeline = nullptr;
 		numDrawCalls = 0;
 		numMaterials = 0;
 		numShaders = 0;
-		Array<DescriptorSet*, 32> boundSets;
-		boundSets.SetSize(boundSets.GetCapacity());
-		for (auto & descSet : boundSets)
-			descSet = (DescriptorSet*)-1;
-		DrawableMesh * lastMesh = nullptr;
+		numInstancedDrawables = 0;
+		numReusedCommandBuffers = 0;
+		numSkippedDrawables = 0;
+
+		// pipeline lookup goes through the pipeline context and stays on this thread
+		drawCalls.Clear();
 		if (drawables.Count())
 		{
 			Material* lastMaterial = drawables[0]->GetMaterial();
 			pipelineManager.SetCullMode(lastMaterial->IsDoubleSided ? CullMode::Disabled : CullMode::CullBackFace);
-
-			cmdBuf->BindIndexBuffer(drawables[0]->GetMesh()->GetIndexBuffer(), 0);
 			pipelineManager.PushModuleInstance(&lastMaterial->MaterialModule);
 			numMaterials++;
-			BindDescSet(boundSets.Buffer(), cmdBuf, bindings.Count(), lastMaterial->MaterialModule.GetCurrentDescriptorSet());
-			for (auto obj : drawables)
+			auto getPipeline = [&](Drawable * obj)
 			{
-				numDrawCalls++;
-				if ((numDrawCalls & 127) == 0)
-				{
-					cmdBuf->EndRecording();
-					auto cmd = pass->AllocCommandBuffer();
-					commandBuffers.Add(cmd);
-					cmdBuf = cmd->BeginRecording(renderOutput->GetFrameBuffer());
-                    cmdBuf->SetViewport(viewport);
-					apiCommandBuffers.Add(cmdBuf);
-					for (int i = 0; i < boundSets.Count(); i++)
-						boundSets[i] = (DescriptorSet*)-1;
-					for (int i = 0; i < bindings.Count(); i++)
-						cmdBuf->BindDescriptorSet(i, bindings[i]);
-					cmdBuf->BindIndexBuffer(obj->GetMesh()->GetIndexBuffer(), 0);
-					BindDescSet(boundSets.Buffer(), cmdBuf, bindings.Count(), lastMaterial->MaterialModule.GetCurrentDescriptorSet());
-					lastPipeline = nullptr;
-					lastMesh = nullptr;
-				}
+				// instanced draws push a transform module of another type, so shader changes must be detected here
+				pipelineManager.PushModuleInstance(obj->GetTransformModule());
+				auto pipelineInst = obj->GetPipeline(renderPassId, pipelineManager);
+				pipelineManager.PopModuleInstance();
+				return pipelineInst;
+			};
+			for (int i = 0; i < drawables.Count(); )
+			{
+				auto obj = drawables[i];
 				auto newMaterial = obj->GetMaterial();
 				if (newMaterial != lastMaterial)
 				{
@@ -794,44 +941,143 @@ namespace GameEngine
 					pipelineManager.PushModuleInstance(&newMaterial->MaterialModule);
 					pipelineManager.SetCullMode(newMaterial->IsDoubleSided ? CullMode::Disabled : CullMode::CullBackFace);
 				}
-				pipelineManager.PushModuleInstanceNoShaderChange(obj->GetTransformModule());
-				if (auto pipelineInst = obj->GetPipeline(renderPassId, pipelineManager))
+				auto pipelineInst = getPipeline(obj);
+				// the pipeline is still being compiled
+				if (!pipelineInst)
 				{
-					if (pipelineInst != lastPipeline)
-					{
-						cmdBuf->BindPipeline(pipelineInst->pipeline.Ptr());
-						lastPipeline = pipelineInst;
-						numShaders++;
-					}
-					auto mesh = obj->GetMesh();
-					if (newMaterial != lastMaterial)
-					{
-						BindDescSet(boundSets.Buffer(), cmdBuf, bindings.Count(), newMaterial->MaterialModule.GetCurrentDescriptorSet());
-					}
-                    int descOffset = newMaterial->MaterialModule.GetCurrentDescriptorSet() ? 1 : 0;
-					BindDescSet(boundSets.Buffer(), cmdBuf, bindings.Count() + descOffset, obj->GetTransformModule()->GetCurrentDescriptorSet());
-					if (mesh != lastMesh)
-					{
-						cmdBuf->BindVertexBuffer(mesh->GetVertexBuffer(), mesh->vertexBufferOffset);
-						lastMesh = mesh;
-					}
-
-					auto range = obj->GetElementRange();
-					cmdBuf->DrawIndexed(mesh->indexBufferOffset / sizeof(int) + range.StartIndex, range.Count);
+					numSkippedDrawables++;
+					lastMaterial = newMaterial;
+					i++;
+					continue;
+				}
+				int runEnd = i + 1;
+				if (instancingScene && IsInstanceable(obj))
+				{
+					while (runEnd < drawables.Count() && runEnd - i < MaxInstancesPerDraw && CanShareInstancedDraw(obj, drawables[runEnd]) &&
+						getPipeline(drawables[runEnd]) == pipelineInst)
+						runEnd++;
+				}
+				ModuleInstance * instanceModule = nullptr;
+				PipelineClass * instancedPipeline = nullptr;
+				if (runEnd - i >= MinInstancesPerDraw)
+					instanceModule = instancingScene->AllocInstanceTransformModule();
+				if (instanceModule)
+				{
+					pipelineManager.PushModuleInstance(instanceModule);
+					instancedPipeline = pipelineManager.GetPipeline(&obj->GetVertexFormat(), obj->GetPrimitiveType());
+					pipelineManager.PopModuleInstance();
+				}
+				DrawCall draw;
+				draw.materialDescSet = newMaterial->MaterialModule.GetCurrentDescriptorSet();
+				draw.mesh = obj->GetMesh();
+				draw.range = obj->GetElementRange();
+				if (instancedPipeline)
+				{
+					Array<Matrix4, MaxInstancesPerDraw> transforms;
+					for (int j = i; j < runEnd; j++)
+						transforms.Add(drawables[j]->GetLocalTransform());
+					instanceModule->SetUniformData(transforms.Buffer(), transforms.Count() * (int)sizeof(Matrix4));
+					draw.pipeline = instancedPipeline;
+					draw.transformDescSet = instanceModule->GetCurrentDescriptorSet();
+					draw.instanceCount = runEnd - i;
+					numInstancedDrawables += draw.instanceCount;
 				}
 				else
-					throw "error";
+				{
+					runEnd = i + 1;
+					draw.pipeline = pipelineInst;
+					draw.transformDescSet = obj->GetTransformModule()->GetCurrentDescriptorSet();
+					draw.instanceCount = 1;
+				}
+				drawCalls.Add(draw);
 				lastMaterial = newMaterial;
-				pipelineManager.PopModuleInstance();
+				i = runEnd;
 			}
 			pipelineManager.PopModuleInstance();
 		}
-		cmdBuf->EndRecording();
+		numDrawCalls = drawCalls.Count();
+
+		// record chunks in parallel, each recording thread takes a contiguous range of chunks and uses
+		// command buffers created from its own command pool. chunks are submitted in draw order.
+		// a chunk whose draws, bindings and target match what its command buffer last recorded is submitted again as is.
+		// uniform data is not part of the hash: a draw refers to the uniform buffer version of its descriptor set, and the
+		// command buffer ring is a multiple of the version count, so a reused buffer reads the data written this frame.
+		bool reuseCommandBuffers = Engine::Instance()->GetGraphicsSettings().ReuseCommandBuffers;
+		auto frameBuffer = renderOutput->GetFrameBuffer();
+		int chunkCount = Math::Max(1, (drawCalls.Count() + chunkSize - 1) / chunkSize);
+		commandBuffers.SetSize(chunkCount);
+		apiCommandBuffers.SetSize(chunkCount);
+		auto hwRenderer = pass->GetHardwareRenderer();
+		auto scheduler = CoreLib::Threading::TaskScheduler::GetInstance();
+		int recordingThreadCount = Math::Min(Math::Min(chunkCount, scheduler->GetThreadCount()),
+			Math::Min(MaxCommandRecordingThreads, hwRenderer->GetMaxThreadCount() - FirstCommandRecordingThreadId + 1));
+		std::unique_lock<std::mutex> recordingLock(commandRecordingThreadsMutex, std::defer_lock);
+		if (recordingThreadCount > 1 && !recordingLock.try_lock())
+			recordingThreadCount = 1;
+		recordingThreadCount = Math::Max(1, recordingThreadCount);
+		Array<int, MaxCommandRecordingThreads> threadShaderCounts, threadReuseCounts;
+		threadShaderCounts.SetSize(recordingThreadCount);
+		threadReuseCounts.SetSize(recordingThreadCount);
+		auto recordChunks = [&](int recordingThread)
+		{
+			int chunkBegin = chunkCount * recordingThread / recordingThreadCount;
+			int chunkEnd = chunkCount * (recordingThread + 1) / recordingThreadCount;
+			threadShaderCounts[recordingThread] = 0;
+			threadReuseCounts[recordingThread] = 0;
+			for (int chunk = chunkBegin; chunk < chunkEnd; chunk++)
+			{
+				int drawStart = Math::Min(chunk * chunkSize, drawCalls.Count());
+				int drawEnd = Math::Min((chunk + 1) * chunkSize, drawCalls.Count());
+				auto cmd = pass->AllocCommandBuffer(recordingThread);
+				bool reused = false;
+				auto cmdBuf = cmd->BeginRecording(frameBuffer, reuseCommandBuffers ? HashChunk(frameBuffer, drawStart, drawEnd) : 0, reused);
+				if (reused)
+				{
+					threadShaderCounts[recordingThread] += CountChunkShaders(drawStart, drawEnd);
+					threadReuseCounts[recordingThread]++;
+				}
+				else
+				{
+					threadShaderCounts[recordingThread] += RecordChunk(cmdBuf, drawStart, drawEnd);
+					cmdBuf->EndRecording();
+				}
+				commandBuffers[chunk] = cmd;
+				apiCommandBuffers[chunk] = cmdBuf;
+			}
+		};
+		if (recordingThreadCount == 1)
+			recordChunks(0);
+		else
+		{
+			CoreLib::Threading::TaskCounter counter;
+			struct RecordContext
+			{
+				decltype(recordChunks) * record;
+				HardwareRenderer * hwRenderer;
+			} context = { &recordChunks, hwRenderer };
+			scheduler->Submit([](void * data, int index)
+			{
+				auto ctx = (RecordContext*)data;
+				int recordingThread = index + 1;
+				int callerThreadId = ctx->hwRenderer->GetThreadId();
+				ctx->hwRenderer->ThreadInit(FirstCommandRecordingThreadId + recordingThread - 1);
+				(*ctx->record)(recordingThread);
+				ctx->hwRenderer->ThreadInit(callerThreadId);
+			}, &context, recordingThreadCount - 1, &counter);
+			recordChunks(0);
+			counter.Wait();
+		}
+		for (auto count : threadShaderCounts)
+			numShaders += count;
+		for (auto count : threadReuseCounts)
+			numReusedCommandBuffers += count;
 	}
-	void WorldPassRenderTask::SetDrawContent(PipelineContext & pipelineManager, CoreLib::List<Drawable*>& reorderBuffer, CoreLib::ArrayView<Drawable*> drawables)
+	void WorldPassRenderTask::SetDrawContent(PipelineContext & pipelineManager, CoreLib::List<Drawable*>& reorderBuffer, CoreLib::ArrayView<Drawable*> drawables,
+		VectorMath::Vec3 viewPos)
 	{
 		reorderBuffer.Clear();
 		Material* lastMaterial = nullptr;
+		int skippedDrawables = 0;
 
 		if (drawables.Count())
 		{
@@ -841,7 +1087,6 @@ namespace GameEngine
 
 		for (auto obj : drawables)
 		{
-			obj->ReorderKey = 0;
 			auto newMaterial = obj->GetMaterial();
 			if (newMaterial != lastMaterial)
 			{
@@ -850,8 +1095,16 @@ namespace GameEngine
 				lastMaterial = newMaterial;
 			}
 			pipelineManager.PushModuleInstanceNoShaderChange(obj->GetTransformModule());
-			obj->ReorderKey = (obj->GetPipeline(renderPassId, pipelineManager)->Id << 18) + newMaterial->Id;
+			auto pipelineInst = obj->GetPipeline(renderPassId, pipelineManager);
 			pipelineManager.PopModuleInstance();
+			// drawables are skipped until their pipeline is compiled
+			if (!pipelineInst)
+			{
+				skippedDrawables++;
+				continue;
+			}
+			obj->ReorderKey = DrawSortKey::Make(newMaterial->IsTransparent ? DrawSortKey::TransparentLayer : DrawSortKey::OpaqueLayer,
+				pipelineInst->Id, newMaterial->Id, obj->GetMesh(), obj->GetElementRange(), obj->Bounds.Distance(viewPos));
 
 			reorderBuffer.Add(obj);
 		}
@@ -859,9 +1112,12 @@ namespace GameEngine
 		{
 			pipelineManager.PopModuleInstance();
 		}
-		reorderBuffer.Sort([](Drawable* d1, Drawable* d2) {return d1->ReorderKey < d2->ReorderKey; });
-		SetFixedOrderDrawContent(pipelineManager, reorderBuffer.GetArrayView());
-
+		pass->GetDrawableSorter().SortByKey(reorderBuffer);
+		SceneResource * instancingScene = nullptr;
+		if (Engine::Instance()->GetGraphicsSettings().UseInstancing)
+			instancingScene = Engine::Instance()->GetRenderer()->GetSceneResource();
+		SetDrawContentInternal(pipelineManager, reorderBuffer.GetArrayView(), instancingScene);
+		numSkippedDrawables += skippedDrawables;
 	}
 	void PostPassRenderTask::Execute(HardwareRenderer * /*hwRenderer*/, RenderStat & /*stats*/, PipelineBarriers barriers)
 	{
@@ -873,6 +1129,10 @@ namespace GameEngine
 		stats.NumDrawCalls += numDrawCalls;
 		stats.NumMaterials += numMaterials;
 		stats.NumShaders += numShaders;
+		stats.NumInstancedDrawables += numInstancedDrawables;
+		stats.NumReusedCommandBuffers += numReusedCommandBuffers;
+		if (auto sceneRes = Engine::Instance()->GetRenderer()->GetSceneResource())
+			sceneRes->FlushUploads(stats);
 		
 		hwRenderer->QueueRenderPass(renderOutput->GetFrameBuffer(), clearOutput,
 			MakeArrayView<CommandBuffer*>(apiCommandBuffers.Buffer(), apiCommandBuffers.Count()),
@@ -45,6 +45,20 @@ namespace GameEngine
 		int NumMaterials = 0;
 		float CpuTime = 0.0f;
 		float PipelineLookupTime = 0.0f;
+		// time the render thread was blocked on shader compilation, and the total compile time of created pipelines
+		float PipelineWaitTime = 0.0f;
+		float PipelineCompileTime = 0.0f;
+		int NumOccludedDrawables = 0;
+		int NumInstancedDrawables = 0;
+		// secondary command buffers of world passes submitted without recording them again
+		int NumReusedCommandBuffers = 0;
+		// copies from the cpu copies of scene memory to the device, and their total size
+		int NumUploadCopies = 0;
+		int64_t NumUploadBytes = 0;
+		// size of the transient render targets of the render graph
+		int64_t TransientMemory = 0;
+		// draw calls of shadow map passes
+		int NumShadowDrawCalls = 0;
 		CoreLib::Diagnostics::TimePoint StartTime;
 		void Clear()
 		{
@@ -55,6 +69,15 @@ namespace GameEngine
 			NumMaterials = 0;
 			CpuTime = 0.0f;
 			PipelineLookupTime = 0.0f;
+			PipelineWaitTime = 0.0f;
+			PipelineCompileTime = 0.0f;
+			NumOccludedDrawables = 0;
+			NumInstancedDrawables = 0;
+			NumReusedCommandBuffers = 0;
+			NumUploadCopies = 0;
+			NumUploadBytes = 0;
+			TransientMemory = 0;
+			NumShadowDrawCalls = 0;
 		}
 	};
 
@@ -78,11 +101,34 @@ namespace GameEngine
 
 	class WorldPassRenderTask : public RenderTask
 	{
+	private:
+		// draw call state resolved through the pipeline context, so that chunks can be recorded on any thread
+		struct DrawCall
+		{
+			PipelineClass * pipeline;
+			DescriptorSet * materialDescSet;
+			DescriptorSet * transformDescSet;
+			DrawableMesh * mesh;
+			MeshElementRange range;
+			int instanceCount;
+		};
+		CoreLib::List<DrawCall> drawCalls;
+		DescriptorSetBindingArray bindings;
+		int RecordChunk(CommandBuffer * cmdBuf, int drawStart, int drawEnd);
+		// covers everything RecordChunk records, never returns 0
+		uint64_t HashChunk(FrameBuffer * frameBuffer, int drawStart, int drawEnd);
+		int CountChunkShaders(int drawStart, int drawEnd);
+		// runs of static drawables sharing mesh, material and pipeline are merged into instanced draws if instancingScene is not null
+		void SetDrawContentInternal(PipelineContext & pipelineManager, CoreLib::ArrayView<Drawable*> drawables, SceneResource * instancingScene);
 	public:
 		int renderPassId = -1; 
 		int numDrawCalls = 0; 
 		int numMaterials = 0; 
 		int numShaders = 0;
+		int numInstancedDrawables = 0;
+		int numReusedCommandBuffers = 0;
+		// drawables left out because their pipeline is still being compiled
+		int numSkippedDrawables = 0;
 		SharedModuleInstances sharedModules; 
 		CoreLib::List<AsyncCommandBuffer*> commandBuffers;
 		CoreLib::List<CommandBuffer*> apiCommandBuffers;
@@ -93,7 +139,9 @@ namespace GameEngine
 		bool clearOutput = false;
 		virtual void Execute(HardwareRenderer * hw, RenderStat & stats, PipelineBarriers barriers) override;
 		void SetFixedOrderDrawContent(PipelineContext & pipelineManager, CoreLib::ArrayView<Drawable*> drawables);
-		void SetDrawContent(PipelineContext & pipelineManager, CoreLib::List<Drawable*>& reorderBuffer, CoreLib::ArrayView<Drawable*> drawables);
+		// sorts drawables by render state, and front to back from viewPos among drawables of the same state
+		void SetDrawContent(PipelineContext & pipelineManager, CoreLib::List<Drawable*>& reorderBuffer, CoreLib::ArrayView<Drawable*> drawables,
+			VectorMath::Vec3 viewPos = VectorMath::Vec3::Create(0.0f));
 	};
 
 	class PostPassRenderTask : public RenderTask
@@ -109,6 +157,18 @@ namespace GameEngine
 		int dummy;
 	};
 
+	// identifies what each layer of a shadow map array holds, and which static content changes have been applied to it
+	class ShadowMapContents : public CoreLib::RefObject
+	{
+	public:
+		// 0 if the content of the layer cannot be reused
+		CoreLib::List<uint64_t> Keys;
+		// the view frustum each static layer was drawn with
+		CoreLib::List<CullFrustum> Frustums;
+		int StaticContentId = 0;
+		int StaticContentVersion = 0;
+	};
+
 	class ShadowMapResource
 	{
 	private:
@@ -119,6 +179,8 @@ namespace GameEngine
 		CoreLib::RefPtr<Texture2DArray> shadowMapArray;
 		CoreLib::RefPtr<RenderTargetLayout> shadowMapRenderTargetLayout;
 		CoreLib::List<CoreLib::RefPtr<RenderOutput>> shadowMapRenderOutputs;
+		// shared by all copies of the resource, so that a layer drawn through one copy is not reused by another.
+		CoreLib::RefPtr<ShadowMapContents> shadowMapContents;
 		int AllocShadowMaps(int count);
 		void FreeShadowMaps(int id, int count);
 		void Init(HardwareRenderer * hwRenderer);
@@ -179,6 +241,8 @@ namespace GameEngine
 		CoreLib::EnumerableDictionary<CoreLib::String, CoreLib::RefPtr<DrawableMesh>> meshes;
 		CoreLib::EnumerableDictionary<CoreLib::String, CoreLib::RefPtr<Texture2D>> textures;
 		void CreateMaterialModuleInstance(ModuleInstance & mInst, Material* material, const char * moduleName);
+		CoreLib::List<ModuleInstance*> instanceTransformModules;
+		int instanceTransformAllocPtr = 0;
 	public:
 		CoreLib::RefPtr<DrawableMesh> LoadDrawableMesh(Mesh * mesh);
         CoreLib::RefPtr<DrawableMesh> CreateDrawableMesh(Mesh * mesh);
@@ -188,11 +252,22 @@ namespace GameEngine
 	public:
         CoreLib::RefPtr<DeviceLightmapSet> deviceLightmapSet;
 		DeviceMemory instanceUniformMemory, transformMemory;
+		// backs the transform modules of instanced draws, only used by the render thread
+		DeviceMemory instanceTransformMemory;
 		void RegisterMaterial(Material * material);
+		// returns a transform module for one instanced draw of the current frame, or nullptr if the frame used up all of them
+		ModuleInstance * AllocInstanceTransformModule();
+		void ResetInstanceTransformModules()
+		{
+			instanceTransformAllocPtr = 0;
+		}
 		
 	public:
 		SceneResource(RendererSharedResource * resource);
+		~SceneResource();
 		void Clear();
+		// copies the updates of material, transform and instance uniforms made since the last flush to the device
+		void FlushUploads(RenderStat & stats);
 	};
 }
 #endif
\ No newline at end of file
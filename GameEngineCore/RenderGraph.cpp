@@ -0,0 +1,197 @@
+#include "RenderGraph.h"
+
+using namespace CoreLib;
+
+namespace GameEngine
+{
+	void RenderGraph::Clear()
+	{
+		passes.Clear();
+		resources.Clear();
+		physicalTextures.Clear();
+		transientMemory = 0;
+		unaliasedTransientMemory = 0;
+	}
+
+	int RenderGraph::AddTexture(const String & name, RenderGraphTextureDesc desc, bool transient)
+	{
+		Resource resource;
+		resource.Name = name;
+		resource.Desc = desc;
+		resource.IsTransient = transient;
+		resources.Add(resource);
+		return resources.Count() - 1;
+	}
+
+	int RenderGraph::AddBuffer(const String & name)
+	{
+		Resource resource;
+		resource.Name = name;
+		resource.IsTexture = false;
+		resources.Add(resource);
+		return resources.Count() - 1;
+	}
+
+	void RenderGraph::MarkOutput(int resource)
+	{
+		resources[resource].IsOutput = true;
+	}
+
+	int RenderGraph::AddPass(const String & name)
+	{
+		Pass pass;
+		pass.Name = name;
+		passes.Add(pass);
+		return passes.Count() - 1;
+	}
+
+	void RenderGraph::Read(int pass, int resource)
+	{
+		passes[pass].Accesses.Add(ResourceAccess{ resource, RenderGraphAccess::Read });
+	}
+
+	void RenderGraph::Write(int pass, int resource, RenderGraphAccess access)
+	{
+		passes[pass].Accesses.Add(ResourceAccess{ resource, access });
+	}
+
+	void RenderGraph::CullPasses()
+	{
+		// walk backwards from the outputs, a pass is needed if it writes a resource read by a later needed pass.
+		// writes are not assumed to overwrite the whole resource, so earlier writers stay needed as well.
+		List<bool> needed;
+		needed.SetSize(resources.Count());
+		for (int i = 0; i < resources.Count(); i++)
+			needed[i] = resources[i].IsOutput;
+		for (int i = passes.Count() - 1; i >= 0; i--)
+		{
+			auto & pass = passes[i];
+			pass.Live = false;
+			for (auto & access : pass.Accesses)
+			{
+				if (access.Access != RenderGraphAccess::Read && needed[access.Resource])
+					pass.Live = true;
+			}
+			if (pass.Live)
+			{
+				for (auto & access : pass.Accesses)
+				{
+					if (access.Access == RenderGraphAccess::Read)
+						needed[access.Resource] = true;
+				}
+			}
+		}
+	}
+
+	void RenderGraph::AssignPhysicalTextures()
+	{
+		for (int i = 0; i < passes.Count(); i++)
+		{
+			if (!passes[i].Live)
+				continue;
+			for (auto & access : passes[i].Accesses)
+			{
+				auto & resource = resources[access.Resource];
+				if (resource.FirstUse == -1)
+					resource.FirstUse = i;
+				resource.LastUse = i;
+			}
+		}
+		List<int> transientTextures;
+		for (int i = 0; i < resources.Count(); i++)
+		{
+			auto & resource = resources[i];
+			if (!resource.IsTexture || !resource.IsTransient)
+				continue;
+			unaliasedTransientMemory += resource.Desc.GetSize();
+			if (resource.FirstUse == -1)
+				continue;
+			if (resource.IsOutput)
+				resource.LastUse = passes.Count();
+			transientTextures.Add(i);
+		}
+		transientTextures.Sort([this](int r1, int r2) { return resources[r1].FirstUse < resources[r2].FirstUse; });
+		// textures of the same format and size share a physical texture when one is last used before the other is first used
+		for (auto id : transientTextures)
+		{
+			auto & resource = resources[id];
+			for (int i = 0; i < physicalTextures.Count(); i++)
+			{
+				auto & physicalTexture = physicalTextures[i];
+				if (physicalTexture.Desc == resource.Desc && physicalTexture.LastUse < resource.FirstUse)
+				{
+					resource.PhysicalTexture = i;
+					physicalTexture.LastUse = resource.LastUse;
+					break;
+				}
+			}
+			if (resource.PhysicalTexture == -1)
+			{
+				RenderGraphPhysicalTexture physicalTexture;
+				physicalTexture.Name = resource.Name;
+				physicalTexture.Desc = resource.Desc;
+				physicalTexture.LastUse = resource.LastUse;
+				resource.PhysicalTexture = physicalTextures.Count();
+				physicalTextures.Add(physicalTexture);
+				transientMemory += resource.Desc.GetSize();
+			}
+		}
+	}
+
+	void RenderGraph::DeriveBarriers()
+	{
+		// a pass may skip the barrier only if all it does is to keep drawing into the attachments of the previous pass.
+		// the first access of a frame waits for the previous frame, and aliased textures are tracked by physical texture.
+		List<int> lastWriter;
+		lastWriter.SetSize(resources.Count() + physicalTextures.Count());
+		for (auto & writer : lastWriter)
+			writer = -1;
+		int lastLivePass = -1;
+		for (int i = 0; i < passes.Count(); i++)
+		{
+			auto & pass = passes[i];
+			if (!pass.Live)
+				continue;
+			bool continuesPreviousPass = lastLivePass != -1 && pass.Accesses.Count() != 0;
+			for (auto & access : pass.Accesses)
+			{
+				auto & resource = resources[access.Resource];
+				int trackId = resource.PhysicalTexture == -1 ? access.Resource : resources.Count() + resource.PhysicalTexture;
+				if (access.Access != RenderGraphAccess::WriteAttachment || lastWriter[trackId] != lastLivePass)
+					continuesPreviousPass = false;
+			}
+			for (auto & access : pass.Accesses)
+			{
+				auto & resource = resources[access.Resource];
+				int trackId = resource.PhysicalTexture == -1 ? access.Resource : resources.Count() + resource.PhysicalTexture;
+				if (access.Access != RenderGraphAccess::Read)
+					lastWriter[trackId] = i;
+			}
+			pass.Barriers = continuesPreviousPass ? PipelineBarriers::None : PipelineBarriers::MemoryAndImage;
+			lastLivePass = i;
+		}
+	}
+
+	void RenderGraph::Compile()
+	{
+		physicalTextures.Clear();
+		transientMemory = 0;
+		unaliasedTransientMemory = 0;
+		for (auto & resource : resources)
+		{
+			resource.FirstUse = resource.LastUse = -1;
+			resource.PhysicalTexture = -1;
+		}
+		CullPasses();
+		AssignPhysicalTextures();
+		DeriveBarriers();
+	}
+
+	String RenderGraph::GetPhysicalTextureName(int resource)
+	{
+		int id = resources[resource].PhysicalTexture;
+		if (id == -1)
+			return String();
+		return physicalTextures[id].Name;
+	}
+}
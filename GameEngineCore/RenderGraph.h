@@ -0,0 +1,119 @@
+#ifndef GAME_ENGINE_RENDER_GRAPH_H
+#define GAME_ENGINE_RENDER_GRAPH_H
+
+#include "CoreLib/Basic.h"
+#include "HardwareRenderer.h"
+
+namespace GameEngine
+{
+	enum class RenderGraphAccess
+	{
+		Read, WriteAttachment, WriteStorage
+	};
+
+	struct RenderGraphTextureDesc
+	{
+		StorageFormat Format = StorageFormat::RGBA_8;
+		int Width = 0, Height = 0;
+		RenderGraphTextureDesc() = default;
+		RenderGraphTextureDesc(StorageFormat format, int w, int h)
+			: Format(format), Width(w), Height(h)
+		{}
+		bool operator == (const RenderGraphTextureDesc & other) const
+		{
+			return Format == other.Format && Width == other.Width && Height == other.Height;
+		}
+		int64_t GetSize() const
+		{
+			return (int64_t)Width * Height * StorageFormatSize(Format);
+		}
+	};
+
+	struct RenderGraphPhysicalTexture
+	{
+		CoreLib::String Name;
+		RenderGraphTextureDesc Desc;
+		int LastUse = -1;
+	};
+
+	// the passes of a frame in execution order, and the textures and buffers each of them reads and writes.
+	// Compile culls passes whose results are never used, places transient textures with disjoint lifetimes
+	// into the same physical texture and derives the barrier each pass needs.
+	// imported resources are owned by the caller and live across frames, transient textures only live within the frame.
+	class RenderGraph
+	{
+	private:
+		struct ResourceAccess
+		{
+			int Resource;
+			RenderGraphAccess Access;
+		};
+		struct Pass
+		{
+			CoreLib::String Name;
+			CoreLib::List<ResourceAccess> Accesses;
+			bool Live = true;
+			PipelineBarriers Barriers = PipelineBarriers::MemoryAndImage;
+		};
+		struct Resource
+		{
+			CoreLib::String Name;
+			RenderGraphTextureDesc Desc;
+			bool IsTexture = true;
+			bool IsTransient = false;
+			bool IsOutput = false;
+			int FirstUse = -1, LastUse = -1;
+			int PhysicalTexture = -1;
+		};
+		CoreLib::List<Pass> passes;
+		CoreLib::List<Resource> resources;
+		CoreLib::List<RenderGraphPhysicalTexture> physicalTextures;
+		int64_t transientMemory = 0, unaliasedTransientMemory = 0;
+		void CullPasses();
+		void AssignPhysicalTextures();
+		void DeriveBarriers();
+	public:
+		void Clear();
+		int AddTexture(const CoreLib::String & name, RenderGraphTextureDesc desc, bool transient);
+		int AddBuffer(const CoreLib::String & name);
+		// outputs are kept alive until the end of the frame, along with the passes producing them
+		void MarkOutput(int resource);
+		int AddPass(const CoreLib::String & name);
+		// a pass drawing on top of content of an earlier pass reads the attachment as well as writing it, except when it
+		// continues the attachments of the pass right before it
+		void Read(int pass, int resource);
+		void Write(int pass, int resource, RenderGraphAccess access = RenderGraphAccess::WriteAttachment);
+		void Compile();
+		bool IsPassLive(int pass)
+		{
+			return passes[pass].Live;
+		}
+		PipelineBarriers GetBarriers(int pass)
+		{
+			return passes[pass].Barriers;
+		}
+		// name of the physical texture backing a transient texture, which is the name of its first user.
+		// culled textures have no physical texture and return an empty name.
+		CoreLib::String GetPhysicalTextureName(int resource);
+		int GetPhysicalTextureCount()
+		{
+			return physicalTextures.Count();
+		}
+		const RenderGraphPhysicalTexture & GetPhysicalTexture(int id)
+		{
+			return physicalTextures[id];
+		}
+		// size of the physical transient textures of the compiled frame
+		int64_t GetTransientMemory()
+		{
+			return transientMemory;
+		}
+		// size of all declared transient textures if each had its own texture
+		int64_t GetUnaliasedTransientMemory()
+		{
+			return unaliasedTransientMemory;
+		}
+	};
+}
+
+#endif
@@ -19,6 +19,10 @@ namespace GameEngine
 		{
 			return renderTargetLayout.Ptr();
 		}
+		HardwareRenderer * GetHardwareRenderer()
+		{
+			return hwRenderer;
+		}
 		virtual int GetShaderId() = 0;
 		virtual const char * GetName() = 0;
 	};
@@ -15,6 +15,9 @@ namespace GameEngine
 		Level * level;
 		RendererService * rendererService;
 		bool isEditorMode = false;
+		int frameId = 0;
+		float time = 0.0f, timeDelta = 0.0f;
+		int snapshotId = 0; // which of the RenderFrameSnapshotCount snapshots Extract() fills and Run() consumes
 	};
 
 	class IRenderProcedure : public CoreLib::RefObject
@@ -23,6 +26,9 @@ namespace GameEngine
 		virtual void Init(Renderer * renderer, ViewResource * pViewRes) = 0;
 		virtual void UpdateSharedResourceBinding() = 0;
         virtual void UpdateSceneResourceBinding(SceneResource* sceneRes) = 0;
+		// called on the game thread. copies everything Run() needs out of the level, so Run() can execute
+		// on the render thread while game logic mutates the level. returns false if Run() still reads the level.
+		virtual bool Extract(const RenderProcedureParameters & params) = 0;
 		virtual void Run(const RenderProcedureParameters & params) = 0;
 		virtual RenderTarget* GetOutput() = 0;
         virtual CoreLib::String GetName() = 0;
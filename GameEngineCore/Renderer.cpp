@@ -18,6 +18,7 @@
 #include "PostRenderPass.h"
 #include "RenderProcedure.h"
 #include "ComputeTaskManager.h"
+#include "CoreLib/Threading.h"
 
 using namespace CoreLib;
 using namespace VectorMath;
@@ -74,6 +75,8 @@ namespace GameEngine
 				rs->type = DrawableType::Static;
                 rs->primType = mesh->GetPrimitiveType();
 				rs->elementRange = mesh->ElementRanges[elementId];
+                if (cacheMesh)
+                    rs->sourceMesh = mesh;
 				CreateTransformModuleInstance(*rs->transformModule, "StaticMeshTransform", (int)(sizeof(Vec4) * 5));
                 uint32_t lightmapId = 0xFFFFFFFF;
                 for (int i = 0; i < DynamicBufferLengthMultiplier; i++)
@@ -120,6 +123,17 @@ namespace GameEngine
 		int uniformBufferAlignment = 256;
 		int storageBufferAlignment = 32;
 		int defaultEnvMapId = -1;
+		String pipelineManifestFileName;
+		RenderProcedureParameters frameParams[RenderFrameSnapshotCount];
+		IRenderProcedure* frameProcedures[RenderFrameSnapshotCount] = {};
+		int extractedFrameCount = 0, renderedFrameCount = 0;
+		// set by InitializeLevel, the first frame of a level waits for all of its pipelines
+		bool renderCompleteFrame = false;
+		CoreLib::Threading::Thread renderThread;
+		std::mutex renderThreadMutex;
+		std::condition_variable renderThreadCondition;
+		bool renderThreadStarted = false, renderThreadBusy = false, renderThreadExit = false;
+		String renderThreadError;
 	private:
         void RegisterRenderProcedure(IRenderProcedure* proc, ViewResource* viewRes)
         {
@@ -133,20 +147,37 @@ namespace GameEngine
 		void RunRenderProcedure()
 		{
 			if (!level) return;
-			RenderProcedureParameters params;
-			params.renderStats = &sharedRes.renderStats;
-			params.level = level;
-			params.renderer = this;
-			params.isEditorMode = Engine::Instance()->GetEngineMode() == EngineMode::Editor;
-			auto curCam = level->CurrentCamera.Ptr();
-			if (curCam)
-				params.view = curCam->GetView();
-			else
-				params.view = View();
-			params.rendererService = renderService.Ptr();
-
-            if (currentRenderProcedure)
-			    currentRenderProcedure->Run(params);
+			if (renderedFrameCount == extractedFrameCount)
+				ExtractFrame();
+			int slot = renderedFrameCount % RenderFrameSnapshotCount;
+			renderedFrameCount++;
+			sceneRes->ResetInstanceTransformModules();
+			if (frameProcedures[slot])
+				frameProcedures[slot]->Run(frameParams[slot]);
+		}
+		void RenderThreadMain()
+		{
+			// the game thread only touches the hardware renderer while this thread is idle, so both share slot 0
+			hardwareRenderer->ThreadInit(0);
+			std::unique_lock<std::mutex> lock(renderThreadMutex);
+			while (true)
+			{
+				renderThreadCondition.wait(lock, [this]() { return renderThreadBusy || renderThreadExit; });
+				if (renderThreadExit)
+					break;
+				lock.unlock();
+				try
+				{
+					RenderFrame();
+				}
+				catch (const Exception & e)
+				{
+					renderThreadError = e.Message;
+				}
+				lock.lock();
+				renderThreadBusy = false;
+				renderThreadCondition.notify_all();
+			}
 		}
 	public:
         CoreLib::RefPtr<ComputeTaskManager> computeTaskManager;
@@ -197,6 +228,16 @@ namespace GameEngine
 		~RendererImpl()
 		{
 			Wait();
+			sharedRes.pipelineManager.SavePipelineManifest(pipelineManifestFileName);
+			if (renderThreadStarted)
+			{
+				{
+					std::lock_guard<std::mutex> lock(renderThreadMutex);
+					renderThreadExit = true;
+				}
+				renderThreadCondition.notify_all();
+				renderThread.Join();
+			}
 			for (auto & postPass : postRenderPasses)
 				postPass = nullptr;
 
@@ -216,8 +257,22 @@ namespace GameEngine
             renderProcedures.TryGetValue(viewName, proc);
             currentRenderProcedure = proc.Ptr();
         }
+		virtual void WaitForFrame() override
+		{
+			if (!renderThreadStarted || std::this_thread::get_id() == renderThread.GetHandle())
+				return;
+			std::unique_lock<std::mutex> lock(renderThreadMutex);
+			renderThreadCondition.wait(lock, [this]() { return !renderThreadBusy; });
+			if (renderThreadError.Length())
+			{
+				auto message = _Move(renderThreadError);
+				renderThreadError = String();
+				throw Exception(message);
+			}
+		}
 		virtual void Wait() override
 		{
+			WaitForFrame();
 			hardwareRenderer->Wait();
 		}
 
@@ -253,6 +308,7 @@ namespace GameEngine
                 sceneRes->deviceLightmapSet->Init(hardwareRenderer, lightmapSet);
                 for (auto proc : renderProcedures)
                     proc.Value->UpdateSceneResourceBinding(sceneRes.Ptr());
+                AdvanceDescriptorSetEpoch();
             }
         }
 		RefPtr<ViewResource> cubemapRenderView;
@@ -303,11 +359,29 @@ namespace GameEngine
                 sceneRes->deviceLightmapSet->Init(hardwareRenderer, lightmapSet);
             }
         }
+		// creates the pipelines recorded for this level in a previous run before its first frame is rendered
+		void WarmUpPipelines()
+		{
+			auto & pipelineManager = sharedRes.pipelineManager;
+			pipelineManager.ClearPipelineUsage();
+			pipelineManifestFileName = String();
+			if (level->FileName.Length() == 0)
+				return;
+			pipelineManifestFileName = Path::ReplaceExt(level->FileName, "pipelines");
+			if (!File::Exists(pipelineManifestFileName))
+				return;
+			auto startTime = CoreLib::Diagnostics::PerformanceCounter::Start();
+			int count = pipelineManager.WarmUpPipelines(pipelineManifestFileName);
+			Print("warmed up %d pipelines in %.1f ms.\n", count, CoreLib::Diagnostics::PerformanceCounter::EndSeconds(startTime) * 1000.0f);
+		}
 		virtual void InitializeLevel(Level* pLevel) override
 		{
 			if (!pLevel) return;
+			WaitForFrame();
 			level = pLevel;
+			extractedFrameCount = renderedFrameCount = 0;
             TryLoadLightmap();
+			WarmUpPipelines();
 
 			defaultEnvMapId = -1;
             for (auto proc : renderProcedures)
@@ -315,8 +389,10 @@ namespace GameEngine
                 proc.Value->UpdateSharedResourceBinding();
                 proc.Value->UpdateSceneResourceBinding(sceneRes.Ptr());
             }
+            AdvanceDescriptorSetEpoch();
 			UpdateLightProbes();
 			RunRenderProcedure();
+			renderCompleteFrame = true;
 			RenderFrame();
 			Wait();
 			sharedRes.renderStats.Clear();
@@ -335,16 +411,59 @@ namespace GameEngine
 			int length;
 		};
 
+		virtual bool ExtractFrame() override
+		{
+			if (!level) return false;
+			int slot = extractedFrameCount % RenderFrameSnapshotCount;
+			extractedFrameCount++;
+			auto & params = frameParams[slot];
+			params.renderStats = &sharedRes.renderStats;
+			params.level = level;
+			params.renderer = this;
+			params.isEditorMode = Engine::Instance()->GetEngineMode() == EngineMode::Editor;
+			auto curCam = level->CurrentCamera.Ptr();
+			if (curCam)
+				params.view = curCam->GetView();
+			else
+				params.view = View();
+			params.rendererService = renderService.Ptr();
+			params.frameId = Engine::Instance()->GetFrameId();
+			params.time = Engine::Instance()->GetTime();
+			params.timeDelta = Engine::Instance()->GetTimeDelta(EngineThread::Rendering);
+			params.snapshotId = slot;
+			frameProcedures[slot] = currentRenderProcedure;
+			if (currentRenderProcedure)
+				return currentRenderProcedure->Extract(params);
+			return false;
+		}
 		virtual void RenderFrame() override
 		{
 			if (!level) return;
-            static int frameId = 0;
-            frameId++;
+			auto cpuTimePoint = CoreLib::Diagnostics::PerformanceCounter::Start();
             sharedRes.renderStats.Divisor++;
 			sharedRes.renderStats.NumMaterials = 0;
 			sharedRes.renderStats.NumShaders = 0;
             
+			// only regular frames may skip drawables, light probes and the first frame of a level are rendered complete
+			sharedRes.pipelineManager.SetAsyncCompilation(!renderCompleteFrame && Engine::Instance()->GetGraphicsSettings().UseAsyncPipelineCompilation);
+			renderCompleteFrame = false;
             RunRenderProcedure();
+			sharedRes.pipelineManager.SetAsyncCompilation(false);
+			sharedRes.renderStats.CpuTime += CoreLib::Diagnostics::PerformanceCounter::EndSeconds(cpuTimePoint);
+		}
+		virtual void RenderFrameAsync() override
+		{
+			WaitForFrame();
+			if (!renderThreadStarted)
+			{
+				renderThreadStarted = true;
+				renderThread.Start(new CoreLib::Threading::ThreadProc([this]() { RenderThreadMain(); }));
+			}
+			{
+				std::lock_guard<std::mutex> lock(renderThreadMutex);
+				renderThreadBusy = true;
+			}
+			renderThreadCondition.notify_all();
 		}
 		virtual RendererSharedResource * GetSharedResource() override
 		{
@@ -368,6 +487,9 @@ namespace GameEngine
 		}
 		virtual void DestroyContext() override
 		{
+			WaitForFrame();
+			sharedRes.pipelineManager.SavePipelineManifest(pipelineManifestFileName);
+			pipelineManifestFileName = String();
 			sharedRes.ResetEnvMapAllocation();
 			sceneRes->Clear();
 		}
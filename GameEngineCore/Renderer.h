@@ -27,7 +27,14 @@ namespace GameEngine
 		virtual void DestroyContext() = 0;
 		virtual void InitializeLevel(Level * level) = 0;
 		virtual RenderStat& GetStats() = 0;
+		// game thread: captures the level state for the next RenderFrame(). returns false if the current
+		// render procedure still reads the level while rendering, so the frame must not overlap game logic.
+		virtual bool ExtractFrame() = 0;
 		virtual void RenderFrame() = 0;
+		// runs RenderFrame() on the render thread. WaitForFrame() blocks until that frame is submitted,
+		// Wait() additionally waits for the GPU.
+		virtual void RenderFrameAsync() = 0;
+		virtual void WaitForFrame() = 0;
 		virtual void Resize(int w, int h) = 0;
 		virtual void Wait() = 0;
         virtual CoreLib::ArrayView<CoreLib::String> GetDebugViews() = 0;
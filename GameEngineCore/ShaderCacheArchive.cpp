@@ -0,0 +1,385 @@
+#include "ShaderCacheArchive.h"
+#include "CoreLib/LibIO.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace CoreLib;
+using namespace CoreLib::IO;
+
+namespace GameEngine
+{
+	const uint32_t ArchiveMagic = 0x52414353; // "SCAR"
+	const uint32_t ArchiveVersion = 1;
+	const uint32_t RecordMagic = 0x43455253; // "SREC"
+	// journals longer than this are folded into the table of contents on the next Open
+	const int MaxJournalRecords = 256;
+
+	struct ArchiveHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t TocCapacity;
+		uint32_t EntryCount;
+		uint64_t TocOffset;
+		uint64_t JournalOffset;
+		uint64_t Checksum;
+	};
+
+	struct TocSlot
+	{
+		// 0 marks an empty slot
+		uint64_t Key;
+		uint64_t Offset;
+	};
+
+	struct RecordHeader
+	{
+		uint32_t Magic;
+		uint32_t NameLength;
+		uint32_t DataLength;
+		uint32_t Reserved;
+		uint64_t Key;
+		uint64_t Checksum;
+	};
+
+	uint64_t ComputeHash64(const void * data, size_t length, uint64_t seed)
+	{
+		auto bytes = (const unsigned char*)data;
+		uint64_t hash = seed;
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	static uint64_t NormalizeKey(uint64_t key)
+	{
+		return key ? key : 1;
+	}
+
+	static uint64_t AlignRecordSize(uint64_t size)
+	{
+		return (size + 7) & ~7ULL;
+	}
+
+	static uint64_t GetRecordSize(int nameLength, int dataLength)
+	{
+		return AlignRecordSize(sizeof(RecordHeader) + nameLength + dataLength);
+	}
+
+	static uint64_t ComputeRecordChecksum(uint64_t key, const String & name, ArrayView<unsigned char> data)
+	{
+		return ComputeHash64(data.Buffer(), data.Count(), ComputeHash64(name, key));
+	}
+
+	static void WriteRecord(Stream * stream, uint64_t key, const String & name, ArrayView<unsigned char> data)
+	{
+		RecordHeader header;
+		header.Magic = RecordMagic;
+		header.NameLength = (uint32_t)name.Length();
+		header.DataLength = (uint32_t)data.Count();
+		header.Reserved = 0;
+		header.Key = key;
+		header.Checksum = ComputeRecordChecksum(key, name, data);
+		stream->Write(&header, sizeof(header));
+		stream->Write(name.Buffer(), name.Length());
+		stream->Write(data.Buffer(), data.Count());
+		uint64_t padding = GetRecordSize(name.Length(), data.Count()) - (sizeof(header) + name.Length() + data.Count());
+		uint64_t zero = 0;
+		if (padding)
+			stream->Write(&zero, padding);
+	}
+
+	bool MappedFile::Open(const String & fileName)
+	{
+		Close();
+#ifdef _WIN32
+		auto fh = CreateFileW(fileName.ToWString(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fh == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fh, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(fh);
+			return false;
+		}
+		auto mh = CreateFileMappingW(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mh)
+		{
+			CloseHandle(fh);
+			return false;
+		}
+		auto ptr = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+		if (!ptr)
+		{
+			CloseHandle(mh);
+			CloseHandle(fh);
+			return false;
+		}
+		fileHandle = fh;
+		mappingHandle = mh;
+		data = (unsigned char*)ptr;
+		size = (uint64_t)fileSize.QuadPart;
+#else
+		int fd = open(fileName.Buffer(), O_RDONLY);
+		if (fd == -1)
+			return false;
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		auto ptr = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping keeps its own reference to the file
+		close(fd);
+		if (ptr == MAP_FAILED)
+			return false;
+		data = (unsigned char*)ptr;
+		size = (uint64_t)fileStat.st_size;
+#endif
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!data)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		mappingHandle = fileHandle = nullptr;
+#else
+		munmap(data, (size_t)size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	bool ShaderCacheArchive::ReadHeader()
+	{
+		tocOffset = 0;
+		tocCapacity = 0;
+		if (file.GetSize() < sizeof(ArchiveHeader))
+			return false;
+		ArchiveHeader header;
+		memcpy(&header, file.GetData(), sizeof(header));
+		if (header.Magic != ArchiveMagic || header.Version != ArchiveVersion ||
+			header.Checksum != ComputeHash64(&header, offsetof(ArchiveHeader, Checksum)))
+			return false;
+		if ((header.TocCapacity & (header.TocCapacity - 1)) != 0 ||
+			header.TocOffset + (uint64_t)header.TocCapacity * sizeof(TocSlot) > header.JournalOffset ||
+			header.JournalOffset > file.GetSize())
+			return false;
+		tocOffset = header.TocOffset;
+		tocCapacity = (int)header.TocCapacity;
+		journalOffset = header.JournalOffset;
+		return true;
+	}
+
+	bool ShaderCacheArchive::ReadRecord(uint64_t offset, uint64_t & nextOffset, uint64_t & key, Entry & entry)
+	{
+		auto size = file.GetSize();
+		if (offset + sizeof(RecordHeader) > size)
+			return false;
+		RecordHeader header;
+		memcpy(&header, file.GetData() + offset, sizeof(header));
+		if (header.Magic != RecordMagic)
+			return false;
+		nextOffset = offset + GetRecordSize(header.NameLength, header.DataLength);
+		if (nextOffset > size)
+			return false;
+		auto name = (const char*)file.GetData() + offset + sizeof(RecordHeader);
+		entry.Name = String(name, (int)header.NameLength);
+		entry.Data = MakeArrayView((unsigned char*)name + header.NameLength, (int)header.DataLength);
+		entry.Buffer = nullptr;
+		key = header.Key;
+		return header.Checksum == ComputeRecordChecksum(key, entry.Name, entry.Data);
+	}
+
+	int ShaderCacheArchive::ReplayJournal(uint64_t & validEnd)
+	{
+		int recordCount = 0;
+		validEnd = journalOffset;
+		uint64_t key, nextOffset;
+		Entry entry;
+		while (ReadRecord(validEnd, nextOffset, key, entry))
+		{
+			journalEntries[key] = entry;
+			validEnd = nextOffset;
+			recordCount++;
+		}
+		return recordCount;
+	}
+
+	void ShaderCacheArchive::Compact()
+	{
+		// gather the live entries, journal records replace entries of the table of contents
+		EnumerableDictionary<uint64_t, Entry> entries;
+		auto slots = (const TocSlot*)(file.GetData() + tocOffset);
+		for (int i = 0; i < tocCapacity; i++)
+		{
+			uint64_t key, nextOffset;
+			Entry entry;
+			if (slots[i].Key && ReadRecord(slots[i].Offset, nextOffset, key, entry) && key == slots[i].Key)
+				entries[key] = entry;
+		}
+		for (auto & entry : journalEntries)
+			entries[entry.Key] = entry.Value;
+
+		ArchiveHeader header;
+		header.Magic = ArchiveMagic;
+		header.Version = ArchiveVersion;
+		header.TocCapacity = 16;
+		while (header.TocCapacity < (uint32_t)entries.Count() * 2)
+			header.TocCapacity *= 2;
+		header.EntryCount = (uint32_t)entries.Count();
+		header.TocOffset = sizeof(ArchiveHeader);
+		List<TocSlot> toc;
+		toc.SetSize((int)header.TocCapacity);
+		memset(toc.Buffer(), 0, toc.Count() * sizeof(TocSlot));
+		uint64_t recordOffset = header.TocOffset + toc.Count() * sizeof(TocSlot);
+		for (auto & entry : entries)
+		{
+			int slot = (int)(entry.Key & (header.TocCapacity - 1));
+			while (toc[slot].Key)
+				slot = (slot + 1) & (header.TocCapacity - 1);
+			toc[slot].Key = entry.Key;
+			toc[slot].Offset = recordOffset;
+			recordOffset += GetRecordSize(entry.Value.Name.Length(), entry.Value.Data.Count());
+		}
+		header.JournalOffset = recordOffset;
+		header.Checksum = ComputeHash64(&header, offsetof(ArchiveHeader, Checksum));
+
+		// write a complete archive next to the old one and replace it, so a crash leaves either of them intact
+		auto tmpFileName = fileName + ".tmp";
+		{
+			RefPtr<FileStream> stream = new FileStream(tmpFileName, FileMode::Create);
+			stream->Write(&header, sizeof(header));
+			stream->Write(toc.Buffer(), toc.Count() * sizeof(TocSlot));
+			for (auto & entry : entries)
+				WriteRecord(stream.Ptr(), entry.Key, entry.Value.Name, entry.Value.Data);
+			stream->Close();
+		}
+		entries = EnumerableDictionary<uint64_t, Entry>();
+		journalEntries.Clear();
+		file.Close();
+#ifdef _WIN32
+		bool replaced = MoveFileExW(tmpFileName.ToWString(), fileName.ToWString(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		bool replaced = rename(tmpFileName.Buffer(), fileName.Buffer()) == 0;
+#endif
+		if (!replaced)
+			throw IOException("Cannot replace shader cache archive '" + fileName + "'");
+		if (!file.Open(fileName) || !ReadHeader())
+			throw IOException("Cannot open shader cache archive '" + fileName + "'");
+	}
+
+	void ShaderCacheArchive::Open(const String & archiveFileName)
+	{
+		Close();
+		fileName = archiveFileName;
+		bool damaged = !file.Open(fileName) || !ReadHeader();
+		if (!damaged)
+		{
+			uint64_t validEnd;
+			int recordCount = ReplayJournal(validEnd);
+			// a record cut off by a crash is dropped together with anything after it
+			damaged = validEnd != file.GetSize() || recordCount > MaxJournalRecords;
+		}
+		if (damaged)
+			Compact();
+		journalStream = new FileStream(fileName, FileMode::Append);
+	}
+
+	void ShaderCacheArchive::Close()
+	{
+		if (journalStream)
+		{
+			journalStream->Close();
+			journalStream = nullptr;
+		}
+		journalEntries.Clear();
+		file.Close();
+		tocOffset = 0;
+		tocCapacity = 0;
+		journalOffset = 0;
+	}
+
+	bool ShaderCacheArchive::TryGetEntry(uint64_t key, const String & name, ArrayView<unsigned char> & data)
+	{
+		key = NormalizeKey(key);
+		if (auto entry = journalEntries.TryGetValue(key))
+		{
+			if (entry->Name != name)
+				return false;
+			data = entry->Data;
+			return true;
+		}
+		if (!tocCapacity)
+			return false;
+		auto slots = (const TocSlot*)(file.GetData() + tocOffset);
+		for (int slot = (int)(key & (tocCapacity - 1)); slots[slot].Key; slot = (slot + 1) & (tocCapacity - 1))
+		{
+			if (slots[slot].Key != key)
+				continue;
+			// records of the table of contents were validated when they were written, only the name is compared
+			RecordHeader header;
+			memcpy(&header, file.GetData() + slots[slot].Offset, sizeof(header));
+			auto recordName = (const char*)file.GetData() + slots[slot].Offset + sizeof(RecordHeader);
+			if (header.NameLength != (uint32_t)name.Length() || memcmp(recordName, name.Buffer(), name.Length()) != 0)
+				return false;
+			data = MakeArrayView((unsigned char*)recordName + header.NameLength, (int)header.DataLength);
+			return true;
+		}
+		return false;
+	}
+
+	void ShaderCacheArchive::AddEntry(uint64_t key, const String & name, ArrayView<unsigned char> data)
+	{
+		key = NormalizeKey(key);
+		Entry entry;
+		entry.Name = name;
+		entry.Buffer = new List<unsigned char>();
+		entry.Buffer->AddRange(data.Buffer(), data.Count());
+		entry.Data = entry.Buffer->GetArrayView();
+		journalEntries[key] = entry;
+		if (journalStream)
+		{
+			try
+			{
+				WriteRecord(journalStream.Ptr(), key, name, data);
+			}
+			catch (const IOException &)
+			{
+				// the entry stays available in this session, a partially written record is discarded on the next Open
+				journalStream = nullptr;
+			}
+		}
+	}
+
+	int ShaderCacheArchive::GetEntryCount()
+	{
+		int count = 0;
+		auto slots = (const TocSlot*)(file.GetData() + tocOffset);
+		for (int i = 0; i < tocCapacity; i++)
+		{
+			if (slots[i].Key && !journalEntries.ContainsKey(slots[i].Key))
+				count++;
+		}
+		return count + journalEntries.Count();
+	}
+}
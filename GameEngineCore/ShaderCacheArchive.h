@@ -0,0 +1,90 @@
+#ifndef GAME_ENGINE_SHADER_CACHE_ARCHIVE_H
+#define GAME_ENGINE_SHADER_CACHE_ARCHIVE_H
+
+#include "CoreLib/Basic.h"
+#include "CoreLib/Stream.h"
+
+namespace GameEngine
+{
+	// 64-bit FNV-1a, used for cache keys and content hashes
+	uint64_t ComputeHash64(const void * data, size_t length, uint64_t seed = 0xcbf29ce484222325ULL);
+
+	inline uint64_t ComputeHash64(const CoreLib::String & str, uint64_t seed = 0xcbf29ce484222325ULL)
+	{
+		return ComputeHash64(str.Buffer(), (size_t)str.Length(), seed);
+	}
+
+	// read-only mapping of a whole file
+	class MappedFile
+	{
+	private:
+		unsigned char * data = nullptr;
+		uint64_t size = 0;
+#ifdef _WIN32
+		void * fileHandle = nullptr;
+		void * mappingHandle = nullptr;
+#endif
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile &) = delete;
+		MappedFile & operator = (const MappedFile &) = delete;
+		~MappedFile()
+		{
+			Close();
+		}
+		// returns false if the file does not exist or is empty
+		bool Open(const CoreLib::String & fileName);
+		void Close();
+		const unsigned char * GetData() const
+		{
+			return data;
+		}
+		uint64_t GetSize() const
+		{
+			return size;
+		}
+	};
+
+	// a single-file store of named binary entries. the file starts with a header and a hashed table of contents
+	// covering all entries at the time the archive was last compacted. entries added after that are appended
+	// as self-validating journal records, so an interrupted append only loses that entry.
+	// the file is memory mapped on Open, entries read from it point directly into the mapping.
+	class ShaderCacheArchive
+	{
+	private:
+		struct Entry
+		{
+			CoreLib::String Name;
+			CoreLib::ArrayView<unsigned char> Data;
+			// entries added in this session own their data
+			CoreLib::RefPtr<CoreLib::List<unsigned char>> Buffer;
+		};
+		CoreLib::String fileName;
+		MappedFile file;
+		uint64_t tocOffset = 0, journalOffset = 0;
+		int tocCapacity = 0;
+		// entries in journal records and entries added since Open, they take precedence over the table of contents
+		CoreLib::EnumerableDictionary<uint64_t, Entry> journalEntries;
+		CoreLib::RefPtr<CoreLib::IO::FileStream> journalStream;
+		bool ReadHeader();
+		int ReplayJournal(uint64_t & validEnd);
+		bool ReadRecord(uint64_t offset, uint64_t & nextOffset, uint64_t & key, Entry & entry);
+		void Compact();
+	public:
+		~ShaderCacheArchive()
+		{
+			Close();
+		}
+		// maps the archive and replays its journal, creating the file if it does not exist. archives with a long
+		// journal or a damaged tail are rewritten with a new table of contents before they are mapped.
+		void Open(const CoreLib::String & archiveFileName);
+		void Close();
+		// name guards against key collisions, data stays valid until the archive is closed
+		bool TryGetEntry(uint64_t key, const CoreLib::String & name, CoreLib::ArrayView<unsigned char> & data);
+		// appends a journal record, replacing an existing entry of the same key
+		void AddEntry(uint64_t key, const CoreLib::String & name, CoreLib::ArrayView<unsigned char> data);
+		int GetEntryCount();
+	};
+}
+
+#endif
@@ -1,8 +1,10 @@
 #include "ShaderCompiler.h"
+#include "ShaderCacheArchive.h"
 #include "CoreLib/LibIO.h"
 #include "Engine.h"
 #include "ExternalLibs/Slang/slang.h"
 #include "CoreLib/Tokenizer.h"
+#include <mutex>
 
 namespace GameEngine
 {
@@ -14,55 +16,27 @@ namespace GameEngine
     private:
         String path;
         TargetShadingLanguage language;
-        EnumerableDictionary<String, int> shaderCodeIndex;
-        EnumerableDictionary<int, RefPtr<List<char>>> codeRepo;
-        EnumerableDictionary<int, List<DescriptorSetInfo>> bindingLayouts;
-        IntSet updatedCodeIndices;
-        String GetCacheIndexFileName()
+        ShaderCacheArchive archive;
+        String GetArchiveFileName()
         {
             switch (language)
             {
             case TargetShadingLanguage::HLSL:
-                return Path::Combine(path, "index_hlsl.txt");
+                return Path::Combine(path, "shaders_hlsl.pak");
             case TargetShadingLanguage::SPIRV:
-                return Path::Combine(path, "index_spv.txt");
+                return Path::Combine(path, "shaders_spv.pak");
             default:
-                return Path::Combine(path, "index.txt");
+                return Path::Combine(path, "shaders.pak");
             }
         }
-        String GetShaderCodeFileName(int shaderIndex)
+        String GetShaderSourceFileName(uint64_t key)
         {
-            switch (language)
-            {
-            case TargetShadingLanguage::HLSL:
-                return Path::Combine(path, String("shader_") + String(shaderIndex) + ".hlsl");
-            case TargetShadingLanguage::SPIRV:
-                return Path::Combine(path, String("shader_") + String(shaderIndex) + ".spv");
-            default:
-                return Path::Combine(path, String("shader_") + String(shaderIndex) + ".bin");
-            }
-        }
-        String GetBindingLayoutFileName(int shaderIndex)
-        {
-            String postfix;
-            switch (language)
-            {
-            case TargetShadingLanguage::HLSL:
-                postfix = ".hlsl";
-                break;
-            case TargetShadingLanguage::SPIRV:
-                postfix = ".spv";
-                break;
-            default:
-                break;
-            }
-            return Path::Combine(path, String("shader_") + String(shaderIndex) + postfix + ".binding");
+            return Path::Combine(path, String("shader_") + String((unsigned long long)key, 16) + ".glsl");
         }
 
-        void ReadBindingLayout(List<DescriptorSetInfo> & layout, String fileName)
+        void ReadBindingLayout(List<DescriptorSetInfo> & layout, BinaryReader & reader)
         {
             layout.Clear();
-            BinaryReader reader(new FileStream(fileName));
             int count = reader.ReadInt32();
             layout.SetSize(count);
             for (int i = 0; i < count; i++)
@@ -82,9 +56,8 @@ namespace GameEngine
                 }
             }
         }
-        void WriteBindingLayout(String fileName, List<DescriptorSetInfo> & layout)
+        void WriteBindingLayout(BinaryWriter & writer, List<DescriptorSetInfo> & layout)
         {
-            BinaryWriter writer(new FileStream(fileName, FileMode::Create));
             writer.Write(layout.Count());
             for (int i = 0; i < layout.Count(); i++)
             {
@@ -107,93 +80,95 @@ namespace GameEngine
         {
             language = lang;
             path = cachePath;
-            if (File::Exists(GetCacheIndexFileName()))
+            try
             {
-                CoreLib::Text::TokenReader reader(File::ReadAllText(GetCacheIndexFileName()));
-                while (!reader.IsEnd())
-                {
-                    auto key = reader.ReadStringLiteral();
-                    auto value = reader.ReadInt();
-                    shaderCodeIndex[key] = value;
-                }
+                archive.Open(GetArchiveFileName());
+            }
+            catch (const IOException & e)
+            {
+                // compiled shaders are still cached for this session
+                Print("Cannot open shader cache: %S\n", e.Message.ToWString());
             }
         }
+        // entries are keyed by a 64-bit hash of the key string, the string itself guards against collisions
         void UpdateEntry(String key, List<char> & code, char* glslSrc, List<DescriptorSetInfo>& layouts)
         {
-            int value = shaderCodeIndex.Count();
-            shaderCodeIndex.TryGetValue(key, value);
-            shaderCodeIndex[key] = value;
-            codeRepo[value] = new List<char>(code);
-            bindingLayouts[value] = layouts;
-            updatedCodeIndices.Add(value);
+            BinaryWriter writer(new MemoryStream());
+            writer.Write(code);
+            WriteBindingLayout(writer, layouts);
+            auto stream = (MemoryStream*)writer.GetStream();
+            auto hash = ComputeHash64(key);
+            archive.AddEntry(hash, key, MakeArrayView((unsigned char*)stream->GetBuffer(), stream->GetBufferSize()));
             if (glslSrc)
             {
-                File::WriteAllText(Path::ReplaceExt(GetShaderCodeFileName(value), "glsl"), glslSrc);
+                File::WriteAllText(GetShaderSourceFileName(hash), glslSrc);
             }
         }
         bool TryGetEntry(String key, List<char> & code, List<DescriptorSetInfo>& layouts)
         {
-            int value = -1;
-            if (shaderCodeIndex.TryGetValue(key, value))
-            {
-                RefPtr<List<char>> srcCode;
-                if (!codeRepo.TryGetValue(value, srcCode))
-                {
-                    auto shaderFile = GetShaderCodeFileName(value);
-                    if (File::Exists(shaderFile))
-                    {
-                        auto bytes = File::ReadAllBytes(shaderFile);
-                        srcCode = new List<char>();
-                        srcCode->AddRange((char*)bytes.Buffer(), bytes.Count());
-                        codeRepo[value] = srcCode;
-                    }
-                    else
-                    {
-                        shaderCodeIndex.Remove(key);
-                        return false;
-                    }
-                }
-                if (!bindingLayouts.TryGetValue(value, layouts))
-                {
-                    auto bindingFile = GetBindingLayoutFileName(value);
-                    if (File::Exists(bindingFile))
-                    {
-                        ReadBindingLayout(layouts, bindingFile);
-                    }
-                    else
-                    {
-                        shaderCodeIndex.Remove(key);
-                        return false;
-                    }
-                }
-                code = *srcCode;
-                return true;
-            }
-            return false;
+            ArrayView<unsigned char> data;
+            if (!archive.TryGetEntry(ComputeHash64(key), key, data))
+                return false;
+            BinaryReader reader(new MemoryStream(data));
+            reader.Read(code);
+            ReadBindingLayout(layouts, reader);
+            return true;
         }
-        void Save()
+        // reflected type layouts are stored under their own names, along with the hash of the sources they were reflected from
+        bool TryGetTypeSymbol(String name, uint64_t sourceHash, ShaderTypeSymbol & sym)
         {
-            for (auto & code : codeRepo)
+            ArrayView<unsigned char> data;
+            auto entryName = "type:" + name;
+            if (!archive.TryGetEntry(ComputeHash64(entryName), entryName, data))
+                return false;
+            BinaryReader reader(new MemoryStream(data));
+            if ((uint64_t)reader.ReadInt64() != sourceHash)
+                return false;
+            sym.UniformBufferSize = reader.ReadInt32();
+            int varCount = reader.ReadInt32();
+            for (int i = 0; i < varCount; i++)
             {
-                if (updatedCodeIndices.Contains(code.Key))
-                {
-                    auto fileName = GetShaderCodeFileName(code.Key);
-                    File::WriteAllBytes(fileName, code.Value->Buffer(), code.Value->Count());
-                }
+                ShaderVariableLayout varLayout;
+                varLayout.Name = reader.ReadString();
+                varLayout.Type = (ShaderVariableType)reader.ReadInt32();
+                varLayout.BindingOffset = reader.ReadInt32();
+                varLayout.BindingLength = reader.ReadInt32();
+                varLayout.BindingSpace = reader.ReadInt32();
+                sym.VarLayouts.Add(varLayout.Name, varLayout);
             }
-            for (auto & binding : bindingLayouts)
+            int attribCount = reader.ReadInt32();
+            for (int i = 0; i < attribCount; i++)
             {
-                if (updatedCodeIndices.Contains(binding.Key))
-                {
-                    auto fileName = GetBindingLayoutFileName(binding.Key);
-                    WriteBindingLayout(fileName, binding.Value);
-                }
+                ShaderAttribute sa;
+                sa.Name = reader.ReadString();
+                sym.Attributes.Add(sa.Name, sa);
             }
-            StreamWriter writer(GetCacheIndexFileName());
-            for (auto & idx : shaderCodeIndex)
+            return true;
+        }
+        void UpdateTypeSymbol(String name, uint64_t sourceHash, ShaderTypeSymbol & sym)
+        {
+            BinaryWriter writer(new MemoryStream());
+            writer.Write((int64_t)sourceHash);
+            writer.Write((int32_t)sym.UniformBufferSize);
+            writer.Write(sym.VarLayouts.Count());
+            for (auto & varLayout : sym.VarLayouts)
             {
-                writer << CoreLib::Text::EscapeStringLiteral(idx.Key) << " " << idx.Value << "\n";
+                writer.Write(varLayout.Value.Name);
+                writer.Write((int32_t)varLayout.Value.Type);
+                writer.Write((int32_t)varLayout.Value.BindingOffset);
+                writer.Write((int32_t)varLayout.Value.BindingLength);
+                writer.Write((int32_t)varLayout.Value.BindingSpace);
             }
+            writer.Write(sym.Attributes.Count());
+            for (auto & attrib : sym.Attributes)
+                writer.Write(attrib.Value.Name);
+            auto stream = (MemoryStream*)writer.GetStream();
+            auto entryName = "type:" + name;
+            archive.AddEntry(ComputeHash64(entryName), entryName, MakeArrayView((unsigned char*)stream->GetBuffer(), stream->GetBufferSize()));
+        }
+        void Close()
+        {
+            archive.Close();
         }
     };
 
@@ -204,16 +179,22 @@ namespace GameEngine
         EnumerableDictionary<String, SlangCompileRequest*> reflectionCompileRequests;
         EnumerableDictionary<String, RefPtr<ShaderEntryPoint>> shaderEntryPoints;
         EnumerableDictionary<String, RefPtr<ShaderTypeSymbol>> shaderTypeSymbols;
+        EnumerableDictionary<String, uint64_t> sourceHashes;
         SlangSession *session = nullptr;
         StringBuilder sb;
         ShaderCache cache;
+        // pipelines are compiled on background threads while the game thread loads type symbols.
+        // compilerMutex guards the slang session and is held for whole compilations, cacheMutex guards the loaded
+        // symbols, entry points and the shader cache so that lookups never wait for a compilation.
+        // when both are held, compilerMutex is taken first.
+        std::mutex compilerMutex, cacheMutex;
         SlangShaderCompiler()
         {
             cache.Load(Engine::Instance()->GetDirectory(false, ResourceType::ShaderCache), Engine::Instance()->GetTargetShadingLanguage());
         }
         ~SlangShaderCompiler()
         {
-            cache.Save();
+            cache.Close();
             for (auto cr : reflectionCompileRequests)
                 spDestroyCompileRequest(cr.Value);
             if (session)
@@ -296,6 +277,7 @@ namespace GameEngine
             List<String> keys;
             src.ShaderCode.SetSize(entryPoints.Count());
             List<int> entryPointsToCompile;
+            std::unique_lock<std::mutex> cacheLock(cacheMutex);
             for (int i = 0; i < entryPoints.Count(); i++)
             {
                 auto entryPoint = entryPoints[i];
@@ -315,8 +297,10 @@ namespace GameEngine
                     entryPointsToCompile.Add(i);
                 }
             }
+            cacheLock.unlock();
             if (entryPointsToCompile.Count())
             {
+                std::lock_guard<std::mutex> lock(compilerMutex);
                 StageFlags stageFlags = sfNone;
                 auto req = NewCompileRequest();
                 Dictionary<String, int> addedTUs;
@@ -423,6 +407,7 @@ namespace GameEngine
                     }
                 }
 
+                cacheLock.lock();
                 for (int i = 0; i < entryPointsToCompile.Count(); i++)
                 {
                     auto eid = entryPointsToCompile[i];
@@ -431,6 +416,7 @@ namespace GameEngine
                         glsl = glslOutput[i];
                     cache.UpdateEntry(keys[eid], src.ShaderCode[eid], glsl, src.BindingLayouts);
                 }
+                cacheLock.unlock();
 
                 spDestroyCompileRequest(req);
             }
@@ -477,18 +463,73 @@ namespace GameEngine
             spAddTranslationUnitSourceFile(compileRequest, shaderLibUnit, shaderLibPath.Buffer());
             return compileRequest;
         }
+        // hash of a shader file and the modules it imports. modules named by IMPORT_MODULE_ macros are
+        // specialization arguments, they do not affect the reflected types of the file.
+        uint64_t GetSourceHash(String fileName)
+        {
+            uint64_t hash = 0;
+            if (sourceHashes.TryGetValue(fileName, hash))
+                return hash;
+            // guards against import cycles
+            sourceHashes[fileName] = 0;
+            auto path = Engine::Instance()->FindFile(fileName, ResourceType::Shader);
+            if (path.Length() == 0)
+                hash = ComputeHash64(fileName);
+            else
+            {
+                auto source = File::ReadAllText(path);
+                hash = ComputeHash64(source);
+                for (auto & line : CoreLib::Text::Split(source, '\n'))
+                {
+                    auto trimmedLine = line.TrimStart().TrimEnd();
+                    if (!trimmedLine.StartsWith("import ") || !trimmedLine.EndsWith(";"))
+                        continue;
+                    auto moduleName = trimmedLine.SubString(7, trimmedLine.Length() - 8).Trim();
+                    if (moduleName.StartsWith("IMPORT_MODULE_"))
+                        continue;
+                    auto moduleHash = GetSourceHash(moduleName + ".slang");
+                    hash = ComputeHash64(&moduleHash, sizeof(moduleHash), hash);
+                }
+            }
+            sourceHashes[fileName] = hash;
+            return hash;
+        }
         virtual ShaderTypeSymbol* LoadTypeSymbol(CoreLib::String fileName, CoreLib::String TypeName) override
         {
-            sb.Clear();
-            sb << fileName << "/" << TypeName;
-            auto str = sb.ProduceString();
+            String str;
+            uint64_t sourceHash;
             RefPtr<ShaderTypeSymbol> sym;
-            if (shaderTypeSymbols.TryGetValue(str, sym))
-                return sym.Ptr();
-            sym = new ShaderTypeSymbol();
-            sym->FileName = fileName;
-            sym->TypeId = shaderTypeSymbols.Count();
-            sym->TypeName = TypeName;
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                sb.Clear();
+                sb << fileName << "/" << TypeName;
+                str = sb.ProduceString();
+                if (shaderTypeSymbols.TryGetValue(str, sym))
+                    return sym.Ptr();
+                sym = new ShaderTypeSymbol();
+                sym->FileName = fileName;
+                sym->TypeName = TypeName;
+                // reflection requests always include ShaderLib, and the layout depends on the code generation target
+                sourceHash = GetSourceHash(fileName);
+                uint64_t libHash = GetSourceHash("ShaderLib.slang");
+                int target = GetSlangTarget();
+                sourceHash = ComputeHash64(&libHash, sizeof(libHash), sourceHash);
+                sourceHash = ComputeHash64(&target, sizeof(target), sourceHash);
+                if (cache.TryGetTypeSymbol(str, sourceHash, *sym))
+                {
+                    sym->TypeId = shaderTypeSymbols.Count();
+                    shaderTypeSymbols[str] = sym;
+                    return sym.Ptr();
+                }
+            }
+            // reflecting the type needs the slang session, another thread may have loaded it in the meantime
+            std::lock_guard<std::mutex> lock(compilerMutex);
+            {
+                std::lock_guard<std::mutex> symbolLock(cacheMutex);
+                RefPtr<ShaderTypeSymbol> loadedSym;
+                if (shaderTypeSymbols.TryGetValue(str, loadedSym))
+                    return loadedSym.Ptr();
+            }
             SlangCompileRequest* compileRequest = nullptr;
             if (!reflectionCompileRequests.TryGetValue(fileName, compileRequest))
             {
@@ -588,11 +629,15 @@ namespace GameEngine
                 sa.Name = attrib->getName();
                 sym->Attributes.Add(sa.Name, sa);
             }
+            std::lock_guard<std::mutex> symbolLock(cacheMutex);
+            cache.UpdateTypeSymbol(str, sourceHash, *sym);
+            sym->TypeId = shaderTypeSymbols.Count();
             shaderTypeSymbols[str] = sym;
             return sym.Ptr();
         }
         virtual ShaderEntryPoint* LoadShaderEntryPoint(CoreLib::String fileName, CoreLib::String functionName) override
         {
+            std::lock_guard<std::mutex> lock(cacheMutex);
             sb.Clear();
             sb << fileName << "/" << functionName;
             auto str = sb.ProduceString();
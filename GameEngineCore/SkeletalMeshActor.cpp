@@ -9,11 +9,25 @@ namespace GameEngine
 		if (physInstance)
 		{
 			Bounds.Init();
-			for (auto & obj : physInstance->objects)
-				Bounds.Union(obj->GetBounds());
+			if (physInstance->compound)
+				Bounds = physInstance->compound->GetBounds();
+			else
+			{
+				for (auto & obj : physInstance->objects)
+					Bounds.Union(obj->GetBounds());
+			}
+			BoundsChanged();
 		}
 	}
 
+	void SkeletalMeshActor::UpdatePalette()
+	{
+		if (paletteValid || !model)
+			return;
+		palette.Update(model->GetSkeleton(), nextPose, disableRetargetFile ? nullptr : retargetFile);
+		paletteValid = true;
+	}
+
 	void SkeletalMeshActor::UpdateStates()
 	{
 		if (model)
@@ -24,7 +38,10 @@ namespace GameEngine
 	void SkeletalMeshActor::LocalTransform_Changing(VectorMath::Matrix4 & newTransform)
 	{
 		if (physInstance)
-			physInstance->SetTransform(newTransform, nextPose, retargetFile);
+		{
+			UpdatePalette();
+			physInstance->SetTransform(newTransform, palette);
+		}
 		if (errorPhysInstance)
 			errorPhysInstance->SetTransform(newTransform);
 	}
@@ -80,17 +97,20 @@ namespace GameEngine
 			}
 			disableRetargetFile = true;
 		}
+		paletteValid = false;
+		UpdatePalette();
 		if (physInstance)
+			physInstance->SetTransform(*LocalTransform, palette);
+		bool useErrorModel = !model || nextPose.Transforms.Count() == 0;
+		if (useErrorModel != (errorPhysInstance != nullptr))
 		{
-			physInstance->SetTransform(*LocalTransform, nextPose, disableRetargetFile ? nullptr : retargetFile);
-		}
-		if ((!model || nextPose.Transforms.Count() == 0) && !errorPhysInstance)
-		{
-			errorPhysInstance = level->LoadErrorModel()->CreatePhysicsInstance(level->GetPhysicsScene(), this, nullptr);
-		}
-		else
-		{
-			errorPhysInstance = nullptr;
+			// skeletal meshes tick in parallel, the error model and the physics scene are shared
+			static std::mutex errorModelMutex;
+			std::lock_guard<std::mutex> lock(errorModelMutex);
+			if (useErrorModel)
+				errorPhysInstance = level->LoadErrorModel()->CreatePhysicsInstance(level->GetPhysicsScene(), this, nullptr);
+			else
+				errorPhysInstance = nullptr;
 		}
         if (errorPhysInstance)
             errorPhysInstance->SetTransform(*LocalTransform);
@@ -105,6 +125,7 @@ namespace GameEngine
     void SkeletalMeshActor::SetPose(const Pose & p)
     {
         nextPose = p;
+        paletteValid = false;
     }
 
     VectorMath::Vec3 SkeletalMeshActor::GetRootPosition()
@@ -231,9 +252,8 @@ namespace GameEngine
             }
         }
         auto blendShapeWeightsView = blendShapeWeights.GetArrayView();
-		modelInstance.UpdateTransformUniform(*LocalTransform, nextPose,
-			disableRetargetFile ? nullptr : retargetFile, 
-			hasBlendShape ? &blendShapeWeightsView : nullptr);
+		UpdatePalette();
+		modelInstance.UpdateTransformUniform(*LocalTransform, palette, hasBlendShape ? &blendShapeWeightsView : nullptr);
         AddDrawable(params, &modelInstance);
 	}
 
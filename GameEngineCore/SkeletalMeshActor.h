@@ -13,6 +13,9 @@ namespace GameEngine
 	{
 	private:
 		Pose nextPose;
+		// skinning matrices of nextPose, shared by the drawables and the physics instance
+		SkinningPalette palette;
+		bool paletteValid = false;
         CoreLib::List<BlendShapeWeightInfo> blendShapeWeights;
 		CoreLib::RefPtr<ModelPhysicsInstance> physInstance, errorPhysInstance;
 		ModelDrawableInstance modelInstance, errorModelInstance;
@@ -21,6 +24,7 @@ namespace GameEngine
 		RetargetFile * retargetFile = nullptr;
 	protected:
 		void UpdateBounds();
+		void UpdatePalette();
 		void UpdateStates();
 		void LocalTransform_Changing(VectorMath::Matrix4 & newTransform);
 		void ModelFileName_Changing(CoreLib::String & newFileName);
@@ -33,6 +37,14 @@ namespace GameEngine
         VectorMath::Vec3 GetRootOrientation();
         VectorMath::Matrix4 GetRootTransform();
 		virtual void Tick() override;
+		virtual TickPhase GetTickPhase() override
+		{
+			return TickPhase::Animation;
+		}
+		virtual bool CanTickInParallel() override
+		{
+			return true;
+		}
 		Model * GetModel()
 		{
 			return model;
@@ -380,4 +380,16 @@ namespace GameEngine
 			}
 		}
 	}
+
+	void SkinningPalette::Update(const Skeleton * skeleton, const Pose & pose, RetargetFile * retarget)
+	{
+		pose.GetMatrices(skeleton, Matrices, true, retarget);
+		DualQuaternions.SetSize(Matrices.Count());
+		for (int i = 0; i < Matrices.Count(); i++)
+		{
+			auto & m = Matrices[i];
+			DualQuaternions[i].FromRotationTranslation(VectorMath::Quaternion::FromMatrix(m.GetMatrix3()),
+				VectorMath::Vec3::Create(m.values[12], m.values[13], m.values[14]));
+		}
+	}
 }
@@ -159,6 +159,16 @@ namespace GameEngine
 		void GetMatrices(const Skeleton * skeleton, CoreLib::List<VectorMath::Matrix4> & matrices, bool multiplyInversePose = true, RetargetFile * retarget = nullptr) const;
 	};
 
+	// skinning matrices of a pose, evaluated once and shared by all drawables and physics objects of a skeletal instance.
+	// the lists keep their capacity between updates.
+	class SkinningPalette
+	{
+	public:
+		CoreLib::List<VectorMath::Matrix4> Matrices;
+		CoreLib::List<VectorMath::DualQuaternion> DualQuaternions;
+		void Update(const Skeleton * skeleton, const Pose & pose, RetargetFile * retarget = nullptr);
+	};
+
 	class AnimationKeyFrame
 	{
 	public:
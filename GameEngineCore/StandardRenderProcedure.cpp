@@ -7,12 +7,14 @@
 #include "AtmosphereActor.h"
 #include "ToneMappingActor.h"
 #include "FrustumCulling.h"
+#include "OcclusionCulling.h"
 #include "RenderProcedure.h"
 #include "StandardViewUniforms.h"
 #include "LightingData.h"
 #include "BuildHistogram.h"
 #include "EyeAdaptation.h"
 #include "SSAOActor.h"
+#include "RenderGraph.h"
 
 using namespace VectorMath;
 
@@ -69,16 +71,56 @@ namespace GameEngine
         RefPtr<RenderTarget> aoRenderTarget, aoBlurTarget;
         RefPtr<Buffer> randomDirectionBuffer;
 
+        // the render graph is rebuilt when the set of passes or the view size changes
+        struct RenderGraphConfig
+        {
+            bool outline = false, ssao = false, atmosphere = false;
+            int width = 0, height = 0;
+            bool operator == (const RenderGraphConfig & other) const
+            {
+                return outline == other.outline && ssao == other.ssao && atmosphere == other.atmosphere &&
+                    width == other.width && height == other.height;
+            }
+        };
+        struct RenderGraphPasses
+        {
+            int customDepth = -1, preZ = -1, preZTransparent = -1, ssao = -1, ssaoBlurX = -1, ssaoBlurY = -1,
+                lightList = -1, forward = -1, debugGraphics = -1, ssaoComposite = -1, atmosphere = -1, transparent = -1,
+                clearHistogram = -1, buildHistogram = -1, eyeAdaptation = -1, toneMapping = -1, outline = -1;
+        };
+        RenderGraph renderGraph;
+        RenderGraphConfig renderGraphConfig;
+        RenderGraphPasses graphPasses;
+        bool renderGraphCompiled = false;
+        List<String> transientTargets;
+
         DeviceMemory renderPassUniformMemory;
         SharedModuleInstances sharedModules;
         ModuleInstance viewParams;
         CoreLib::List<ModuleInstance> shadowViewInstances;
 
-        DrawableSink sink;
+        struct FrameSnapshot
+        {
+            DrawableSink sink;
+            List<Drawable*> debugDrawables;
+            LightingSnapshot lighting;
+            bool useAtmosphere = false;
+            AtmosphereParameters atmosphereParams;
+            ToneMappingParameters toneMappingParameters;
+            EyeAdaptationUniforms eyeAdaptationUniforms;
+            bool ssaoEnabled = false;
+            SSAOUniforms ssaoUniforms = {};
+        };
+        FrameSnapshot snapshots[RenderFrameSnapshotCount];
+        CoreLib::List<CoreLib::Graphics::BBox> shadowLightRegions;
 
         List<Drawable*> reorderBuffer, drawableBuffer;
+        DrawableSorter transparentSorter;
         LightingEnvironment lighting;
-        AtmosphereParameters lastAtmosphereParams;
+        OcclusionCuller occlusionCuller;
+        CullMask occlusionCullMask;
+        AtmosphereParameters lastAtmosphereParams, extractedAtmosphereParams;
+        DeviceLightmapSet * retainedLightmapSet = nullptr;
         ToneMappingParameters lastToneMappingParams;
         bool useAtmosphere = false;
         bool postProcess = false;
@@ -208,9 +250,6 @@ namespace GameEngine
 
             if (postProcess)
             {
-                aoRenderTarget = viewRes->LoadSharedRenderTarget("ao", StorageFormat::RG_8, 1.0f, 1024, 1024, true);
-                aoBlurTarget = viewRes->LoadSharedRenderTarget("aoBlur", StorageFormat::RG_8, 1.0f, 1024, 1024, true);
-
                 toneMappingFromAtmospherePass = CreateToneMappingPostRenderPass(viewRes);
                 toneMappingFromAtmospherePass->SetSource(MakeArray(
                     PostPassSource("litAtmosphereColor", StorageFormat::RGBA_F16),
@@ -268,65 +307,370 @@ namespace GameEngine
             lightListBuildingComputeTaskInstance = renderer->GetComputeTaskManager()->CreateComputeTaskInstance(lightListBuildingComputeKernel,
                 sizeof(BuildTiledLightListUniforms), true);
         }
+        bool IsPassLive(int pass)
+        {
+            return pass != -1 && renderGraph.IsPassLive(pass);
+        }
+
+        void UpdateRenderGraph(HardwareRenderer * hardwareRenderer, const RenderGraphConfig & config)
+        {
+            if (renderGraphCompiled && renderGraphConfig == config)
+                return;
+            renderGraphCompiled = true;
+            renderGraphConfig = config;
+            int w = config.width, h = config.height;
+            auto & graph = renderGraph;
+            graph.Clear();
+            graphPasses = RenderGraphPasses();
+            // the targets below are imported: post passes and render outputs bind them by name at Init, GetOutput hands one of them
+            // to the view, and none of them could share a texture anyway. each pair of the same format overlaps at the pass that
+            // turns one into the other (litColor and litAtmosphereColor at Atmosphere, toneColor and editorColor at EditorOutline,
+            // depthBufferPreZTransparent is alive within depthBuffer). only the ao ping-pong targets are transient, and they
+            // overlap as well, so the graph currently saves no memory, it only releases ao when SSAO is off.
+            int litColor = graph.AddTexture("litColor", RenderGraphTextureDesc(StorageFormat::RGBA_F16, w, h), false);
+            int litAtmosphereColor = graph.AddTexture("litAtmosphereColor", RenderGraphTextureDesc(StorageFormat::RGBA_F16, w, h), false);
+            int depthBuffer = graph.AddTexture("depthBuffer", RenderGraphTextureDesc(DepthBufferFormat, w, h), false);
+            int depthBufferPreZTransparent = graph.AddTexture("depthBufferPreZTransparent", RenderGraphTextureDesc(DepthBufferFormat, w, h), false);
+            // custom depth is shared with other procedures of the view, it is not released when this procedure does not need it
+            int customDepthBuffer = graph.AddTexture("customDepthBuffer", RenderGraphTextureDesc(DepthBufferFormat, w, h), false);
+            int toneColor = graph.AddTexture("toneColor", RenderGraphTextureDesc(StorageFormat::RGBA_8, w, h), false);
+            int editorColor = graph.AddTexture("editorColor", RenderGraphTextureDesc(StorageFormat::RGBA_8, w, h), false);
+            int ao = graph.AddTexture("ao", RenderGraphTextureDesc(StorageFormat::RG_8, w, h), true);
+            int aoBlur = graph.AddTexture("aoBlur", RenderGraphTextureDesc(StorageFormat::RG_8, w, h), true);
+            int tiledLightList = graph.AddBuffer("tiledLightList");
+            int histogram = graph.AddBuffer("histogram");
+            int adaptedLuminance = graph.AddBuffer("adaptedLuminance");
+
+            auto & passes = graphPasses;
+            passes.customDepth = graph.AddPass("CustomDepth");
+            graph.Write(passes.customDepth, customDepthBuffer);
+            passes.preZ = graph.AddPass("PreZ");
+            graph.Write(passes.preZ, depthBuffer);
+            passes.preZTransparent = graph.AddPass("PreZTransparent");
+            graph.Write(passes.preZTransparent, depthBufferPreZTransparent);
+            if (config.ssao)
+            {
+                passes.ssao = graph.AddPass("SSAO");
+                graph.Read(passes.ssao, depthBuffer);
+                graph.Write(passes.ssao, ao, RenderGraphAccess::WriteStorage);
+                passes.ssaoBlurX = graph.AddPass("SSAOBlurX");
+                graph.Read(passes.ssaoBlurX, ao);
+                graph.Write(passes.ssaoBlurX, aoBlur, RenderGraphAccess::WriteStorage);
+                passes.ssaoBlurY = graph.AddPass("SSAOBlurY");
+                graph.Read(passes.ssaoBlurY, aoBlur);
+                graph.Write(passes.ssaoBlurY, ao, RenderGraphAccess::WriteStorage);
+            }
+            passes.lightList = graph.AddPass("TiledLightList");
+            graph.Read(passes.lightList, depthBuffer);
+            graph.Read(passes.lightList, depthBufferPreZTransparent);
+            graph.Write(passes.lightList, tiledLightList, RenderGraphAccess::WriteStorage);
+            passes.forward = graph.AddPass("ForwardBase");
+            graph.Read(passes.forward, tiledLightList);
+            graph.Read(passes.forward, depthBuffer);
+            graph.Write(passes.forward, litColor);
+            graph.Write(passes.forward, depthBuffer);
+            passes.debugGraphics = graph.AddPass("DebugGraphics");
+            graph.Write(passes.debugGraphics, litColor);
+            graph.Write(passes.debugGraphics, depthBuffer);
+            if (config.ssao)
+            {
+                passes.ssaoComposite = graph.AddPass("SSAOComposite");
+                graph.Read(passes.ssaoComposite, ao);
+                graph.Read(passes.ssaoComposite, litColor);
+                graph.Write(passes.ssaoComposite, litColor, RenderGraphAccess::WriteStorage);
+            }
+            int lightingOutput = litColor;
+            if (config.atmosphere)
+            {
+                passes.atmosphere = graph.AddPass("Atmosphere");
+                graph.Read(passes.atmosphere, litColor);
+                graph.Read(passes.atmosphere, depthBuffer);
+                graph.Write(passes.atmosphere, litAtmosphereColor);
+                lightingOutput = litAtmosphereColor;
+            }
+            passes.transparent = graph.AddPass("Transparent");
+            graph.Read(passes.transparent, lightingOutput);
+            graph.Read(passes.transparent, depthBuffer);
+            graph.Write(passes.transparent, lightingOutput);
+            graph.Write(passes.transparent, depthBuffer);
+            if (postProcess)
+            {
+                passes.clearHistogram = graph.AddPass("ClearHistogram");
+                graph.Write(passes.clearHistogram, histogram, RenderGraphAccess::WriteStorage);
+                passes.buildHistogram = graph.AddPass("BuildHistogram");
+                graph.Read(passes.buildHistogram, lightingOutput);
+                graph.Read(passes.buildHistogram, histogram);
+                graph.Write(passes.buildHistogram, histogram, RenderGraphAccess::WriteStorage);
+                passes.eyeAdaptation = graph.AddPass("EyeAdaptation");
+                graph.Read(passes.eyeAdaptation, histogram);
+                graph.Write(passes.eyeAdaptation, adaptedLuminance, RenderGraphAccess::WriteStorage);
+                passes.toneMapping = graph.AddPass("ToneMapping");
+                graph.Read(passes.toneMapping, lightingOutput);
+                graph.Read(passes.toneMapping, adaptedLuminance);
+                graph.Write(passes.toneMapping, toneColor);
+                graph.MarkOutput(adaptedLuminance);
+                if (config.outline)
+                {
+                    passes.outline = graph.AddPass("EditorOutline");
+                    graph.Read(passes.outline, toneColor);
+                    graph.Read(passes.outline, customDepthBuffer);
+                    graph.Write(passes.outline, editorColor);
+                    graph.MarkOutput(editorColor);
+                }
+                else
+                    graph.MarkOutput(toneColor);
+            }
+            else
+                graph.MarkOutput(lightingOutput);
+            graph.Compile();
+
+            // create the physical textures of transient render targets and release the ones no longer used
+            List<String> newTransientTargets;
+            for (int i = 0; i < graph.GetPhysicalTextureCount(); i++)
+                newTransientTargets.Add(graph.GetPhysicalTexture(i).Name);
+            aoRenderTarget = nullptr;
+            aoBlurTarget = nullptr;
+            bool deviceIdle = false;
+            for (auto & name : transientTargets)
+            {
+                if (newTransientTargets.Contains(name))
+                    continue;
+                if (!deviceIdle)
+                {
+                    hardwareRenderer->Wait();
+                    deviceIdle = true;
+                }
+                viewRes->UnloadSharedRenderTarget(name);
+            }
+            transientTargets = _Move(newTransientTargets);
+            // all transient render targets are written by compute passes
+            auto loadTransientTarget = [&](int resource, StorageFormat format)
+            {
+                auto name = graph.GetPhysicalTextureName(resource);
+                if (name.Length() == 0)
+                    return RefPtr<RenderTarget>();
+                return viewRes->LoadSharedRenderTarget(name, format, 1.0f, 1024, 1024, true);
+            };
+            aoRenderTarget = loadTransientTarget(ao, StorageFormat::RG_8);
+            aoBlurTarget = loadTransientTarget(aoBlur, StorageFormat::RG_8);
+        }
+
         enum class PassType
         {
             Shadow, CustomDepth, Main, Transparent
         };
 
-        ArrayView<Drawable*> GetDrawable(DrawableSink * objSink, PassType pass, CullFrustum cf, bool append)
+        // cullMask holds one bit per drawable of objSink, opaque drawables first
+        ArrayView<Drawable*> GetDrawable(DrawableSink * objSink, PassType pass, const CullMask & cullMask, bool append)
         {
             if (!append)
                 drawableBuffer.Clear();
+            int transparentStart = objSink->GetDrawables(false).Count();
+            int boxId = pass == PassType::Transparent ? transparentStart : 0;
             for (auto obj : objSink->GetDrawables(pass == PassType::Transparent))
             {
+                int id = boxId++;
                 if (pass == PassType::Shadow && !obj->CastShadow)
                     continue;
                 if (pass == PassType::CustomDepth && !obj->RenderCustomDepth)
                     continue;
-                if (cf.IsBoxInFrustum(obj->Bounds))
+                if (cullMask.IsVisible(id))
                     drawableBuffer.Add(obj);
             }
             if (pass == PassType::CustomDepth)
             {
+                boxId = transparentStart;
                 for (auto obj : objSink->GetDrawables(true))
                 {
+                    int id = boxId++;
                     if (!obj->RenderCustomDepth)
                         continue;
-                    if (cf.IsBoxInFrustum(obj->Bounds))
+                    if (cullMask.IsVisible(id))
                         drawableBuffer.Add(obj);
                 }
             }
             return drawableBuffer.GetArrayView();
         }
 
+        virtual bool Extract(const RenderProcedureParameters & params) override
+        {
+            auto & snapshot = snapshots[params.snapshotId];
+            GetDrawablesParameter getDrawableParam;
+            getDrawableParam.CameraPos = params.view.Position;
+            getDrawableParam.CameraDir = params.view.GetDirection();
+            getDrawableParam.IsEditorMode = params.isEditorMode;
+            getDrawableParam.rendererService = params.rendererService;
+            getDrawableParam.sink = &snapshot.sink;
+
+            auto & sink = snapshot.sink;
+            sink.Clear();
+            snapshot.useAtmosphere = false;
+            snapshot.ssaoEnabled = false;
+            snapshot.toneMappingParameters = ToneMappingParameters();
+            snapshot.eyeAdaptationUniforms = EyeAdaptationUniforms();
+
+            LightingEnvironment::GatherSnapshot(params.level, snapshot.lighting);
+
+            // only visit actors that can be seen by the camera or can cast a shadow into the view
+            int outputWidth = 0, outputHeight = 0;
+            forwardBaseOutput->GetSize(outputWidth, outputHeight);
+            auto cameraFrustum = params.view.GetFrustum(outputWidth / (float)Math::Max(1, outputHeight));
+            auto cameraCullFrustum = CullFrustum(cameraFrustum);
+            auto & lightingSnapshot = snapshot.lighting;
+            CoreLib::Graphics::BBox sunShadowRegion;
+            sunShadowRegion.Init();
+            if (lightingSnapshot.sunLightEnabled)
+            {
+                // receivers within shadow distance, swept towards the sun across the level.
+                // cascades cover more than the view, and their cached static layers need every caster the cascades cover.
+                auto contentSize = (lightingSnapshot.levelBounds.Max - lightingSnapshot.levelBounds.Min).Length();
+                auto verts = cameraFrustum.GetVertices(params.view.ZNear, Math::Min(params.view.ZFar, lightingSnapshot.shadowDistance));
+                CoreLib::Graphics::BBox receiverBounds;
+                receiverBounds.Init();
+                for (auto & v : verts)
+                    receiverBounds.Union(v);
+                auto margin = Vec3::Create((receiverBounds.Max - receiverBounds.Min).Length() * 0.5625f);
+                receiverBounds.Min -= margin;
+                receiverBounds.Max += margin;
+                for (int i = 0; i < 8; i++)
+                {
+                    auto v = Vec3::Create((i & 1) ? receiverBounds.Max.x : receiverBounds.Min.x,
+                        (i & 2) ? receiverBounds.Max.y : receiverBounds.Min.y,
+                        (i & 4) ? receiverBounds.Max.z : receiverBounds.Min.z);
+                    sunShadowRegion.Union(v);
+                    sunShadowRegion.Union(v + lightingSnapshot.sunLightDir * contentSize);
+                }
+            }
+            // lights outside of the view are culled by the lighting environment and render no shadows
+            shadowLightRegions.Clear();
+            bool hasUnboundedShadowLight = false;
+            for (auto & light : lightingSnapshot.lights)
+            {
+                if (light.shaderMapId != 0xFFFF)
+                {
+                    // radius 0 means unlimited range, such a light may cast shadows of anything
+                    if (light.radius <= 0.0f)
+                    {
+                        hasUnboundedShadowLight = true;
+                        continue;
+                    }
+                    CoreLib::Graphics::BBox lightBounds;
+                    lightBounds.Min = light.position - Vec3::Create(light.radius);
+                    lightBounds.Max = light.position + Vec3::Create(light.radius);
+                    if (cameraCullFrustum.IsBoxInFrustum(lightBounds))
+                        shadowLightRegions.Add(lightBounds);
+                }
+            }
+            auto mayBeVisible = [&](const CoreLib::Graphics::BBox & bounds)
+            {
+                if (hasUnboundedShadowLight || cameraCullFrustum.IsBoxInFrustum(bounds) || sunShadowRegion.Intersects(bounds))
+                    return true;
+                for (auto & region : shadowLightRegions)
+                    if (region.Intersects(bounds))
+                        return true;
+                return false;
+            };
+            // retained drawables carry the lightmap index assigned when they were collected
+            if (lighting.deviceLightmapSet != retainedLightmapSet)
+            {
+                for (auto & actor : params.level->Actors)
+                    actor.Value->InvalidateDrawables();
+                retainedLightmapSet = lighting.deviceLightmapSet;
+            }
+            auto extractActor = [&](Actor * actor)
+            {
+                int lastTransparentDrawableCount = sink.GetDrawables(true).Count();
+                int lastOpaqueDrawableCount = sink.GetDrawables(false).Count();
+
+                // obtain drawables from actor, if a LightmapSet is available update the lightmapIndex uniform parameter
+                // of newly collected drawables (do a CPU--GPU memory transfer if needed)
+                if (actor->CollectDrawables(getDrawableParam) && lighting.deviceLightmapSet)
+                {
+                    uint32_t lightmapIndex = lighting.deviceLightmapSet->GetDeviceLightmapId(actor);
+                    auto transparentDrawables = sink.GetDrawables(true);
+                    for (int i = lastTransparentDrawableCount; i < transparentDrawables.Count(); i++)
+                    {
+                        transparentDrawables.Buffer()[i]->UpdateLightmapIndex(lightmapIndex);
+                    }
+                    auto opaqueDrawables = sink.GetDrawables(false);
+                    for (int i = lastOpaqueDrawableCount; i < opaqueDrawables.Count(); i++)
+                    {
+                        opaqueDrawables.Buffer()[i]->UpdateLightmapIndex(lightmapIndex);
+                    }
+                }
+            };
+            params.level->QueryActors(mayBeVisible, extractActor);
+            LightingEnvironment::GatherStaticContentChanges(params.level, snapshot.lighting);
+
+            // environment actors are looked up by type, the level keeps them in per-type lists
+            for (auto actor : params.level->GetActorsOfType(EngineActorType::Atmosphere))
+            {
+                snapshot.useAtmosphere = true;
+                auto atmosphere = static_cast<AtmosphereActor*>(actor);
+                auto newParams = atmosphere->GetParameters();
+                if (!(extractedAtmosphereParams == newParams))
+                {
+                    atmosphere->SunDir = atmosphere->SunDir.GetValue().Normalize();
+                    newParams = atmosphere->GetParameters();
+                    extractedAtmosphereParams = newParams;
+                }
+                snapshot.atmosphereParams = newParams;
+            }
+            if (postProcess)
+            {
+                for (auto actor : params.level->GetActorsOfType(EngineActorType::ToneMapping))
+                {
+                    auto toneMappingActor = static_cast<ToneMappingActor*>(actor);
+                    snapshot.toneMappingParameters = toneMappingActor->GetToneMappingParameters();
+                    snapshot.eyeAdaptationUniforms = toneMappingActor->GetEyeAdaptationParameters();
+                }
+                for (auto actor : params.level->GetActorsOfType(EngineActorType::SSAO))
+                {
+                    snapshot.ssaoUniforms = static_cast<SSAOActor*>(actor)->GetParameters();
+                    snapshot.ssaoEnabled = true;
+                }
+            }
+            snapshot.debugDrawables.Clear();
+            snapshot.debugDrawables.AddRange(Engine::GetDebugGraphics()->GetDrawables(params.rendererService));
+            return true;
+        }
+
         virtual void Run(const RenderProcedureParameters & params) override
         {
-            bool ssaoEnabled = false;
-            SSAOUniforms ssaoUniforms = {};
+            auto & snapshot = snapshots[params.snapshotId];
+            auto & sink = snapshot.sink;
+            bool ssaoEnabled = snapshot.ssaoEnabled;
+            SSAOUniforms ssaoUniforms = snapshot.ssaoUniforms;
 
             int w = 0, h = 0;
             auto hardwareRenderer = params.renderer->GetHardwareRenderer();
+            forwardBaseOutput->GetSize(w, h);
+            RenderGraphConfig graphConfig;
+            graphConfig.outline = postProcess && params.isEditorMode && editorOutlinePass != nullptr;
+            graphConfig.ssao = ssaoEnabled;
+            graphConfig.atmosphere = snapshot.useAtmosphere;
+            graphConfig.width = w;
+            graphConfig.height = h;
+            UpdateRenderGraph(hardwareRenderer, graphConfig);
+            params.renderStats->TransientMemory += renderGraph.GetTransientMemory();
             hardwareRenderer->BeginJobSubmission();
 
             forwardRenderPass->ResetInstancePool();
-            forwardBaseOutput->GetSize(w, h);
             forwardBaseInstance = forwardRenderPass->CreateInstance(forwardBaseOutput, true);
 
             debugGraphicsRenderPass->ResetInstancePool();
             debugGraphicsPassInstance = debugGraphicsRenderPass->CreateInstance(forwardBaseOutput, false);
 
             customDepthRenderPass->ResetInstancePool();
-            customDepthPassInstance = customDepthRenderPass->CreateInstance(customDepthOutput, true);
+            if (IsPassLive(graphPasses.customDepth))
+                customDepthPassInstance = customDepthRenderPass->CreateInstance(customDepthOutput, true);
             preZPassInstance = customDepthRenderPass->CreateInstance(preZOutput, true);
             preZPassTransparentInstance = customDepthRenderPass->CreateInstance(preZTransparentOutput, true);
             float aspect = w / (float)h;
             shadowRenderPass->ResetInstancePool();
 
-            GetDrawablesParameter getDrawableParam;
             viewUniform.CameraPos = params.view.Position;
             viewUniform.ViewTransform = params.view.Transform;
-            getDrawableParam.CameraDir = params.view.GetDirection();
-            getDrawableParam.IsEditorMode = params.isEditorMode;
             Matrix4 mainProjMatrix;
             Matrix4::CreatePerspectiveMatrixFromViewAngle(mainProjMatrix,
                 params.view.FOV, w / (float)h,
@@ -337,80 +681,23 @@ namespace GameEngine
 
             viewUniform.ViewTransform.Inverse(viewUniform.InvViewTransform);
             viewUniform.ViewProjectionTransform.Inverse(viewUniform.InvViewProjTransform);
-            viewUniform.Time = Engine::Instance()->GetTime();
-
-            getDrawableParam.CameraPos = viewUniform.CameraPos;
-            getDrawableParam.rendererService = params.rendererService;
-            getDrawableParam.sink = &sink;
-
-            useAtmosphere = false;
-            sink.Clear();
+            viewUniform.Time = params.time;
 
-            CoreLib::Graphics::BBox levelBounds;
-            // initialize bounds to a small extent to prevent error
-            levelBounds.Min = Vec3::Create(-10.0f);
-            levelBounds.Max = Vec3::Create(10.0f);
-            ToneMappingParameters toneMappingParameters;
-            EyeAdaptationUniforms eyeAdaptationUniforms;
-            
-            for (auto & actor : params.level->Actors)
+            useAtmosphere = snapshot.useAtmosphere;
+            if (useAtmosphere && !(lastAtmosphereParams == snapshot.atmosphereParams))
             {
-                levelBounds.Union(actor.Value->Bounds);
-                int lastTransparentDrawableCount = sink.GetDrawables(true).Count();
-                int lastOpaqueDrawableCount = sink.GetDrawables(false).Count();
-
-                // obtain drawables from actor
-                actor.Value->GetDrawables(getDrawableParam);
-
-                // if a LightmapSet is available, update drawable's lightmapIndex uniform parameter (do a CPU--GPU memory transfer if needed)
-                if (lighting.deviceLightmapSet)
-                {
-                    uint32_t lightmapIndex = lighting.deviceLightmapSet->GetDeviceLightmapId(actor.Value.Ptr());
-                    auto transparentDrawables = sink.GetDrawables(true);
-                    for (int i = lastTransparentDrawableCount; i < transparentDrawables.Count(); i++)
-                    {
-                        transparentDrawables.Buffer()[i]->UpdateLightmapIndex(lightmapIndex);
-                    }
-                    auto opaqueDrawables = sink.GetDrawables(false);
-                    for (int i = lastOpaqueDrawableCount; i < opaqueDrawables.Count(); i++)
-                    {
-                        opaqueDrawables.Buffer()[i]->UpdateLightmapIndex(lightmapIndex);
-                    }
-                }
-
-                auto actorType = actor.Value->GetEngineType();
-                if (actorType == EngineActorType::Atmosphere)
-                {
-                    useAtmosphere = true;
-                    auto atmosphere = dynamic_cast<AtmosphereActor*>(actor.Value.Ptr());
-                    auto newParams = atmosphere->GetParameters();
-                    if (!(lastAtmosphereParams == newParams))
-                    {
-                        atmosphere->SunDir = atmosphere->SunDir.GetValue().Normalize();
-                        newParams = atmosphere->GetParameters();
-                        atmospherePass->SetParameters(&newParams, sizeof(newParams));
-                        lastAtmosphereParams = newParams;
-                    }
-                }
-                else if (postProcess && actorType == EngineActorType::ToneMapping)
-                {
-                    auto toneMappingActor = dynamic_cast<ToneMappingActor*>(actor.Value.Ptr());
-                    toneMappingParameters = toneMappingActor->GetToneMappingParameters();
-                    eyeAdaptationUniforms = toneMappingActor->GetEyeAdaptationParameters();
-                }
-                else if (postProcess && actorType == EngineActorType::SSAO)
-                {
-                    ssaoUniforms = dynamic_cast<SSAOActor*>(actor.Value.Ptr())->GetParameters();
-                    ssaoEnabled = true;
-                }
+                atmospherePass->SetParameters(&snapshot.atmosphereParams, sizeof(snapshot.atmosphereParams));
+                lastAtmosphereParams = snapshot.atmosphereParams;
             }
+            ToneMappingParameters toneMappingParameters = snapshot.toneMappingParameters;
+            EyeAdaptationUniforms eyeAdaptationUniforms = snapshot.eyeAdaptationUniforms;
             if (postProcess)
             {
                 eyeAdaptationUniforms.height = h;
                 eyeAdaptationUniforms.width = w;
                 eyeAdaptationUniforms.histogramSize = histogramSize;
-                eyeAdaptationUniforms.frameId = Engine::Instance()->GetFrameId();
-                eyeAdaptationUniforms.deltaTime = Engine::Instance()->GetTimeDelta(EngineThread::Rendering);
+                eyeAdaptationUniforms.frameId = params.frameId;
+                eyeAdaptationUniforms.deltaTime = params.timeDelta;
                 if (!(lastToneMappingParams == toneMappingParameters))
                 {
                     toneMappingFromAtmospherePass->SetParameters(&toneMappingParameters, sizeof(toneMappingParameters));
@@ -418,20 +705,32 @@ namespace GameEngine
                     lastToneMappingParams = toneMappingParameters;
                 }
             }
-            // collect light data and render shadow maps
-            lighting.GatherInfo(hardwareRenderer, &sink, params, w, h, viewUniform, shadowRenderPass.Ptr());
+            // collect light data and render shadow maps, culling the camera view along with the shadow views
+            auto cameraCullFrustum = CullFrustum(params.view.GetFrustum(aspect));
+            lighting.GatherInfo(hardwareRenderer, &sink, snapshot.lighting, params, w, h, viewUniform, shadowRenderPass.Ptr(), &cameraCullFrustum);
+            auto & cameraCullMask = lighting.cullMasks[0];
+
+            // drop drawables hidden behind large occluders from the main view, custom depth keeps the frustum mask
+            CullMask * mainViewCullMask = &cameraCullMask;
+            if (Engine::Instance()->GetGraphicsSettings().UseOcclusionCulling)
+            {
+                params.renderStats->NumOccludedDrawables += occlusionCuller.Cull(sink, cameraCullMask, viewUniform.ViewProjectionTransform,
+                    params.view.Position, aspect, occlusionCullMask);
+                mainViewCullMask = &occlusionCullMask;
+            }
 
             viewParams.SetUniformData(&viewUniform, (int)sizeof(viewUniform));
-            auto cameraCullFrustum = CullFrustum(params.view.GetFrustum(aspect));
 
-            // custom depth pass
+            // custom depth pass, culled when no pass reads custom depth
             Array<Texture*, 8> textures;
-            customDepthOutput->GetFrameBuffer()->GetRenderAttachments().GetTextures(textures);
-            customDepthRenderPass->Bind();
-            sharedRes->pipelineManager.PushModuleInstance(&viewParams);
-            customDepthPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::CustomDepth, cameraCullFrustum, false));
-            sharedRes->pipelineManager.PopModuleInstance();
-            customDepthPassInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
+            if (IsPassLive(graphPasses.customDepth))
+            {
+                customDepthRenderPass->Bind();
+                sharedRes->pipelineManager.PushModuleInstance(&viewParams);
+                customDepthPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::CustomDepth, cameraCullMask, false), params.view.Position);
+                sharedRes->pipelineManager.PopModuleInstance();
+                customDepthPassInstance->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.customDepth));
+            }
 
             // pre-z pass
             Array<Texture*, 2> prezTextures;
@@ -441,15 +740,15 @@ namespace GameEngine
             prezTextures.Add(textures[0]);
             customDepthRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
-            preZPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, cameraCullFrustum, false));
+            preZPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, *mainViewCullMask, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
-            preZPassTransparentInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Transparent, cameraCullFrustum, false));
+            preZPassTransparentInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Transparent, *mainViewCullMask, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
-            preZPassInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
-            preZPassTransparentInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
+            preZPassInstance->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.preZ));
+            preZPassTransparentInstance->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.preZTransparent));
 
-            if (ssaoEnabled)
+            if (IsPassLive(graphPasses.ssao))
             {
                 // ssao
                 Array<ResourceBinding, 3> ssaoBindings;
@@ -498,19 +797,18 @@ namespace GameEngine
             forwardRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
             sharedRes->pipelineManager.PushModuleInstance(&lighting.moduleInstance);
-            forwardBaseInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, cameraCullFrustum, false));
+            forwardBaseInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, GetDrawable(&sink, PassType::Main, *mainViewCullMask, false), params.view.Position);
             sharedRes->pipelineManager.PopModuleInstance();
             sharedRes->pipelineManager.PopModuleInstance();
-            forwardBaseInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
+            forwardBaseInstance->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.forward));
 
             debugGraphicsRenderPass->Bind();
             sharedRes->pipelineManager.PushModuleInstance(&viewParams);
-            debugGraphicsPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer,
-                Engine::GetDebugGraphics()->GetDrawables(Engine::Instance()->GetRenderer()->GetRendererService()));
+            debugGraphicsPassInstance->SetDrawContent(sharedRes->pipelineManager, reorderBuffer, snapshot.debugDrawables.GetArrayView());
             sharedRes->pipelineManager.PopModuleInstance();
-            debugGraphicsPassInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::None);
+            debugGraphicsPassInstance->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.debugGraphics));
 
-            if (ssaoEnabled)
+            if (IsPassLive(graphPasses.ssaoComposite))
             {
                 // composite AO with lit buffer
                 Array<ResourceBinding, 2> aoCompositeBindings;
@@ -522,17 +820,17 @@ namespace GameEngine
 
             if (useAtmosphere)
             {
-                atmospherePass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats);
+                atmospherePass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.atmosphere));
             }
             // transparency pass
             reorderBuffer.Clear();
-            for (auto drawable : GetDrawable(&sink, PassType::Transparent, cameraCullFrustum, false))
+            for (auto drawable : GetDrawable(&sink, PassType::Transparent, *mainViewCullMask, false))
             {
                 reorderBuffer.Add(drawable);
             }
             if (reorderBuffer.Count())
             {
-                reorderBuffer.Sort([=](Drawable* d1, Drawable* d2) { return d1->Bounds.Distance(params.view.Position) > d2->Bounds.Distance(params.view.Position); });
+                transparentSorter.SortBackToFront(reorderBuffer, params.view.Position);
                 if (useAtmosphere)
                 {
                     transparentPassInstance = forwardRenderPass->CreateInstance(transparentAtmosphereOutput, false);
@@ -551,7 +849,7 @@ namespace GameEngine
                 transparentPassInstance->SetFixedOrderDrawContent(sharedRes->pipelineManager, reorderBuffer.GetArrayView());
                 sharedRes->pipelineManager.PopModuleInstance();
                 sharedRes->pipelineManager.PopModuleInstance();
-                transparentPassInstance->Execute(hardwareRenderer, *params.renderStats, PipelineBarriers::MemoryAndImage);
+                transparentPassInstance->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.transparent));
             }
 
             if (postProcess)
@@ -581,16 +879,17 @@ namespace GameEngine
                 eyeAdaptationComputeTaskInstance->Queue(1, 1, 1);
 
                 // tone mapping with adapted luminance
+                auto toneMappingBarriers = renderGraph.GetBarriers(graphPasses.toneMapping);
                 if (useAtmosphere)
                 {
-                    toneMappingFromAtmospherePass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats);
+                    toneMappingFromAtmospherePass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats, toneMappingBarriers);
                 }
                 else
                 {
-                    toneMappingFromLitColorPass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats);
+                    toneMappingFromLitColorPass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats, toneMappingBarriers);
                 }
-                if (Engine::Instance()->GetEngineMode() == EngineMode::Editor)
-                    editorOutlinePass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats);
+                if (IsPassLive(graphPasses.outline))
+                    editorOutlinePass->CreateInstance(sharedModules)->Execute(hardwareRenderer, *params.renderStats, renderGraph.GetBarriers(graphPasses.outline));
             }
             hardwareRenderer->EndJobSubmission(nullptr);
         }
@@ -110,7 +110,10 @@ namespace GameEngine
 	{
 		localTransformChanged = true;
 		if (model)
+		{
 			CoreLib::Graphics::TransformBBox(Bounds, value, model->GetBounds());
+			BoundsChanged();
+		}
 		if (physInstance)
 			physInstance->SetTransform(value);
 	}
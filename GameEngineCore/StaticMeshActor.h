@@ -38,6 +38,10 @@ namespace GameEngine
 		virtual void OnLoad() override;
 		virtual void OnUnload() override;
 		virtual void GetDrawables(const GetDrawablesParameter & params) override;
+		virtual bool RetainsDrawables() override
+		{
+			return true;
+		}
 		virtual EngineActorType GetEngineType() override
 		{
 			return EngineActorType::Drawable;
@@ -1,5 +1,5 @@
 #include "StaticScene.h"
-#include "Bvh.h"
+#include "StaticSceneTracer.h"
 #include "Level.h"
 #include "CoreLib/Graphics/BBox.h"
 #include "StaticMeshActor.h"
@@ -11,16 +11,6 @@ namespace GameEngine
 {
     using namespace VectorMath;
     using namespace CoreLib;
-    struct StaticFace
-    {
-        Vec3 verts[3];
-        Vec2 uvs[3];
-        Vec3 normal;
-        uint32_t castShadow : 1;
-        int mapId:31;
-
-    };
-    
     class MeshBvhEvaluator
     {
     public:
@@ -31,58 +21,18 @@ namespace GameEngine
         }
     };
 
-    // Trace Triangle
-    class MeshTracer
-    {
-    public:
-        inline bool Trace(StaticSceneTracingResult & inter, const StaticFace & face, const Ray & ray, float & t) const
-        {
-            Vec3 e1 = face.verts[1] - face.verts[0];
-            Vec3 e2 = face.verts[2] - face.verts[0];
-            Vec3 s1 = Vec3::Cross(ray.Dir, e2);
-            float di = Vec3::Dot(s1, e1);
-            float  invd = 1.0f / (di);
-            Vec3 d = ray.Origin - face.verts[0];
-            float  b1 = Vec3::Dot(d, s1) * invd;
-            Vec3 s2 = Vec3::Cross(d, e1);
-            float  b2 = Vec3::Dot(ray.Dir, s2) * invd;
-            float temp = Vec3::Dot(e2, s2) * invd;
-            if (b1 < 0.f || b1 > 1.f || b2 < 0.f || b1 + b2 > 1.f || temp < 1e-5f || temp > ray.tMax)
-            {
-                return false;
-            }
-            else
-            {
-                t = inter.T = temp;
-                inter.IsHit = true;
-                inter.MapId = face.mapId;
-                inter.Normal = face.normal;
-                inter.CastShadow = (face.castShadow != 0);
-                inter.UV = face.uvs[0] * (1.0f - b1 - b2) + face.uvs[1] * b1 + face.uvs[2] * b2;
-                return true;
-            }
-        }
-    };
-
-    Vec3 SafeRcp(Vec3 vin)
-    {
-        Vec3 rs;
-        if (vin.x > 1e-10f || vin.x < -1e-10f) rs.x = 1.0f / vin.x; else rs.x = 0.0f;
-        if (vin.y > 1e-10f || vin.y < -1e-10f) rs.y = 1.0f / vin.y; else rs.y = 0.0f;
-        if (vin.z > 1e-10f || vin.z < -1e-10f) rs.z = 1.0f / vin.z; else rs.z = 0.0f;
-        return rs;
-    }
-
     class StaticSceneImpl : public StaticScene
     {
     public:
-        Bvh<StaticFace> bvh;
+        // faces in the leaf order of the bvh they were built with
+        List<StaticFace> faces;
+        WideBvh<StaticFacePacket> bvh;
         virtual StaticSceneTracingResult TraceRay(const Ray & ray) override
         {
             StaticSceneTracingResult result;
             MeshTracer tracer;
-            Vec3 rcpDir = SafeRcp(ray.Dir);
-            TraverseBvh<StaticFace, MeshTracer, StaticSceneTracingResult, false>(tracer, result, bvh, ray, rcpDir);
+            tracer.faces = faces.Buffer();
+            TraverseWideBvh<StaticFacePacket, MeshTracer, StaticSceneTracingResult>(tracer, result, bvh, ray);
             return result;
         }
     };
@@ -189,8 +139,17 @@ namespace GameEngine
             elements[i].Element = faces.Buffer() + i;
             elements[i].Center = (elements[i].Bounds.Min + elements[i].Bounds.Max) * 0.5f;
         }
-        ConstructBvh(bvhBuild, elements.Buffer(), elements.Count(), costEvaluator);
-        scene->bvh.FromBuild(bvhBuild);
+        if (elements.Count())
+        {
+            ConstructBvh(bvhBuild, elements.Buffer(), elements.Count(), costEvaluator);
+            // collapse the binary tree into nodes and face packets of the SIMD width
+            Bvh<StaticFace> binaryBvh;
+            binaryBvh.FromBuild(bvhBuild);
+            StaticFacePacketBuilder packetBuilder;
+            packetBuilder.faces = binaryBvh.Elements.Buffer();
+            scene->bvh.FromBvh(binaryBvh, packetBuilder);
+            scene->faces = _Move(binaryBvh.Elements);
+        }
         return scene;
     }
 }
\ No newline at end of file
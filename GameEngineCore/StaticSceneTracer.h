@@ -0,0 +1,119 @@
+#ifndef GAME_ENGINE_STATIC_SCENE_TRACER_H
+#define GAME_ENGINE_STATIC_SCENE_TRACER_H
+
+#include "StaticScene.h"
+#include "WideBvh.h"
+
+namespace GameEngine
+{
+    // a face of the static scene, its bvh leaves hold them in packets that MeshTracer tests in one go
+    struct StaticFace
+    {
+        VectorMath::Vec3 verts[3];
+        VectorMath::Vec2 uvs[3];
+        VectorMath::Vec3 normal;
+        uint32_t castShadow : 1;
+        int mapId:31;
+    };
+
+    // faces of a leaf in groups of WideBvhWidth, padding lanes have FaceId -1 and degenerate edges that never hit
+    struct StaticFacePacket
+    {
+        float V0X[WideBvhWidth], V0Y[WideBvhWidth], V0Z[WideBvhWidth];
+        float E1X[WideBvhWidth], E1Y[WideBvhWidth], E1Z[WideBvhWidth];
+        float E2X[WideBvhWidth], E2Y[WideBvhWidth], E2Z[WideBvhWidth];
+        int FaceId[WideBvhWidth];
+    };
+
+    class StaticFacePacketBuilder
+    {
+    public:
+        const StaticFace * faces;
+        CoreLib::Graphics::BBox AddPackets(CoreLib::List<StaticFacePacket> & packets, CoreLib::ArrayView<StaticFace> leafFaces)
+        {
+            CoreLib::Graphics::BBox bounds;
+            bounds.Init();
+            for (int i = 0; i < leafFaces.Count(); i += WideBvhWidth)
+            {
+                StaticFacePacket packet;
+                for (int j = 0; j < WideBvhWidth; j++)
+                {
+                    VectorMath::Vec3 v0 = VectorMath::Vec3::Create(0.0f), e1 = VectorMath::Vec3::Create(0.0f), e2 = VectorMath::Vec3::Create(0.0f);
+                    packet.FaceId[j] = -1;
+                    if (i + j < leafFaces.Count())
+                    {
+                        auto & face = leafFaces[i + j];
+                        v0 = face.verts[0];
+                        e1 = face.verts[1] - face.verts[0];
+                        e2 = face.verts[2] - face.verts[0];
+                        packet.FaceId[j] = (int)(&face - faces);
+                        for (int k = 0; k < 3; k++)
+                            bounds.Union(face.verts[k]);
+                    }
+                    packet.V0X[j] = v0.x; packet.V0Y[j] = v0.y; packet.V0Z[j] = v0.z;
+                    packet.E1X[j] = e1.x; packet.E1Y[j] = e1.y; packet.E1Z[j] = e1.z;
+                    packet.E2X[j] = e2.x; packet.E2Y[j] = e2.y; packet.E2Z[j] = e2.z;
+                }
+                packets.Add(packet);
+            }
+            return bounds;
+        }
+    };
+
+    // Trace Triangle
+    class MeshTracer
+    {
+    public:
+        const StaticFace * faces;
+        // moller-trumbore on all faces of the packet at once
+        inline bool Trace(StaticSceneTracingResult & inter, const StaticFacePacket & packet, const Ray & ray, float & t) const
+        {
+            BvhFloat dirX = BvhSet(ray.Dir.x), dirY = BvhSet(ray.Dir.y), dirZ = BvhSet(ray.Dir.z);
+            BvhFloat e1X = BvhLoad(packet.E1X), e1Y = BvhLoad(packet.E1Y), e1Z = BvhLoad(packet.E1Z);
+            BvhFloat e2X = BvhLoad(packet.E2X), e2Y = BvhLoad(packet.E2Y), e2Z = BvhLoad(packet.E2Z);
+            // s1 = cross(dir, e2)
+            BvhFloat s1X = BvhSub(BvhMul(dirY, e2Z), BvhMul(dirZ, e2Y));
+            BvhFloat s1Y = BvhSub(BvhMul(dirZ, e2X), BvhMul(dirX, e2Z));
+            BvhFloat s1Z = BvhSub(BvhMul(dirX, e2Y), BvhMul(dirY, e2X));
+            BvhFloat invd = BvhDiv(BvhSet(1.0f), BvhAdd(BvhAdd(BvhMul(s1X, e1X), BvhMul(s1Y, e1Y)), BvhMul(s1Z, e1Z)));
+            BvhFloat dX = BvhSub(BvhSet(ray.Origin.x), BvhLoad(packet.V0X));
+            BvhFloat dY = BvhSub(BvhSet(ray.Origin.y), BvhLoad(packet.V0Y));
+            BvhFloat dZ = BvhSub(BvhSet(ray.Origin.z), BvhLoad(packet.V0Z));
+            BvhFloat b1 = BvhMul(BvhAdd(BvhAdd(BvhMul(dX, s1X), BvhMul(dY, s1Y)), BvhMul(dZ, s1Z)), invd);
+            // s2 = cross(d, e1)
+            BvhFloat s2X = BvhSub(BvhMul(dY, e1Z), BvhMul(dZ, e1Y));
+            BvhFloat s2Y = BvhSub(BvhMul(dZ, e1X), BvhMul(dX, e1Z));
+            BvhFloat s2Z = BvhSub(BvhMul(dX, e1Y), BvhMul(dY, e1X));
+            BvhFloat b2 = BvhMul(BvhAdd(BvhAdd(BvhMul(dirX, s2X), BvhMul(dirY, s2Y)), BvhMul(dirZ, s2Z)), invd);
+            BvhFloat tHit = BvhMul(BvhAdd(BvhAdd(BvhMul(e2X, s2X), BvhMul(e2Y, s2Y)), BvhMul(e2Z, s2Z)), invd);
+            // ordered comparisons, lanes with nan never pass
+            BvhFloat zero = BvhSet(0.0f), one = BvhSet(1.0f);
+            BvhFloat valid = BvhAnd(BvhAnd(BvhGreaterEqual(b1, zero), BvhLessEqual(b1, one)),
+                BvhAnd(BvhGreaterEqual(b2, zero), BvhLessEqual(BvhAdd(b1, b2), one)));
+            valid = BvhAnd(valid, BvhAnd(BvhGreaterEqual(tHit, BvhSet(1e-5f)), BvhLessEqual(tHit, BvhSet(ray.tMax))));
+            unsigned int mask = BvhMoveMask(valid);
+            if (!mask)
+                return false;
+            float ts[WideBvhWidth], b1s[WideBvhWidth], b2s[WideBvhWidth];
+            BvhStore(ts, tHit);
+            int lane = -1;
+            for (int i = 0; i < WideBvhWidth; i++)
+            {
+                if ((mask & (1 << i)) && (lane == -1 || ts[i] < ts[lane]))
+                    lane = i;
+            }
+            BvhStore(b1s, b1);
+            BvhStore(b2s, b2);
+            auto & face = faces[packet.FaceId[lane]];
+            t = inter.T = ts[lane];
+            inter.IsHit = true;
+            inter.MapId = face.mapId;
+            inter.Normal = face.normal;
+            inter.CastShadow = (face.castShadow != 0);
+            inter.UV = face.uvs[0] * (1.0f - b1s[lane] - b2s[lane]) + face.uvs[1] * b1s[lane] + face.uvs[2] * b2s[lane];
+            return true;
+        }
+    };
+}
+
+#endif
\ No newline at end of file
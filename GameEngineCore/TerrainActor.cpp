@@ -167,5 +167,6 @@ namespace GameEngine
 		Actor::SetLocalTransform(val);
 		localTransformChanged = true;
 		CoreLib::Graphics::TransformBBox(Bounds, *LocalTransform, terrainMesh.Bounds);
+		BoundsChanged();
 	}
 }
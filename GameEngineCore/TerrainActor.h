@@ -29,6 +29,10 @@ namespace GameEngine
 
 		virtual void OnLoad() override;
 		virtual void GetDrawables(const GetDrawablesParameter & params) override;
+		virtual bool RetainsDrawables() override
+		{
+			return true;
+		}
 		virtual void SetLocalTransform(const VectorMath::Matrix4 & val) override;
 		virtual EngineActorType GetEngineType() override
 		{
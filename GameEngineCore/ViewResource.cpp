@@ -84,6 +84,11 @@ namespace GameEngine
 				attachments.SetAttachment(i, output->bindings[i]->TextureArray.Ptr(), output->bindings[i]->Layer);
 		}
 		if (attachments.attachments.Count())
+		{
 			output->frameBuffer = output->renderTargetLayout->CreateFrameBuffer(attachments);
+			// a new frame buffer may be allocated at the address of the destroyed one, which cached
+			// command buffers must not match
+			AdvanceDescriptorSetEpoch();
+		}
 	}
 }
\ No newline at end of file
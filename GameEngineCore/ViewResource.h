@@ -54,6 +54,11 @@ namespace GameEngine
 	public:
 		CoreLib::Event<> Resized;
 		CoreLib::RefPtr<RenderTarget> LoadSharedRenderTarget(CoreLib::String name, StorageFormat format, float ratio = 1.0f, int w0 = 1024, int h0 = 1024, bool useAsStorage = false);
+		// the view stops tracking the render target, its texture is freed once the last reference to it is released
+		void UnloadSharedRenderTarget(CoreLib::String name)
+		{
+			renderTargets.Remove(name);
+		}
 		template<typename ...TRenderTargets>
 		RenderOutput * CreateRenderOutput(RenderTargetLayout * renderTargetLayout, TRenderTargets ... renderTargets)
 		{
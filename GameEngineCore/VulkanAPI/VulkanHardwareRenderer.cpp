@@ -4355,6 +4355,14 @@ namespace VK
         virtual void ThreadInit(int threadId) override
         {
             renderThreadId = threadId;
+        }
+        virtual int GetThreadId() override
+        {
+            return renderThreadId;
+        }
+        virtual int GetMaxThreadCount() override
+        {
+            return MaxThreadCount;
         }
 		virtual void Init(int versionCount) override
 		{
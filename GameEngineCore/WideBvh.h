@@ -0,0 +1,229 @@
+#ifndef GAME_ENGINE_WIDE_BVH_H
+#define GAME_ENGINE_WIDE_BVH_H
+
+#include "Bvh.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#else
+#include <smmintrin.h>
+#endif
+
+namespace GameEngine
+{
+    // number of children per node and elements per packet, the width of the SIMD registers
+#ifdef __AVX2__
+    const int WideBvhWidth = 8;
+    typedef __m256 BvhFloat;
+    inline BvhFloat BvhLoad(const float * ptr) { return _mm256_loadu_ps(ptr); }
+    inline BvhFloat BvhSet(float val) { return _mm256_set1_ps(val); }
+    inline BvhFloat BvhAdd(BvhFloat a, BvhFloat b) { return _mm256_add_ps(a, b); }
+    inline BvhFloat BvhSub(BvhFloat a, BvhFloat b) { return _mm256_sub_ps(a, b); }
+    inline BvhFloat BvhMul(BvhFloat a, BvhFloat b) { return _mm256_mul_ps(a, b); }
+    inline BvhFloat BvhDiv(BvhFloat a, BvhFloat b) { return _mm256_div_ps(a, b); }
+    inline BvhFloat BvhMin(BvhFloat a, BvhFloat b) { return _mm256_min_ps(a, b); }
+    inline BvhFloat BvhMax(BvhFloat a, BvhFloat b) { return _mm256_max_ps(a, b); }
+    inline BvhFloat BvhAnd(BvhFloat a, BvhFloat b) { return _mm256_and_ps(a, b); }
+    inline BvhFloat BvhLessEqual(BvhFloat a, BvhFloat b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    inline BvhFloat BvhGreaterEqual(BvhFloat a, BvhFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline void BvhStore(float * ptr, BvhFloat a) { _mm256_storeu_ps(ptr, a); }
+    inline unsigned int BvhMoveMask(BvhFloat a) { return (unsigned int)_mm256_movemask_ps(a); }
+#else
+    const int WideBvhWidth = 4;
+    typedef __m128 BvhFloat;
+    inline BvhFloat BvhLoad(const float * ptr) { return _mm_loadu_ps(ptr); }
+    inline BvhFloat BvhSet(float val) { return _mm_set1_ps(val); }
+    inline BvhFloat BvhAdd(BvhFloat a, BvhFloat b) { return _mm_add_ps(a, b); }
+    inline BvhFloat BvhSub(BvhFloat a, BvhFloat b) { return _mm_sub_ps(a, b); }
+    inline BvhFloat BvhMul(BvhFloat a, BvhFloat b) { return _mm_mul_ps(a, b); }
+    inline BvhFloat BvhDiv(BvhFloat a, BvhFloat b) { return _mm_div_ps(a, b); }
+    inline BvhFloat BvhMin(BvhFloat a, BvhFloat b) { return _mm_min_ps(a, b); }
+    inline BvhFloat BvhMax(BvhFloat a, BvhFloat b) { return _mm_max_ps(a, b); }
+    inline BvhFloat BvhAnd(BvhFloat a, BvhFloat b) { return _mm_and_ps(a, b); }
+    inline BvhFloat BvhLessEqual(BvhFloat a, BvhFloat b) { return _mm_cmple_ps(a, b); }
+    inline BvhFloat BvhGreaterEqual(BvhFloat a, BvhFloat b) { return _mm_cmpge_ps(a, b); }
+    inline void BvhStore(float * ptr, BvhFloat a) { _mm_storeu_ps(ptr, a); }
+    inline unsigned int BvhMoveMask(BvhFloat a) { return (unsigned int)_mm_movemask_ps(a); }
+#endif
+
+    // child bounds are stored as structure of arrays so that a ray is tested against all children at once.
+    // a child with LeafCount == 0 is the node Children[i], otherwise it is a leaf made of LeafCount packets starting
+    // at packet Children[i]. unused children have empty bounds and are never hit.
+    struct WideBvhNode
+    {
+        float MinX[WideBvhWidth], MinY[WideBvhWidth], MinZ[WideBvhWidth];
+        float MaxX[WideBvhWidth], MaxY[WideBvhWidth], MaxZ[WideBvhWidth];
+        int Children[WideBvhWidth];
+        int LeafCount[WideBvhWidth];
+    };
+
+    // a binary bvh collapsed into nodes of WideBvhWidth children, with the elements of each leaf grouped into packets
+    template<typename TPacket>
+    class WideBvh
+    {
+    private:
+        // PacketBuilder::AddPackets(List<TPacket> & packets, ArrayView<T> elements) appends the packets of a leaf
+        // and returns the bounds of its elements
+        template<typename T, typename PacketBuilder>
+        int CollapseNode(Bvh<T> & bvh, int binaryNode, PacketBuilder & builder)
+        {
+            // open the child with the largest surface area until the node is full
+            CoreLib::Array<int, WideBvhWidth> children;
+            children.Add(binaryNode);
+            while (children.Count() < WideBvhWidth)
+            {
+                int largest = -1;
+                float largestArea = -1.0f;
+                for (int i = 0; i < children.Count(); i++)
+                {
+                    auto & node = bvh.Nodes[children[i]];
+                    if (node.GetIsLeaf())
+                        continue;
+                    float area = SurfaceArea(node.Bounds);
+                    if (area > largestArea)
+                    {
+                        largestArea = area;
+                        largest = i;
+                    }
+                }
+                if (largest == -1)
+                    break;
+                int opened = children[largest];
+                children[largest] = opened + 1;
+                children.Add(opened + bvh.Nodes[opened].ChildOffset);
+            }
+            int id = Nodes.Count();
+            Nodes.Add(WideBvhNode());
+            for (int i = 0; i < WideBvhWidth; i++)
+            {
+                CoreLib::Graphics::BBox bounds;
+                bounds.Init();
+                int child = -1, leafCount = 0;
+                if (i < children.Count())
+                {
+                    auto & node = bvh.Nodes[children[i]];
+                    if (node.GetIsLeaf())
+                    {
+                        child = Packets.Count();
+                        bounds = builder.AddPackets(Packets, bvh.Elements.GetArrayView(node.ElementId, node.ElementCount));
+                        leafCount = Packets.Count() - child;
+                    }
+                    else
+                    {
+                        bounds = node.Bounds;
+                        child = CollapseNode(bvh, children[i], builder);
+                    }
+                }
+                auto & wideNode = Nodes[id];
+                wideNode.MinX[i] = bounds.xMin; wideNode.MinY[i] = bounds.yMin; wideNode.MinZ[i] = bounds.zMin;
+                wideNode.MaxX[i] = bounds.xMax; wideNode.MaxY[i] = bounds.yMax; wideNode.MaxZ[i] = bounds.zMax;
+                wideNode.Children[i] = child;
+                wideNode.LeafCount[i] = leafCount;
+            }
+            return id;
+        }
+    public:
+        CoreLib::List<WideBvhNode> Nodes;
+        CoreLib::List<TPacket> Packets;
+        template<typename T, typename PacketBuilder>
+        void FromBvh(Bvh<T> & bvh, PacketBuilder & builder)
+        {
+            Nodes.Clear();
+            Packets.Clear();
+            if (bvh.Nodes.Count())
+                CollapseNode(bvh, 0, builder);
+        }
+    };
+
+    // visits children nearest first, Tracer::Trace(THit & rs, const TPacket & packet, const Ray & ray, float & t)
+    // returns true and the distance of the closest hit of the packet within ray.tMax
+    template<typename TPacket, typename Tracer, typename THit>
+    bool TraverseWideBvh(const Tracer & tracer, THit & rs, WideBvh<TPacket> & tree, const Ray & ray)
+    {
+        struct StackEntry
+        {
+            int Child, LeafCount;
+            float TNear;
+        };
+        if (tree.Nodes.Count() == 0)
+            return false;
+        auto rcpDir = BvhRcpDir(ray.Dir);
+        // the slab of each axis facing the ray origin gives the entry distance. on axes the ray is parallel to,
+        // children are only tested for containing the origin
+        int nearOffset[3], farOffset[3];
+        bool parallel[3];
+        BvhFloat origin[3], rcp[3];
+        for (int i = 0; i < 3; i++)
+        {
+            nearOffset[i] = (rcpDir[i] >= 0.0f ? 0 : 3) + i;
+            farOffset[i] = (rcpDir[i] >= 0.0f ? 3 : 0) + i;
+            parallel[i] = rcpDir[i] >= BvhParallelRcp || rcpDir[i] <= -BvhParallelRcp;
+            origin[i] = BvhSet(ray.Origin[i]);
+            rcp[i] = BvhSet(rcpDir[i]);
+        }
+        BvhFloat zero = BvhSet(0.0f);
+        auto traceRay = ray;
+        bool hit = false;
+        CoreLib::Array<StackEntry, 512> stack;
+        stack.Add(StackEntry{ 0, 0, 0.0f });
+        while (stack.Count())
+        {
+            auto entry = stack[stack.Count() - 1];
+            stack.SetSize(stack.Count() - 1);
+            if (entry.TNear > traceRay.tMax)
+                continue;
+            if (entry.LeafCount)
+            {
+                for (int i = entry.Child; i < entry.Child + entry.LeafCount; i++)
+                {
+                    float t = traceRay.tMax;
+                    if (tracer.Trace(rs, tree.Packets[i], traceRay, t))
+                    {
+                        traceRay.tMax = t;
+                        hit = true;
+                    }
+                }
+                continue;
+            }
+            auto & node = tree.Nodes[entry.Child];
+            const float * planes[6] = { node.MinX, node.MinY, node.MinZ, node.MaxX, node.MaxY, node.MaxZ };
+            BvhFloat tNear = zero, tFar = BvhSet(traceRay.tMax);
+            BvhFloat inside = BvhLessEqual(zero, zero);
+            for (int i = 0; i < 3; i++)
+            {
+                if (parallel[i])
+                {
+                    inside = BvhAnd(inside, BvhAnd(BvhGreaterEqual(origin[i], BvhLoad(planes[i])), BvhLessEqual(origin[i], BvhLoad(planes[i + 3]))));
+                    continue;
+                }
+                tNear = BvhMax(tNear, BvhMul(BvhSub(BvhLoad(planes[nearOffset[i]]), origin[i]), rcp[i]));
+                tFar = BvhMin(tFar, BvhMul(BvhSub(BvhLoad(planes[farOffset[i]]), origin[i]), rcp[i]));
+            }
+            unsigned int mask = BvhMoveMask(BvhAnd(BvhLessEqual(tNear, tFar), inside));
+            if (!mask)
+                continue;
+            float tNears[WideBvhWidth];
+            BvhStore(tNears, tNear);
+            // push the hit children farthest first so that the nearest is visited next
+            CoreLib::Array<StackEntry, WideBvhWidth> hitChildren;
+            for (int i = 0; i < WideBvhWidth; i++)
+            {
+                if (!(mask & (1 << i)))
+                    continue;
+                StackEntry child{ node.Children[i], node.LeafCount[i], tNears[i] };
+                int j = hitChildren.Count();
+                hitChildren.SetSize(j + 1);
+                while (j > 0 && hitChildren[j - 1].TNear < child.TNear)
+                {
+                    hitChildren[j] = hitChildren[j - 1];
+                    j--;
+                }
+                hitChildren[j] = child;
+            }
+            for (auto & child : hitChildren)
+                stack.Add(child);
+        }
+        return hit;
+    }
+}
+
+#endif
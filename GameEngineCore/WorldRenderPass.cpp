@@ -32,13 +32,16 @@ namespace GameEngine
 		return fragShader->Id;
 	}
 
-	AsyncCommandBuffer * WorldRenderPass::AllocCommandBuffer()
+	AsyncCommandBuffer * WorldRenderPass::AllocCommandBuffer(int recordingThread)
 	{
-		if (poolAllocPtr == commandBufferPool.Count())
+		auto & pool = commandBufferPools[recordingThread];
+		auto & allocPtr = poolAllocPtrs[recordingThread];
+		if (allocPtr == pool.Count())
 		{
-			commandBufferPool.Add(new AsyncCommandBuffer(hwRenderer));
+			// a multiple of the uniform buffer versions, so that a buffer recorded a full ring ago bound the same descriptor sets
+			pool.Add(new AsyncCommandBuffer(hwRenderer, DynamicBufferLengthMultiplier * 2));
 		}
-		return commandBufferPool[poolAllocPtr++].Ptr();
+		return pool[allocPtr++].Ptr();
 	}
 
 	void WorldRenderPass::Create(Renderer * renderer)
@@ -48,6 +51,7 @@ namespace GameEngine
         fragShader = Engine::GetShaderCompiler()->LoadShaderEntryPoint(GetShaderFileName(), "ps_main");
         SetPipelineStates(fixedFunctionStates);
 		renderPassId = renderer->RegisterWorldRenderPass(GetShaderId());
+		sharedRes->pipelineManager.RegisterRenderPass(vertShader, fragShader, renderTargetLayout.Ptr(), fixedFunctionStates);
 	}
 	WorldRenderPass::~WorldRenderPass()
 	{
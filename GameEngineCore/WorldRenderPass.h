@@ -2,6 +2,7 @@
 #define GAME_ENGINE_WORLD_RENDER_PASS_H
 
 #include "RenderPass.h"
+#include "DrawableSorter.h"
 
 namespace GameEngine
 {
@@ -12,8 +13,10 @@ namespace GameEngine
 		ShaderEntryPoint * vertShader = nullptr, * fragShader = nullptr;
 		int renderPassId = -1;
 	protected:
-		CoreLib::List<CoreLib::RefPtr<AsyncCommandBuffer>> commandBufferPool;
-		int poolAllocPtr = 0;
+		// one pool per recording thread, command buffers are created from the command pool of the thread that uses them
+		CoreLib::List<CoreLib::RefPtr<AsyncCommandBuffer>> commandBufferPools[MaxCommandRecordingThreads];
+		int poolAllocPtrs[MaxCommandRecordingThreads] = {};
+		DrawableSorter drawableSorter;
 		virtual const char * GetShaderFileName() = 0;
 		virtual RenderTargetLayout * CreateRenderTargetLayout() = 0;
 		virtual void SetPipelineStates(FixedFunctionPipelineStates & state)
@@ -26,10 +29,15 @@ namespace GameEngine
 		~WorldRenderPass();
 		void ResetInstancePool()
 		{
-			poolAllocPtr = 0;
+			for (auto & ptr : poolAllocPtrs)
+				ptr = 0;
 		}
 		virtual void Bind();
-		AsyncCommandBuffer * AllocCommandBuffer();
+		AsyncCommandBuffer * AllocCommandBuffer(int recordingThread = 0);
+		DrawableSorter & GetDrawableSorter()
+		{
+			return drawableSorter;
+		}
 		CoreLib::RefPtr<WorldPassRenderTask> CreateInstance(RenderOutput * output, bool clearOutput);
 		virtual int GetShaderId() override;
 	};
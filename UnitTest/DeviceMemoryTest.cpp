@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "../GameEngineCore/DeviceMemory.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace GameEngine;
+
+namespace UnitTest
+{
+	TEST_CLASS(DeviceMemoryTest)
+	{
+	public:
+		TEST_METHOD(CoalesceMergesCloseRanges)
+		{
+			List<UploadRange> ranges;
+			ranges.Add(UploadRange{ 1000, 100 });
+			ranges.Add(UploadRange{ 0, 64 });
+			ranges.Add(UploadRange{ 64, 64 });
+			ranges.Add(UploadRange{ 1050, 10 });
+			ranges.Add(UploadRange{ 160, 32 });
+			CoalesceUploadRanges(ranges, 32);
+			Assert::AreEqual(2, ranges.Count());
+			Assert::AreEqual(0, ranges[0].Offset);
+			Assert::AreEqual(192, ranges[0].Length);
+			Assert::AreEqual(1000, ranges[1].Offset);
+			Assert::AreEqual(100, ranges[1].Length);
+		}
+
+		TEST_METHOD(FlushUploadsCoalescedUpdates)
+		{
+			RefPtr<HardwareRenderer> hw = CreateDummyHardwareRenderer();
+			DeviceMemory memory;
+			memory.Init(hw.Ptr(), BufferUsage::UniformBuffer, false, 16, 16, nullptr);
+			memory.SetCoalesceUploads(true);
+			auto ptr = (unsigned char*)memory.Alloc(1024);
+			int baseOffset = (int)(ptr - (unsigned char*)memory.BufferPtr());
+			for (int i = 0; i < 64; i++)
+			{
+				unsigned char data[16];
+				for (auto & b : data)
+					b = (unsigned char)i;
+				memory.SetDataAsync(baseOffset + i * 16, data, sizeof(data));
+			}
+			int64_t uploadedBytes = 0;
+			Assert::AreEqual(1, memory.FlushUploads(uploadedBytes));
+			Assert::AreEqual((int64_t)1024, uploadedBytes);
+			Assert::AreEqual(0, memory.FlushUploads(uploadedBytes));
+			List<unsigned char> content;
+			content.SetSize(1024);
+			memory.GetBuffer()->GetData(content.Buffer(), baseOffset, 1024);
+			for (int i = 0; i < 1024; i++)
+				Assert::AreEqual((int)(i / 16), (int)content[i]);
+		}
+	};
+}
@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "../GameEngineCore/DrawableSorter.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace GameEngine;
+
+namespace UnitTest
+{
+	TEST_CLASS(DrawableSorterTest)
+	{
+	public:
+		TEST_METHOD(RadixSortOrdersKeys)
+		{
+			List<SortKeyEntry> entries, scratch;
+			Random random(17);
+			for (int i = 0; i < 10000; i++)
+			{
+				SortKeyEntry entry;
+				entry.Key = ((uint64_t)random.Next() << 40) ^ ((uint64_t)random.Next() << 20) ^ (uint64_t)random.Next();
+				entry.Index = i;
+				entries.Add(entry);
+			}
+			RadixSort(entries, scratch);
+			Assert::AreEqual(10000, entries.Count());
+			for (int i = 1; i < entries.Count(); i++)
+				Assert::IsTrue(entries[i - 1].Key <= entries[i].Key);
+		}
+
+		TEST_METHOD(RadixSortIsStable)
+		{
+			List<SortKeyEntry> entries, scratch;
+			for (int i = 0; i < 1000; i++)
+			{
+				SortKeyEntry entry;
+				entry.Key = (uint64_t)(i % 7) << 56;
+				entry.Index = i;
+				entries.Add(entry);
+			}
+			RadixSort(entries, scratch);
+			for (int i = 1; i < entries.Count(); i++)
+			{
+				if (entries[i - 1].Key == entries[i].Key)
+					Assert::IsTrue(entries[i - 1].Index < entries[i].Index);
+			}
+		}
+
+		TEST_METHOD(BackToFrontKeyOrder)
+		{
+			Assert::IsTrue(DrawSortKey::MakeBackToFront(0, 10.0f) < DrawSortKey::MakeBackToFront(0, 1.0f));
+			Assert::IsTrue(DrawSortKey::MakeBackToFront(0, 1.0f) < DrawSortKey::MakeBackToFront(0, 0.0f));
+			Assert::IsTrue(DrawSortKey::MakeBackToFront(0, 0.0f) < DrawSortKey::MakeBackToFront(1, 100.0f));
+		}
+	};
+}
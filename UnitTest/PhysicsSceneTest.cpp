@@ -0,0 +1,267 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "../GameEngineCore/Physics.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace VectorMath;
+using namespace GameEngine;
+
+namespace UnitTest
+{
+	TEST_CLASS(PhysicsSceneTest)
+	{
+	private:
+		// a unit quad facing -z at z = 0
+		RefPtr<PhysicsModel> CreateQuadModel()
+		{
+			PhysicsModelBuilder builder;
+			PhysicsModelFace face;
+			face.Normal = Vec3::Create(0.0f, 0.0f, -1.0f);
+			face.Vertices[0] = Vec3::Create(-0.5f, -0.5f, 0.0f);
+			face.Vertices[1] = Vec3::Create(0.5f, -0.5f, 0.0f);
+			face.Vertices[2] = Vec3::Create(0.5f, 0.5f, 0.0f);
+			builder.AddFace(face);
+			face.Vertices[1] = Vec3::Create(0.5f, 0.5f, 0.0f);
+			face.Vertices[2] = Vec3::Create(-0.5f, 0.5f, 0.0f);
+			builder.AddFace(face);
+			return builder.GetModel();
+		}
+		Matrix4 Translation(float x, float y, float z)
+		{
+			Matrix4 m;
+			Matrix4::Translation(m, x, y, z);
+			return m;
+		}
+	public:
+		TEST_METHOD(RayTraceFindsClosestObject)
+		{
+			auto model = CreateQuadModel();
+			PhysicsScene scene;
+			List<RefPtr<PhysicsObject>> objects;
+			for (int i = 0; i < 64; i++)
+			{
+				RefPtr<PhysicsObject> obj = new PhysicsObject(model.Ptr());
+				obj->SetModelTransform(Translation((float)(i % 8) * 2.0f, (float)(i / 8) * 2.0f, 10.0f + i));
+				scene.AddObject(obj.Ptr());
+				objects.Add(obj);
+			}
+			Ray ray;
+			ray.Origin = Vec3::Create(6.0f, 4.0f, 0.0f);
+			ray.Dir = Vec3::Create(0.0f, 0.0f, 1.0f);
+			auto rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == objects[19].Ptr());
+			Assert::IsTrue(fabs(rs.Distance - 29.0f) < 1e-3f);
+			// an object moved in front of the ray is found before the tree is updated
+			objects[0]->SetModelTransform(Translation(6.0f, 4.0f, 5.0f));
+			rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == objects[0].Ptr());
+			scene.Tick();
+			rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == objects[0].Ptr());
+			Assert::IsFalse(objects[0]->CheckModelTransformDirtyBit());
+			scene.RemoveObject(objects[0].Ptr());
+			rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == objects[19].Ptr());
+		}
+
+		TEST_METHOD(ModelTraceFindsClosestFace)
+		{
+			// two 32x32 grids facing -z, at z = 0 and z = 4
+			PhysicsModelBuilder builder;
+			for (int layer = 0; layer < 2; layer++)
+			{
+				float z = layer * 4.0f;
+				for (int i = 0; i < 32; i++)
+				{
+					for (int j = 0; j < 32; j++)
+					{
+						PhysicsModelFace face;
+						face.Normal = Vec3::Create(0.0f, 0.0f, -1.0f);
+						face.Vertices[0] = Vec3::Create((float)i, (float)j, z);
+						face.Vertices[1] = Vec3::Create((float)i + 1.0f, (float)j, z);
+						face.Vertices[2] = Vec3::Create((float)i + 1.0f, (float)j + 1.0f, z);
+						builder.AddFace(face);
+						face.Vertices[1] = Vec3::Create((float)i + 1.0f, (float)j + 1.0f, z);
+						face.Vertices[2] = Vec3::Create((float)i, (float)j + 1.0f, z);
+						builder.AddFace(face);
+					}
+				}
+			}
+			auto model = builder.GetModel();
+			Assert::AreEqual(32 * 32 * 4, model->GetFaceCount());
+			for (int i = 0; i < 100; i++)
+			{
+				auto origin = Vec3::Create((i % 10) * 3.1f + 0.3f, (i / 10) * 3.1f + 0.2f, -10.0f);
+				auto hit = model->TraceRay(origin, Vec3::Create(0.0f, 0.0f, 1.0f), 0.0f, 1e30f);
+				Assert::IsTrue(hit.IsHit);
+				Assert::IsTrue(hit.FaceId >= 0 && hit.FaceId < model->GetFaceCount());
+				Assert::IsTrue(fabs(hit.Distance - 10.0f) < 1e-4f);
+				hit = model->TraceRay(origin, Vec3::Create(0.0f, 0.0f, 1.0f), 11.0f, 1e30f);
+				Assert::IsTrue(fabs(hit.Distance - 14.0f) < 1e-4f);
+				Assert::IsFalse(model->TraceRayAny(origin, Vec3::Create(0.0f, 0.0f, 1.0f), 0.0f, 9.0f));
+				Assert::IsTrue(model->TraceRayAny(origin, Vec3::Create(0.0f, 0.0f, 1.0f), 0.0f, 20.0f));
+			}
+			auto miss = model->TraceRay(Vec3::Create(40.0f, 5.0f, -10.0f), Vec3::Create(0.0f, 0.0f, 1.0f), 0.0f, 1e30f);
+			Assert::IsFalse(miss.IsHit);
+		}
+
+		TEST_METHOD(ModelTraceHitsFromNodePlanes)
+		{
+			// axis aligned rays starting exactly on grid lines, which are also planes of bvh nodes
+			PhysicsModelBuilder builder;
+			for (int i = 0; i < 32; i++)
+			{
+				for (int j = 0; j < 32; j++)
+				{
+					PhysicsModelFace face;
+					face.Normal = Vec3::Create(0.0f, 0.0f, -1.0f);
+					face.Vertices[0] = Vec3::Create((float)i, (float)j, 0.0f);
+					face.Vertices[1] = Vec3::Create((float)i + 1.0f, (float)j, 0.0f);
+					face.Vertices[2] = Vec3::Create((float)i + 1.0f, (float)j + 1.0f, 0.0f);
+					builder.AddFace(face);
+					face.Vertices[1] = Vec3::Create((float)i + 1.0f, (float)j + 1.0f, 0.0f);
+					face.Vertices[2] = Vec3::Create((float)i, (float)j + 1.0f, 0.0f);
+					builder.AddFace(face);
+				}
+			}
+			auto model = builder.GetModel();
+			for (int i = 0; i <= 32; i++)
+			{
+				for (int j = 0; j < 32; j++)
+				{
+					auto origin = Vec3::Create((float)i, (float)j + 0.5f, -10.0f);
+					auto hit = model->TraceRay(origin, Vec3::Create(0.0f, 0.0f, 1.0f), 0.0f, 1e30f);
+					Assert::IsTrue(hit.IsHit);
+					Assert::IsTrue(fabs(hit.Distance - 10.0f) < 1e-4f);
+					Assert::IsTrue(model->TraceRayAny(origin, Vec3::Create(0.0f, 0.0f, 1.0f), 0.0f, 20.0f));
+					origin = Vec3::Create((float)j + 0.5f, (float)i, 10.0f);
+					hit = model->TraceRay(origin, Vec3::Create(0.0f, 0.0f, -1.0f), 0.0f, 1e30f);
+					Assert::IsTrue(hit.IsHit);
+					Assert::IsTrue(fabs(hit.Distance - 10.0f) < 1e-4f);
+				}
+			}
+		}
+
+		TEST_METHOD(RayTraceBatchMatchesSingleTraces)
+		{
+			auto model = CreateQuadModel();
+			PhysicsScene scene;
+			List<RefPtr<PhysicsObject>> objects;
+			for (int i = 0; i < 256; i++)
+			{
+				RefPtr<PhysicsObject> obj = new PhysicsObject(model.Ptr());
+				obj->SetModelTransform(Translation((float)(i % 16), (float)(i / 16), (float)(i % 7) * 3.0f));
+				scene.AddObject(obj.Ptr());
+				objects.Add(obj);
+			}
+			List<RayTraceQuery> queries;
+			Random random(17);
+			for (int i = 0; i < 2000; i++)
+			{
+				RayTraceQuery query;
+				query.TraceRay.Origin = Vec3::Create(random.NextFloat(-1.0f, 16.0f), random.NextFloat(-1.0f, 16.0f), -5.0f);
+				query.TraceRay.Dir = Vec3::Create(random.NextFloat(-0.3f, 0.3f), random.NextFloat(-0.3f, 0.3f), 1.0f).Normalize();
+				query.MaxDistance = random.NextFloat(2.0f, 30.0f);
+				query.AnyHit = (i % 3) == 0;
+				if (i % 5 == 0)
+					query.Channels = PhysicsChannels::Visiblity;
+				queries.Add(query);
+			}
+			for (int i = 0; i < objects.Count(); i += 2)
+				objects[i]->Channels = PhysicsChannels::Collision;
+			List<TraceResult> results;
+			results.SetSize(queries.Count());
+			scene.RayTraceBatch(queries.GetArrayView(), results.GetArrayView());
+			int hitCount = 0;
+			for (int i = 0; i < queries.Count(); i++)
+			{
+				auto & query = queries[i];
+				auto expected = scene.RayTraceFirst(query.TraceRay, query.Channels, query.MaxDistance);
+				Assert::AreEqual(expected.Object != nullptr, results[i].Object != nullptr);
+				if (expected.Object)
+					hitCount++;
+				if (expected.Object && !query.AnyHit)
+				{
+					Assert::IsTrue(expected.Object == results[i].Object);
+					Assert::IsTrue(fabs(expected.Distance - results[i].Distance) < 1e-4f);
+				}
+			}
+			Assert::IsTrue(hitCount > 0);
+		}
+
+		TEST_METHOD(CompoundObjectsReportParts)
+		{
+			// a chain of four parts along x, parts 2 and 3 are children of part 1
+			auto model = CreateQuadModel();
+			List<RefPtr<PhysicsObject>> parts;
+			List<PhysicsObject*> partPtrs;
+			for (int i = 0; i < 4; i++)
+			{
+				RefPtr<PhysicsObject> part = new PhysicsObject(model.Ptr());
+				part->SkeletalBoneId = i;
+				part->SetModelTransform(Translation((float)i * 2.0f, 0.0f, 0.0f));
+				parts.Add(part);
+				partPtrs.Add(part.Ptr());
+			}
+			List<int> parents;
+			parents.Add(-1);
+			parents.Add(0);
+			parents.Add(1);
+			parents.Add(1);
+			RefPtr<PhysicsObject> compound = new PhysicsObject(partPtrs.GetArrayView(), parents.GetArrayView());
+			PhysicsScene scene;
+			scene.AddObject(compound.Ptr());
+			Assert::IsTrue(fabs(compound->GetBounds().xMax - 6.5f) < 1e-5f);
+			Ray ray;
+			ray.Origin = Vec3::Create(4.0f, 0.0f, -5.0f);
+			ray.Dir = Vec3::Create(0.0f, 0.0f, 1.0f);
+			auto rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == parts[2].Ptr());
+			Assert::AreEqual(2, rs.Object->SkeletalBoneId);
+			// move part 3 in front of part 2, only the compound is refitted
+			parts[3]->SetModelTransform(Translation(4.0f, 0.0f, -1.0f));
+			compound->RefitParts();
+			rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == parts[3].Ptr());
+			scene.Tick();
+			rs = scene.RayTraceFirst(ray);
+			Assert::IsTrue(rs.Object == parts[3].Ptr());
+			Assert::IsTrue(fabs(compound->GetBounds().xMax - 4.5f) < 1e-5f);
+			List<PhysicsObject*> result;
+			scene.QuerySphere(Vec3::Create(0.0f, 0.0f, 0.0f), 1.0f, result);
+			Assert::AreEqual(1, result.Count());
+			Assert::IsTrue(result[0] == parts[0].Ptr());
+		}
+
+		TEST_METHOD(OverlapQueries)
+		{
+			auto model = CreateQuadModel();
+			PhysicsScene scene;
+			List<RefPtr<PhysicsObject>> objects;
+			for (int i = 0; i < 16; i++)
+			{
+				RefPtr<PhysicsObject> obj = new PhysicsObject(model.Ptr());
+				obj->SetModelTransform(Translation((float)i * 10.0f, 0.0f, 0.0f));
+				scene.AddObject(obj.Ptr());
+				objects.Add(obj);
+			}
+			objects[3]->Channels = PhysicsChannels::Visiblity;
+			scene.Tick();
+			List<PhysicsObject*> result;
+			CoreLib::Graphics::BBox box;
+			box.Min = Vec3::Create(15.0f, -1.0f, -1.0f);
+			box.Max = Vec3::Create(40.0f, 1.0f, 1.0f);
+			scene.QueryBox(box, result);
+			Assert::AreEqual(3, result.Count());
+			result.Clear();
+			scene.QueryBox(box, result, PhysicsChannels::Collision);
+			Assert::AreEqual(2, result.Count());
+			Assert::IsFalse(result.Contains(objects[3].Ptr()));
+			result.Clear();
+			scene.QuerySphere(Vec3::Create(100.0f, 0.0f, 3.0f), 3.5f, result);
+			Assert::AreEqual(1, result.Count());
+			Assert::IsTrue(result[0] == objects[10].Ptr());
+		}
+	};
+}
@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "../GameEngineCore/RenderGraph.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace GameEngine;
+
+namespace UnitTest
+{
+	TEST_CLASS(RenderGraphTest)
+	{
+	public:
+		TEST_METHOD(UnusedPassesAreCulled)
+		{
+			RenderGraph graph;
+			RenderGraphTextureDesc desc(StorageFormat::Depth32, 64, 64);
+			int depth = graph.AddTexture("depth", desc, true);
+			int unused = graph.AddTexture("unused", desc, true);
+			int color = graph.AddTexture("color", RenderGraphTextureDesc(StorageFormat::RGBA_8, 64, 64), false);
+			graph.MarkOutput(color);
+			int unusedPass = graph.AddPass("unused");
+			graph.Write(unusedPass, unused);
+			int depthPass = graph.AddPass("depth");
+			graph.Write(depthPass, depth);
+			int colorPass = graph.AddPass("color");
+			graph.Read(colorPass, depth);
+			graph.Write(colorPass, color);
+			graph.Compile();
+			Assert::IsFalse(graph.IsPassLive(unusedPass));
+			Assert::IsTrue(graph.IsPassLive(depthPass));
+			Assert::IsTrue(graph.IsPassLive(colorPass));
+			Assert::IsTrue(graph.GetPhysicalTextureName(unused).Length() == 0);
+			Assert::AreEqual(1, graph.GetPhysicalTextureCount());
+			Assert::AreEqual(desc.GetSize(), graph.GetTransientMemory());
+			Assert::AreEqual(desc.GetSize() * 2, graph.GetUnaliasedTransientMemory());
+		}
+
+		TEST_METHOD(DisjointTexturesShareMemory)
+		{
+			RenderGraph graph;
+			RenderGraphTextureDesc desc(StorageFormat::RG_8, 32, 32);
+			int a = graph.AddTexture("a", desc, true);
+			int b = graph.AddTexture("b", desc, true);
+			int c = graph.AddTexture("c", desc, true);
+			int output = graph.AddBuffer("output");
+			graph.MarkOutput(output);
+			int pass0 = graph.AddPass("writeA");
+			graph.Write(pass0, a, RenderGraphAccess::WriteStorage);
+			int pass1 = graph.AddPass("aToB");
+			graph.Read(pass1, a);
+			graph.Write(pass1, b, RenderGraphAccess::WriteStorage);
+			int pass2 = graph.AddPass("bToC");
+			graph.Read(pass2, b);
+			graph.Write(pass2, c, RenderGraphAccess::WriteStorage);
+			int pass3 = graph.AddPass("resolve");
+			graph.Read(pass3, c);
+			graph.Write(pass3, output, RenderGraphAccess::WriteStorage);
+			graph.Compile();
+			// a and b overlap in aToB, b and c overlap in bToC, c can take the memory of a
+			Assert::AreEqual(2, graph.GetPhysicalTextureCount());
+			Assert::IsTrue(graph.GetPhysicalTextureName(c) == graph.GetPhysicalTextureName(a));
+			Assert::IsTrue(graph.GetPhysicalTextureName(b) != graph.GetPhysicalTextureName(a));
+			Assert::AreEqual(desc.GetSize() * 2, graph.GetTransientMemory());
+		}
+
+		TEST_METHOD(ContinuedAttachmentsSkipBarrier)
+		{
+			RenderGraph graph;
+			int color = graph.AddTexture("color", RenderGraphTextureDesc(StorageFormat::RGBA_8, 16, 16), false);
+			int depth = graph.AddTexture("depth", RenderGraphTextureDesc(StorageFormat::Depth32, 16, 16), false);
+			graph.MarkOutput(color);
+			int prez = graph.AddPass("prez");
+			graph.Write(prez, depth);
+			int forward = graph.AddPass("forward");
+			graph.Read(forward, depth);
+			graph.Write(forward, color);
+			graph.Write(forward, depth);
+			int overlay = graph.AddPass("overlay");
+			graph.Write(overlay, color);
+			graph.Write(overlay, depth);
+			graph.Compile();
+			Assert::IsTrue(graph.GetBarriers(prez) == PipelineBarriers::MemoryAndImage);
+			Assert::IsTrue(graph.GetBarriers(forward) == PipelineBarriers::MemoryAndImage);
+			Assert::IsTrue(graph.GetBarriers(overlay) == PipelineBarriers::None);
+		}
+	};
+}
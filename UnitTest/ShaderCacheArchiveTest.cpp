@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "../CoreLib/LibIO.h"
+#include "../GameEngineCore/ShaderCacheArchive.h"
+#include <stdio.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace CoreLib::IO;
+using namespace GameEngine;
+
+namespace UnitTest
+{
+	TEST_CLASS(ShaderCacheArchiveTest)
+	{
+	private:
+		const char * archiveFileName = "ShaderCacheArchiveTest.pak";
+		static String EntryName(int i)
+		{
+			return String("entry") + String(i);
+		}
+		static List<unsigned char> EntryData(int i)
+		{
+			List<unsigned char> data;
+			for (int j = 0; j < i % 37 + 1; j++)
+				data.Add((unsigned char)(i * 7 + j));
+			return data;
+		}
+		static void AddEntries(ShaderCacheArchive & archive, int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				auto data = EntryData(i);
+				archive.AddEntry(ComputeHash64(EntryName(i)), EntryName(i), data.GetArrayView());
+			}
+		}
+		static bool HasEntry(ShaderCacheArchive & archive, int i)
+		{
+			ArrayView<unsigned char> data;
+			if (!archive.TryGetEntry(ComputeHash64(EntryName(i)), EntryName(i), data))
+				return false;
+			auto expected = EntryData(i);
+			if (data.Count() != expected.Count())
+				return false;
+			for (int j = 0; j < data.Count(); j++)
+				if (data[j] != expected[j])
+					return false;
+			return true;
+		}
+	public:
+		TEST_METHOD(EntriesPersistAcrossCompaction)
+		{
+			remove(archiveFileName);
+			{
+				ShaderCacheArchive archive;
+				archive.Open(archiveFileName);
+				AddEntries(archive, 0, 1000);
+			}
+			// the first reopen folds the journal into the table of contents
+			for (int pass = 0; pass < 2; pass++)
+			{
+				ShaderCacheArchive archive;
+				archive.Open(archiveFileName);
+				Assert::AreEqual(1000, archive.GetEntryCount());
+				for (int i = 0; i < 1000; i++)
+					Assert::IsTrue(HasEntry(archive, i));
+				ArrayView<unsigned char> data;
+				Assert::IsFalse(archive.TryGetEntry(ComputeHash64(EntryName(1)), EntryName(2), data));
+			}
+			remove(archiveFileName);
+		}
+		TEST_METHOD(TruncatedJournalRecordIsDropped)
+		{
+			remove(archiveFileName);
+			{
+				ShaderCacheArchive archive;
+				archive.Open(archiveFileName);
+				AddEntries(archive, 0, 10);
+			}
+			auto bytes = File::ReadAllBytes(archiveFileName);
+			File::WriteAllBytes(archiveFileName, bytes.Buffer(), bytes.Count() - 3);
+			ShaderCacheArchive archive;
+			archive.Open(archiveFileName);
+			for (int i = 0; i < 9; i++)
+				Assert::IsTrue(HasEntry(archive, i));
+			Assert::IsFalse(HasEntry(archive, 9));
+			remove(archiveFileName);
+		}
+	};
+}
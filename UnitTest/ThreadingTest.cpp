@@ -0,0 +1,75 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "CoreLib/Threading.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace CoreLib::Threading;
+
+namespace UnitTest
+{
+	TEST_CLASS(ThreadingTest)
+	{
+	public:
+		TEST_METHOD(ParallelForVisitsAllIndices)
+		{
+			List<int> visitCount;
+			visitCount.SetSize(100000);
+			for (auto & c : visitCount)
+				c = 0;
+			ParallelFor(0, visitCount.Count(), [&](int i) { visitCount[i]++; });
+			for (auto c : visitCount)
+				Assert::AreEqual(1, c);
+		}
+
+		TEST_METHOD(NestedParallelFor)
+		{
+			std::atomic<int> counter(0);
+			ParallelFor(0, 64, 1, [&](int)
+			{
+				ParallelFor(0, 1000, [&](int) { counter++; });
+			});
+			Assert::AreEqual(64000, counter.load());
+		}
+
+		TEST_METHOD(ParallelReduceSum)
+		{
+			long long sum = ParallelReduce(0, 100000, 0LL, [](int i) { return (long long)i; },
+				[](long long a, long long b) { return a + b; });
+			Assert::IsTrue(sum == 100000LL * 99999LL / 2);
+		}
+
+		TEST_METHOD(ParallelSortMatchesSerialSort)
+		{
+			List<int> values;
+			Random random(1234);
+			for (int i = 0; i < 200000; i++)
+				values.Add(random.Next());
+			auto expected = values;
+			expected.Sort();
+			ParallelSort(values);
+			for (int i = 0; i < values.Count(); i++)
+				Assert::AreEqual(expected[i], values[i]);
+		}
+
+		TEST_METHOD(TaskDependency)
+		{
+			struct Context
+			{
+				std::atomic<int> value;
+				int observedValue = -1;
+			} context;
+			context.value = 0;
+			TaskCounter producerDone, consumerDone;
+			auto scheduler = TaskScheduler::GetInstance();
+			scheduler->Submit([](void * data, int) { ((Context*)data)->value = 5; }, &context, 1, &producerDone);
+			scheduler->Submit([](void * data, int)
+			{
+				auto ctx = (Context*)data;
+				ctx->observedValue = ctx->value.load();
+			}, &context, 1, &consumerDone, &producerDone);
+			consumerDone.Wait();
+			Assert::AreEqual(5, context.observedValue);
+		}
+	};
+}
@@ -0,0 +1,293 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "../CoreLib/Basic.h"
+#include "../GameEngineCore/WideBvh.h"
+#include "../GameEngineCore/StaticSceneTracer.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CoreLib;
+using namespace VectorMath;
+using namespace GameEngine;
+
+namespace UnitTest
+{
+	struct TestTriangle
+	{
+		Vec3 Verts[3];
+		int Id;
+	};
+
+	struct TestTrianglePacket
+	{
+		const TestTriangle * Triangles[WideBvhWidth];
+	};
+
+	struct TestHit
+	{
+		float T = FLT_MAX;
+		int Id = -1;
+	};
+
+	inline bool IntersectTriangle(const TestTriangle & tri, const Ray & ray, float & t)
+	{
+		Vec3 e1 = tri.Verts[1] - tri.Verts[0];
+		Vec3 e2 = tri.Verts[2] - tri.Verts[0];
+		Vec3 s1 = Vec3::Cross(ray.Dir, e2);
+		float invd = 1.0f / Vec3::Dot(s1, e1);
+		Vec3 d = ray.Origin - tri.Verts[0];
+		float b1 = Vec3::Dot(d, s1) * invd;
+		Vec3 s2 = Vec3::Cross(d, e1);
+		float b2 = Vec3::Dot(ray.Dir, s2) * invd;
+		t = Vec3::Dot(e2, s2) * invd;
+		return b1 >= 0.0f && b2 >= 0.0f && b1 + b2 <= 1.0f && t >= 1e-5f && t <= ray.tMax;
+	}
+
+	class TestPacketBuilder
+	{
+	public:
+		CoreLib::Graphics::BBox AddPackets(List<TestTrianglePacket> & packets, ArrayView<TestTriangle> triangles)
+		{
+			CoreLib::Graphics::BBox bounds;
+			bounds.Init();
+			for (int i = 0; i < triangles.Count(); i += WideBvhWidth)
+			{
+				TestTrianglePacket packet;
+				for (int j = 0; j < WideBvhWidth; j++)
+				{
+					packet.Triangles[j] = i + j < triangles.Count() ? &triangles[i + j] : nullptr;
+					if (packet.Triangles[j])
+					{
+						for (int k = 0; k < 3; k++)
+							bounds.Union(packet.Triangles[j]->Verts[k]);
+					}
+				}
+				packets.Add(packet);
+			}
+			return bounds;
+		}
+	};
+
+	class TestPacketTracer
+	{
+	public:
+		bool Trace(TestHit & hit, const TestTrianglePacket & packet, const Ray & ray, float & t) const
+		{
+			bool found = false;
+			for (auto tri : packet.Triangles)
+			{
+				float triT;
+				if (tri && IntersectTriangle(*tri, ray, triT) && triT < t)
+				{
+					t = hit.T = triT;
+					hit.Id = tri->Id;
+					found = true;
+				}
+			}
+			return found;
+		}
+	};
+
+	// the scalar static face test the packet tracer replaces
+	inline bool TraceStaticFace(StaticSceneTracingResult & inter, const StaticFace & face, const Ray & ray)
+	{
+		Vec3 e1 = face.verts[1] - face.verts[0];
+		Vec3 e2 = face.verts[2] - face.verts[0];
+		Vec3 s1 = Vec3::Cross(ray.Dir, e2);
+		float invd = 1.0f / Vec3::Dot(s1, e1);
+		Vec3 d = ray.Origin - face.verts[0];
+		float b1 = Vec3::Dot(d, s1) * invd;
+		Vec3 s2 = Vec3::Cross(d, e1);
+		float b2 = Vec3::Dot(ray.Dir, s2) * invd;
+		float t = Vec3::Dot(e2, s2) * invd;
+		if (b1 < 0.f || b1 > 1.f || b2 < 0.f || b1 + b2 > 1.f || t < 1e-5f || t > ray.tMax || t >= inter.T)
+			return false;
+		inter.T = t;
+		inter.IsHit = true;
+		inter.MapId = face.mapId;
+		inter.UV = face.uvs[0] * (1.0f - b1 - b2) + face.uvs[1] * b1 + face.uvs[2] * b2;
+		return true;
+	}
+
+	class TestBvhEvaluator
+	{
+	public:
+		static const int ElementsPerNode = 8;
+		inline float EvalCost(int n1, float a1, int n2, float a2, float area)
+		{
+			return 0.125f + ((float)n1*a1 + (float)n2*a2) / area;
+		}
+	};
+
+	TEST_CLASS(WideBvhTest)
+	{
+	public:
+		TEST_METHOD(TraversalMatchesBruteForce)
+		{
+			Random random(5);
+			List<TestTriangle> triangles;
+			for (int i = 0; i < 3000; i++)
+			{
+				TestTriangle tri;
+				auto center = Vec3::Create(random.NextFloat(-50.0f, 50.0f), random.NextFloat(-50.0f, 50.0f), random.NextFloat(-50.0f, 50.0f));
+				for (auto & v : tri.Verts)
+					v = center + Vec3::Create(random.NextFloat(-2.0f, 2.0f), random.NextFloat(-2.0f, 2.0f), random.NextFloat(-2.0f, 2.0f));
+				tri.Id = i;
+				triangles.Add(tri);
+			}
+			List<BuildData<TestTriangle>> elements;
+			elements.SetSize(triangles.Count());
+			for (int i = 0; i < triangles.Count(); i++)
+			{
+				elements[i].Bounds.Init();
+				for (auto & v : triangles[i].Verts)
+					elements[i].Bounds.Union(v);
+				elements[i].Element = triangles.Buffer() + i;
+				elements[i].Center = (elements[i].Bounds.Min + elements[i].Bounds.Max) * 0.5f;
+			}
+			Bvh_Build<TestTriangle> bvhBuild;
+			TestBvhEvaluator evaluator;
+			ConstructBvh(bvhBuild, elements.Buffer(), elements.Count(), evaluator);
+			Bvh<TestTriangle> binaryBvh;
+			binaryBvh.FromBuild(bvhBuild);
+			WideBvh<TestTrianglePacket> wideBvh;
+			TestPacketBuilder builder;
+			wideBvh.FromBvh(binaryBvh, builder);
+			Assert::IsTrue(wideBvh.Nodes.Count() < binaryBvh.Nodes.Count());
+
+			int hitCount = 0;
+			for (int i = 0; i < 500; i++)
+			{
+				Ray ray;
+				ray.Origin = Vec3::Create(random.NextFloat(-60.0f, 60.0f), random.NextFloat(-60.0f, 60.0f), random.NextFloat(-60.0f, 60.0f));
+				ray.Dir = Vec3::Create(random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 1.0f)).Normalize();
+				// axis aligned rays must not lose hits in the slab test
+				if (i % 10 == 0)
+					ray.Dir = Vec3::Create(0.0f, 0.0f, i % 20 == 0 ? 1.0f : -1.0f);
+				ray.tMax = i % 2 ? 40.0f : FLT_MAX;
+				TestHit expected;
+				for (auto & tri : triangles)
+				{
+					float t;
+					if (IntersectTriangle(tri, ray, t) && t < expected.T)
+					{
+						expected.T = t;
+						expected.Id = tri.Id;
+					}
+				}
+				TestHit hit;
+				TestPacketTracer tracer;
+				bool isHit = TraverseWideBvh<TestTrianglePacket, TestPacketTracer, TestHit>(tracer, hit, wideBvh, ray);
+				Assert::AreEqual(expected.Id != -1, isHit);
+				Assert::AreEqual(expected.Id, hit.Id);
+				if (isHit)
+					hitCount++;
+			}
+			Assert::IsTrue(hitCount > 0);
+		}
+
+		TEST_METHOD(StaticSceneTracerMatchesScalar)
+		{
+			// separate quads at different heights, so that their edges lie on node planes, and random faces
+			// that leave partially filled packets
+			Random random(11);
+			List<StaticFace> faces;
+			auto addFace = [&](Vec3 v0, Vec3 v1, Vec3 v2)
+			{
+				StaticFace face;
+				face.verts[0] = v0; face.verts[1] = v1; face.verts[2] = v2;
+				for (int i = 0; i < 3; i++)
+					face.uvs[i] = Vec2::Create(face.verts[i].x * 0.1f, face.verts[i].y * 0.1f);
+				face.normal = Vec3::Cross(v1 - v0, v2 - v0).Normalize();
+				face.castShadow = 1;
+				face.mapId = faces.Count();
+				faces.Add(face);
+			};
+			for (int i = 0; i < 10; i++)
+			{
+				for (int j = 0; j < 10; j++)
+				{
+					float x = (float)i, y = (float)j, z = (float)((i + j) % 3);
+					addFace(Vec3::Create(x, y, z), Vec3::Create(x + 0.5f, y, z), Vec3::Create(x + 0.5f, y + 0.5f, z));
+					addFace(Vec3::Create(x, y, z), Vec3::Create(x + 0.5f, y + 0.5f, z), Vec3::Create(x, y + 0.5f, z));
+				}
+			}
+			for (int i = 0; i < 37; i++)
+			{
+				auto center = Vec3::Create(random.NextFloat(0.0f, 10.0f), random.NextFloat(0.0f, 10.0f), random.NextFloat(3.0f, 8.0f));
+				Vec3 verts[3];
+				for (auto & v : verts)
+					v = center + Vec3::Create(random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 1.0f));
+				addFace(verts[0], verts[1], verts[2]);
+			}
+			List<BuildData<StaticFace>> elements;
+			elements.SetSize(faces.Count());
+			for (int i = 0; i < faces.Count(); i++)
+			{
+				elements[i].Bounds.Init();
+				for (auto & v : faces[i].verts)
+					elements[i].Bounds.Union(v);
+				elements[i].Element = faces.Buffer() + i;
+				elements[i].Center = (elements[i].Bounds.Min + elements[i].Bounds.Max) * 0.5f;
+			}
+			Bvh_Build<StaticFace> bvhBuild;
+			TestBvhEvaluator evaluator;
+			ConstructBvh(bvhBuild, elements.Buffer(), elements.Count(), evaluator);
+			Bvh<StaticFace> binaryBvh;
+			binaryBvh.FromBuild(bvhBuild);
+			WideBvh<StaticFacePacket> wideBvh;
+			StaticFacePacketBuilder builder;
+			builder.faces = binaryBvh.Elements.Buffer();
+			wideBvh.FromBvh(binaryBvh, builder);
+			MeshTracer tracer;
+			tracer.faces = binaryBvh.Elements.Buffer();
+
+			auto checkRay = [&](const Ray & ray)
+			{
+				StaticSceneTracingResult expected;
+				for (auto & face : binaryBvh.Elements)
+					TraceStaticFace(expected, face, ray);
+				StaticSceneTracingResult result;
+				bool isHit = TraverseWideBvh<StaticFacePacket, MeshTracer, StaticSceneTracingResult>(tracer, result, wideBvh, ray);
+				Assert::AreEqual(expected.IsHit, isHit);
+				Assert::AreEqual(expected.IsHit, result.IsHit);
+				if (!isHit)
+					return false;
+				Assert::AreEqual(expected.MapId, result.MapId);
+				Assert::AreEqual(expected.T, result.T, 1e-5f);
+				Assert::AreEqual(expected.UV.x, result.UV.x, 1e-5f);
+				Assert::AreEqual(expected.UV.y, result.UV.y, 1e-5f);
+				return true;
+			};
+			// axis aligned rays starting on the min and max x planes of the quads, each hits an edge of one face
+			for (int i = 0; i < 10; i++)
+			{
+				for (int j = 0; j < 10; j++)
+				{
+					for (int k = 0; k < 2; k++)
+					{
+						Ray ray;
+						ray.Origin = Vec3::Create(i + k * 0.5f, j + 0.25f, -10.0f);
+						ray.Dir = Vec3::Create(0.0f, 0.0f, 1.0f);
+						ray.tMax = FLT_MAX;
+						Assert::IsTrue(checkRay(ray));
+						ray.Origin.z = 2.5f;
+						ray.Dir.z = -1.0f;
+						Assert::IsTrue(checkRay(ray));
+					}
+				}
+			}
+			int hitCount = 0;
+			for (int i = 0; i < 500; i++)
+			{
+				Ray ray;
+				ray.Origin = Vec3::Create(random.NextFloat(-2.0f, 12.0f), random.NextFloat(-2.0f, 12.0f), random.NextFloat(-2.0f, 12.0f));
+				ray.Dir = Vec3::Create(random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 1.0f)).Normalize();
+				if (i % 10 == 0)
+					ray.Dir = Vec3::Create(0.0f, i % 20 == 0 ? 1.0f : -1.0f, 0.0f);
+				ray.tMax = i % 2 ? 5.0f : FLT_MAX;
+				if (checkRay(ray))
+					hitCount++;
+			}
+			Assert::IsTrue(hitCount > 0);
+		}
+	};
+}